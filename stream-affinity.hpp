@@ -0,0 +1,185 @@
+/*
+// Thread-affinity and binding report shared by all STREAM benchmarks.
+//
+// The run scripts rely on OMP_PLACES=cores OMP_PROC_BIND=close for the
+// results to be meaningful. report_thread_affinity() queries every host
+// thread for the CPU it runs on (getcpu) and for its affinity mask
+// (sched_getaffinity), prints the thread -> cpu / core / socket / NUMA node
+// mapping and warns about threads which share a core, threads which are not
+// pinned and thread counts exceeding the set of allowed CPUs.
+// It must be called after Kokkos::initialize and before any timing starts.
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+struct ThreadPlacement {
+  int thread = -1;
+  int cpu = -1;
+  int numa_node = -1;
+  int core_id = -1;
+  int socket_id = -1;
+  std::vector<int> allowed_cpus;
+};
+
+// read a single integer from a sysfs file, returns -1 if unavailable
+inline int read_sysfs_int(const std::string &path) {
+  std::ifstream in(path);
+  int value = -1;
+  if (!(in >> value)) return -1;
+  return value;
+}
+
+// compress a sorted list of cpu ids into the "0-3,8,10-11" notation
+inline std::string format_cpu_list(const std::vector<int> &cpus) {
+  std::string res;
+  for (std::size_t i = 0; i < cpus.size();) {
+    std::size_t j = i;
+    while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+    if (!res.empty()) res += ",";
+    res += std::to_string(cpus[i]);
+    if (j > i) res += "-" + std::to_string(cpus[j]);
+    i = j + 1;
+  }
+  return res.empty() ? "-" : res;
+}
+
+inline ThreadPlacement query_thread_placement(const int thread) {
+  ThreadPlacement p;
+  p.thread = thread;
+
+  unsigned cpu = 0, node = 0;
+  // the raw syscall also reports the NUMA node and is available on older glibc
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0) {
+    p.cpu = static_cast<int>(cpu);
+    p.numa_node = static_cast<int>(node);
+  } else {
+    p.cpu = sched_getcpu();
+  }
+
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+    for (int c = 0; c < CPU_SETSIZE; ++c) {
+      if (CPU_ISSET(c, &mask)) p.allowed_cpus.push_back(c);
+    }
+  }
+
+  if (p.cpu >= 0) {
+    const std::string topo =
+        "/sys/devices/system/cpu/cpu" + std::to_string(p.cpu) + "/topology/";
+    p.core_id = read_sysfs_int(topo + "core_id");
+    p.socket_id = read_sysfs_int(topo + "physical_package_id");
+  }
+  return p;
+}
+
+inline std::vector<ThreadPlacement> query_all_thread_placements() {
+  std::vector<ThreadPlacement> placements;
+
+#if defined(_OPENMP)
+  placements.resize(omp_get_max_threads());
+#pragma omp parallel
+  {
+    const int tid = omp_get_thread_num();
+    placements[tid] = query_thread_placement(tid);
+  }
+#else
+  placements.push_back(query_thread_placement(0));
+#endif
+  return placements;
+}
+
+// number of sockets the host threads run on, 0 if unknown
+inline int count_thread_sockets() {
+  std::set<int> sockets;
+  for (const auto &p : query_all_thread_placements()) {
+    if (p.socket_id < 0) return 0;
+    sockets.insert(p.socket_id);
+  }
+  return static_cast<int>(sockets.size());
+}
+
+// Prints the placement of all host threads and returns the number of
+// warnings which were issued (0 if the binding looks sane).
+inline int report_thread_affinity() {
+  const std::vector<ThreadPlacement> placements = query_all_thread_placements();
+
+  printf("Thread affinity:\n");
+  for (const auto &p : placements) {
+    printf("- thread %4d: cpu %4d  core %4d  socket %2d  numa %2d  mask %s\n",
+           p.thread, p.cpu, p.core_id, p.socket_id, p.numa_node,
+           format_cpu_list(p.allowed_cpus).c_str());
+  }
+
+  int warnings = 0;
+
+  // threads which are running on the same physical core (or the same cpu)
+  std::map<std::pair<int, int>, std::vector<int>> threads_per_core;
+  std::set<int> allowed_union;
+  int unpinned = 0;
+  for (const auto &p : placements) {
+    threads_per_core[{p.socket_id, p.core_id < 0 ? p.cpu : p.core_id}]
+        .push_back(p.thread);
+    allowed_union.insert(p.allowed_cpus.begin(), p.allowed_cpus.end());
+    if (p.allowed_cpus.size() > 1) {
+      std::set<int> cores;
+      for (const int c : p.allowed_cpus) {
+        cores.insert(read_sysfs_int("/sys/devices/system/cpu/cpu" +
+                                    std::to_string(c) + "/topology/core_id") +
+                     (1 << 16) * read_sysfs_int("/sys/devices/system/cpu/cpu" +
+                                                std::to_string(c) +
+                                                "/topology/physical_package_id"));
+      }
+      if (cores.size() > 1) ++unpinned;
+    }
+  }
+
+  for (const auto &tc : threads_per_core) {
+    if (tc.second.size() > 1) {
+      std::string tids;
+      for (const int t : tc.second) tids += " " + std::to_string(t);
+      fprintf(stderr,
+              "Warning: threads%s share core %d on socket %d.\n",
+              tids.c_str(), tc.first.second, tc.first.first);
+      ++warnings;
+    }
+  }
+
+  if (unpinned > 0) {
+    fprintf(stderr,
+            "Warning: %d of %zu threads may migrate between cores, "
+            "check OMP_PLACES and OMP_PROC_BIND.\n",
+            unpinned, placements.size());
+    ++warnings;
+  }
+
+  if (placements.size() > allowed_union.size()) {
+    fprintf(stderr,
+            "Warning: %zu threads are oversubscribing the %zu allowed cpus.\n",
+            placements.size(), allowed_union.size());
+    ++warnings;
+  }
+
+  if (warnings == 0) {
+    printf("Thread binding verified: %zu threads on distinct cores.\n",
+           placements.size());
+  }
+
+  return warnings;
+}
@@ -0,0 +1,206 @@
+/*
+// Automatic dimension collapsing for MDRange kernels.
+//
+// For a LayoutRight view, trailing dimensions which are fully covered by the
+// iteration space and stored contiguously form a single contiguous block of
+// memory. A 4D MDRange over a(i,j,k,l) with k and l fully covered is then
+// equivalent to a 3D loop over (i, j, fused row) with a contiguous inner loop
+// over l, and if all dimensions are covered to a 1D loop over rows.
+//
+// collapsed_parallel_for() detects these dimensions from the extents and
+// strides of a view, fuses all of them except the innermost one into a row
+// index and runs an MDRangePolicy of the reduced rank (a RangePolicy if only
+// the row index is left). Every row is processed by a single thread with a
+// vectorised inner loop. The kernel body is still called with the original
+// indices (i,j,k,l), the decomposition of the row index is hoisted out of the
+// inner loop.
+//
+// If nothing can be collapsed, or the view is not accessible from the
+// default host execution space, the kernel runs with the uncollapsed
+// MDRangePolicy and the given tiling. The policy type of the caller (its
+// iteration pattern and index type) is used for this fallback, and its
+// iteration directions and index type also for the reduced policy.
+*/
+
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// Describes how an iteration space of rank 'rank' is collapsed: dimensions
+// [0, first_fused) are kept, dimensions [first_fused, rank-1) are fused into
+// the row index and dimension rank-1 is the contiguous inner loop.
+template <std::size_t rank>
+struct CollapsePlan {
+  std::size_t first_fused = rank;  // == rank: nothing collapsed
+  std::int64_t rows_begin = 0;
+  std::int64_t rows_end = 0;
+
+  bool collapsed() const { return first_fused < rank - 1; }
+  std::size_t collapsed_rank() const { return collapsed() ? first_fused + 1 : rank; }
+};
+
+template <typename V, typename T>
+CollapsePlan<V::rank()> make_collapse_plan(const V &view, const Kokkos::Array<T, V::rank()> &lower,
+                                           const Kokkos::Array<T, V::rank()> &upper) {
+  constexpr std::size_t rank = V::rank();
+  CollapsePlan<rank> plan;
+  if constexpr (!std::is_same_v<typename V::execution_space, Kokkos::DefaultHostExecutionSpace> ||
+                rank < 2) {
+    return plan;
+  } else {
+    const auto covered = [&](const std::size_t d) {
+      return lower[d] == 0 && static_cast<std::size_t>(upper[d]) == view.extent(d);
+    };
+    // dimension d is stored directly after d+1
+    const auto contiguous = [&](const std::size_t d) {
+      return d == rank - 1 ? view.stride(d) == 1
+                           : view.stride(d) == view.stride(d + 1) * view.extent(d + 1);
+    };
+
+    // trailing dimensions which are fully covered and contiguous
+    std::size_t first = rank;
+    while (first > 0 && covered(first - 1) && contiguous(first - 1)) --first;
+    if (first == rank) return plan;
+    // the dimension in front of the block may be partially covered
+    if (first > 0 && contiguous(first - 1)) --first;
+    if (first >= rank - 1) return plan;
+
+    plan.first_fused = first;
+    std::int64_t row_length = 1;
+    for (std::size_t d = first + 1; d < rank - 1; ++d) row_length *= upper[d];
+    plan.rows_begin = static_cast<std::int64_t>(lower[first]) * row_length;
+    plan.rows_end = static_cast<std::int64_t>(upper[first]) * row_length;
+    return plan;
+  }
+}
+
+template <typename V, typename T>
+void print_collapse_plan(const V &view, const Kokkos::Array<T, V::rank()> &lower,
+                         const Kokkos::Array<T, V::rank()> &upper) {
+  constexpr std::size_t rank = V::rank();
+  const auto plan = make_collapse_plan(view, lower, upper);
+  if (!plan.collapsed()) {
+    printf("Collapsed iteration space: none, using the %zuD MDRangePolicy\n", rank);
+    return;
+  }
+  std::string kept;
+  for (std::size_t d = 0; d < plan.first_fused; ++d) {
+    kept += std::to_string(upper[d] - lower[d]) + "x";
+  }
+  printf("Collapsed iteration space: %zuD -> %zuD [%s%" PRId64 " rows] x %" PRId64
+         " contiguous inner\n",
+         rank, plan.collapsed_rank(), kept.c_str(), plan.rows_end - plan.rows_begin,
+         static_cast<std::int64_t>(upper[rank - 1] - lower[rank - 1]));
+}
+
+namespace collapse_impl {
+
+// called with the kept indices followed by the row index
+template <std::size_t rank, std::size_t kept, typename F>
+struct CollapsedFunctor {
+  F f;
+  std::int64_t inner_begin;
+  std::int64_t inner_end;
+  std::int64_t extents[rank];
+
+  template <std::size_t... I>
+  KOKKOS_FORCEINLINE_FUNCTION void call(std::index_sequence<I...>, const std::int64_t *idx,
+                                        const std::int64_t l) const {
+    f(idx[I]..., l);
+  }
+
+  template <typename... Idx>
+  KOKKOS_INLINE_FUNCTION void operator()(const Idx... args) const {
+    static_assert(sizeof...(Idx) == kept + 1, "wrong number of indices");
+    const std::int64_t in[] = {static_cast<std::int64_t>(args)...};
+    std::int64_t idx[rank - 1];
+    for (std::size_t d = 0; d < kept; ++d) idx[d] = in[d];
+    std::int64_t row = in[kept];
+    for (std::size_t d = rank - 2; d > kept; --d) {
+      idx[d] = row % extents[d];
+      row /= extents[d];
+    }
+    idx[kept] = row;
+#pragma omp simd
+    for (std::int64_t l = inner_begin; l < inner_end; ++l) {
+      call(std::make_index_sequence<rank - 1>{}, idx, l);
+    }
+  }
+};
+
+template <std::size_t kept, typename Policy, typename T, std::size_t rank, typename F>
+void run_collapsed(const std::string &label, const CollapsePlan<rank> &plan,
+                   const Kokkos::Array<T, rank> &lower, const Kokkos::Array<T, rank> &upper,
+                   const F &f) {
+  using ExecSpace = Kokkos::DefaultHostExecutionSpace;
+  using Index     = Kokkos::IndexType<typename Policy::index_type>;
+  CollapsedFunctor<rank, kept, F> functor{f, static_cast<std::int64_t>(lower[rank - 1]),
+                                          static_cast<std::int64_t>(upper[rank - 1]), {}};
+  for (std::size_t d = 0; d < rank; ++d) functor.extents[d] = upper[d];
+  if constexpr (kept == 0) {
+    Kokkos::parallel_for(
+        label,
+        Kokkos::RangePolicy<ExecSpace, Index>(plan.rows_begin, plan.rows_end),
+        functor);
+  } else {
+    Kokkos::Array<std::int64_t, kept + 1> lo, hi;
+    for (std::size_t d = 0; d < kept; ++d) {
+      lo[d] = lower[d];
+      hi[d] = upper[d];
+    }
+    lo[kept] = plan.rows_begin;
+    hi[kept] = plan.rows_end;
+    Kokkos::parallel_for(
+        label,
+        Kokkos::MDRangePolicy<
+            Kokkos::Rank<kept + 1, Policy::outer_direction, Policy::inner_direction>,
+            ExecSpace, Index>(lo, hi),
+        functor);
+  }
+}
+
+// selects the instantiation for plan.first_fused at runtime
+template <std::size_t kept, typename Policy, typename T, std::size_t rank, typename F>
+void dispatch_collapsed(const std::string &label, const CollapsePlan<rank> &plan,
+                        const Kokkos::Array<T, rank> &lower, const Kokkos::Array<T, rank> &upper,
+                        const F &f) {
+  if constexpr (kept + 1 < rank) {
+    if (plan.first_fused == kept) {
+      run_collapsed<kept, Policy>(label, plan, lower, upper, f);
+    } else {
+      dispatch_collapsed<kept + 1, Policy>(label, plan, lower, upper, f);
+    }
+  }
+}
+
+}  // namespace collapse_impl
+
+// Runs 'f' over [lower,upper) like an MDRangePolicy of rank V::rank() with
+// the given tiling, collapsing fully covered contiguous trailing dimensions
+// of 'view' where possible. 'f' is always called with V::rank() indices.
+// 'Policy' is the MDRangePolicy of the uncollapsed kernel, void for
+// MDRangePolicy<Rank<V::rank()>>.
+template <typename Policy = void, typename V, typename T, typename F>
+void collapsed_parallel_for(const std::string &label, const V &view,
+                            const Kokkos::Array<T, V::rank()> &lower,
+                            const Kokkos::Array<T, V::rank()> &upper,
+                            const Kokkos::Array<T, V::rank()> &tiling, const F &f) {
+  constexpr std::size_t rank = V::rank();
+  using MDPolicy =
+      std::conditional_t<std::is_void_v<Policy>, Kokkos::MDRangePolicy<Kokkos::Rank<rank>>,
+                         Policy>;
+  const auto plan = make_collapse_plan(view, lower, upper);
+  if (plan.collapsed()) {
+    collapse_impl::dispatch_collapsed<0, MDPolicy>(label, plan, lower, upper, f);
+  } else {
+    Kokkos::parallel_for(label, MDPolicy(lower, upper, tiling), f);
+  }
+  Kokkos::fence();
+}
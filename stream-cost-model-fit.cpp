@@ -0,0 +1,294 @@
+/*
+// Fits and checks the bandwidth cost model of stream-cost-model.hpp against
+// the results of the tiling scan (tiling_scan/<arch>/results.dat).
+//
+// The tile shapes are reconstructed from the tiling factor using the host
+// branch of get_tiling() in stream-kokkos-{2,3,4}d-mdrange-tiling-scan.cpp,
+// so only results of CPU runs can be used.
+//
+// The model is fitted on every other array size and checked on the remaining
+// ones, then refitted on all data. For each (policy, size, kernel) of the
+// remaining sizes the tilings are ranked by the model fitted on the other
+// sizes and the measured bandwidth of the predicted best tiling is compared
+// to the measured best, which is what a tiling scan ranking tilings without
+// running them can expect. The ranking of the fit on all data is in-sample
+// and only reported for comparison. With -o the fit on all data is written
+// to a file which the tiling scan binaries read with -m.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <getopt.h>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "stream-cost-model.hpp"
+
+#define HLINE "-------------------------------------------------------------\n"
+
+struct ScanResult {
+  int nt;
+  std::size_t n;
+  std::size_t factor;
+  std::string policy;
+  std::string kernel;
+  double bw;
+};
+
+int parse_args(int argc, char **argv, std::string &results_file, double &llc_mib,
+               double &prefetch_streams, std::string &output_file) {
+  // Defaults
+  results_file = "";
+  output_file = "";
+  llc_mib = 256.0;
+  prefetch_streams = 16.0;
+
+  const std::string help_string =
+      "  -f <FILE>, --file <FILE>\n"
+      "     results.dat of a CPU tiling scan (required)\n"
+      "  -l <L>, --llc <L>\n"
+      "     aggregate last-level cache size of all sockets in MiB\n"
+      "     Default: 256\n"
+      "  -p <P>, --prefetch-streams <P>\n"
+      "     number of streams tracked by the hardware prefetchers per core\n"
+      "     Default: 16\n"
+      "  -o <FILE>, --output <FILE>\n"
+      "     write the parameters fitted on all data to <FILE>, for -m of the\n"
+      "     tiling scan binaries\n"
+      "  -h, --help\n"
+      "     Prints this message.\n";
+
+  static struct option long_options[] = {
+      {"file", required_argument, NULL, 'f'},
+      {"llc", required_argument, NULL, 'l'},
+      {"prefetch-streams", required_argument, NULL, 'p'},
+      {"output", required_argument, NULL, 'o'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0}};
+
+  int c;
+  int option_index = 0;
+  while ((c = getopt_long(argc, argv, "f:l:p:o:h", long_options, &option_index)) !=
+         -1)
+    switch (c) {
+      case 'f': results_file = optarg; break;
+      case 'l': llc_mib = atof(optarg); break;
+      case 'p': prefetch_streams = atof(optarg); break;
+      case 'o': output_file = optarg; break;
+      case 'h':
+        printf("%s", help_string.c_str());
+        return -2;
+        break;
+      case 0: break;
+      default:
+        printf("%s", help_string.c_str());
+        return -1;
+        break;
+    }
+  if (results_file.empty()) {
+    printf("%s", help_string.c_str());
+    return -1;
+  }
+  return 0;
+}
+
+std::vector<ScanResult> read_results(const std::string &filename) {
+  std::vector<ScanResult> res;
+  std::ifstream in(filename);
+  std::string line;
+  // header: nt n factor policy kernel bw
+  std::getline(in, line);
+  while (std::getline(in, line)) {
+    std::istringstream ss(line);
+    ScanResult r;
+    if (ss >> r.nt >> r.n >> r.factor >> r.policy >> r.kernel >> r.bw) {
+      if (r.bw > 0.0) res.push_back(r);
+    }
+  }
+  return res;
+}
+
+// host branch of get_tiling() in the tiling scan binaries
+std::vector<std::size_t> scan_tiling(const std::vector<std::size_t> &e, const std::size_t factor) {
+  const auto inner = [&](const std::size_t extent) {
+    return extent / factor == 0 ? std::size_t(1) : extent / factor;
+  };
+  switch (e.size()) {
+    case 2: return {4 * factor, inner(e[1])};
+    case 3: return {factor, e[1] / 2, inner(e[2])};
+    case 4: return {factor, 2, e[2], inner(e[3])};
+    default: return e;
+  }
+}
+
+int kernel_streams(const std::string &kernel) {
+  if (kernel == "Set") return 1;
+  if (kernel == "Copy" || kernel == "Scale") return 2;
+  return 3;
+}
+
+CostModelSample make_sample(const ScanResult &r) {
+  CostModelSample s;
+  const int rank = r.policy[0] - '0';
+  const auto extent =
+      static_cast<std::size_t>(std::llround(std::pow(static_cast<double>(r.n), 1.0 / rank)));
+  s.input.extents.assign(rank, extent);
+  s.input.tile = scan_tiling(s.input.extents, r.factor);
+  s.input.layout_right = true;
+  s.input.nthreads = r.nt;
+  s.input.nstreams = kernel_streams(r.kernel);
+  s.bandwidth = r.bw;
+  return s;
+}
+
+void report_error(const char *label, const std::vector<CostModelSample> &samples,
+                  const CostModelParameters &p) {
+  const double rms = std::sqrt(cost_model_error(samples, p));
+  printf("%-24s %6zu samples, typical error %6.1f%%\n", label, samples.size(),
+         100.0 * (std::exp(rms) - 1.0));
+}
+
+struct RankingScore {
+  int hits = 0;             // predicted best == measured best
+  int groups = 0;           // (policy, n, kernel) combinations
+  double efficiency = 0.0;  // sum of measured(predicted best) / measured best
+};
+
+// For every (policy, n, kernel) with n in 'sizes', the tiling factor
+// predicted to be best is compared to the measured best tiling factor.
+std::map<std::string, RankingScore> score_ranking(const std::vector<ScanResult> &results,
+                                                  const std::set<std::size_t> &sizes,
+                                                  const CostModelParameters &p) {
+  using Key = std::tuple<std::string, std::size_t, std::string>;
+  std::map<Key, std::vector<std::pair<double, double>>> groups;  // (predicted, measured)
+  for (const auto &r : results) {
+    if (!sizes.count(r.n)) continue;
+    const auto s = make_sample(r);
+    groups[Key(r.policy, r.n, r.kernel)].emplace_back(predict_bandwidth(s.input, p).bandwidth,
+                                                       r.bw);
+  }
+
+  std::map<std::string, RankingScore> per_policy;
+  for (const auto &g : groups) {
+    const auto &v = g.second;
+    const auto pred_best = std::max_element(
+        v.begin(), v.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+    const auto meas_best = std::max_element(
+        v.begin(), v.end(), [](const auto &a, const auto &b) { return a.second < b.second; });
+    auto &acc = per_policy[std::get<0>(g.first)];
+    acc.hits += (pred_best->second == meas_best->second) ? 1 : 0;
+    acc.groups += 1;
+    acc.efficiency += pred_best->second / meas_best->second;
+  }
+  return per_policy;
+}
+
+void print_ranking_score(const std::string &label, const RankingScore &score) {
+  printf("- %-12s best tiling found in %3d of %3d cases, "
+         "predicted pick reaches %5.1f%% of best on average\n",
+         label.c_str(), score.hits, score.groups, 100.0 * score.efficiency / score.groups);
+}
+
+void print_parameters(const CostModelParameters &p) {
+  printf("Fitted parameters:\n");
+  printf("- memory bandwidth:   %10.2f GB/s\n", p.mem_bandwidth);
+  printf("- cache bandwidth:    %10.2f GB/s\n", p.cache_bandwidth);
+  printf("- launch overhead:    %10.2f us\n", 1.0e6 * p.launch_overhead);
+  printf("- run penalty:        %10.2f bytes\n", p.run_penalty);
+  printf("- tile overhead:      %10.2f elements\n", p.tile_overhead);
+}
+
+int main(int argc, char *argv[]) {
+  printf(HLINE);
+  printf("MDRange STREAM bandwidth cost model fit\n");
+  printf(HLINE);
+
+  std::string results_file;
+  double llc_mib;
+  double prefetch_streams;
+  std::string output_file;
+  int rc = parse_args(argc, argv, results_file, llc_mib, prefetch_streams, output_file);
+  if (rc == -2) return 0;
+  if (rc != 0) return rc;
+
+  const auto results = read_results(results_file);
+  if (results.empty()) {
+    fprintf(stderr, "Error: no results found in %s.\n", results_file.c_str());
+    return 1;
+  }
+
+  // split into training and test data by alternating array sizes
+  std::set<std::size_t> sizes;
+  for (const auto &r : results) sizes.insert(r.n);
+  std::set<std::size_t> train_sizes, test_sizes;
+  std::size_t idx = 0;
+  for (const auto n : sizes) {
+    (idx++ % 2 == 0 ? train_sizes : test_sizes).insert(n);
+  }
+
+  std::vector<CostModelSample> all, train, test;
+  std::map<std::string, std::vector<CostModelSample>> per_policy;
+  for (const auto &r : results) {
+    const auto s = make_sample(r);
+    all.push_back(s);
+    (train_sizes.count(r.n) ? train : test).push_back(s);
+    per_policy[r.policy].push_back(s);
+  }
+
+  CostModelParameters initial;
+  initial.llc_bytes = llc_mib * 1024.0 * 1024.0;
+  initial.prefetch_streams = prefetch_streams;
+  // start from the best measured bandwidth
+  for (const auto &r : results) {
+    initial.mem_bandwidth = std::max(initial.mem_bandwidth, 0.5 * r.bw);
+    initial.cache_bandwidth = std::max(initial.cache_bandwidth, r.bw);
+  }
+
+  printf("Read %zu results from %s\n", results.size(), results_file.c_str());
+  printf(HLINE);
+
+  const auto train_fit = fit_cost_model(train, initial);
+  printf("Fit on every other array size:\n");
+  report_error("- training data", train, train_fit);
+  report_error("- test data", test, train_fit);
+  printf(HLINE);
+
+  const auto fit = fit_cost_model(all, initial);
+  print_parameters(fit);
+  report_error("- all data", all, fit);
+  for (const auto &pp : per_policy) {
+    report_error(("- " + pp.first).c_str(), pp.second, fit);
+  }
+  printf(HLINE);
+
+  printf("Tiling ranking of the test sizes with the fit on the training sizes\n"
+         "(predicted best vs. measured best, without running them):\n");
+  for (const auto &pp : score_ranking(results, test_sizes, train_fit)) {
+    print_ranking_score(pp.first, pp.second);
+  }
+  // in-sample, the fit has seen these measurements
+  RankingScore in_sample;
+  for (const auto &pp : score_ranking(results, sizes, fit)) {
+    in_sample.hits += pp.second.hits;
+    in_sample.groups += pp.second.groups;
+    in_sample.efficiency += pp.second.efficiency;
+  }
+  printf("In-sample, all sizes with the fit on all data:\n");
+  print_ranking_score("all policies", in_sample);
+  printf(HLINE);
+
+  if (!output_file.empty()) {
+    if (!write_cost_model_parameters(output_file.c_str(), fit)) return 1;
+    printf("Parameters fitted on all data written to %s\n", output_file.c_str());
+    printf(HLINE);
+  }
+
+  return 0;
+}
@@ -0,0 +1,253 @@
+/*
+// Bandwidth cost model for MDRange STREAM kernels.
+//
+// Predicts the achievable bandwidth of a kernel from the rank, extents and
+// layout of the views, the tile shape, the number of threads and a few
+// machine parameters. The kernel time is modelled as
+//
+//   T = t_launch + bytes / (B * contiguity * tile_efficiency * prefetch * balance)
+//
+// where
+//   B                the memory bandwidth, or the cache bandwidth if all arrays
+//                    touched by the kernel fit into the last-level cache
+//   contiguity       run / (run + run_penalty) for the contiguous run length
+//                    in bytes (prefetcher training, partial cache lines)
+//   tile_efficiency  volume / (volume + tile_overhead), the fixed cost of
+//                    starting a tile expressed in element updates
+//   prefetch         fraction of the streams which can be tracked by the
+//                    hardware prefetchers, the remainder runs at
+//                    'unprefetched_efficiency'
+//   balance          tiles / (threads * max tiles per thread)
+//
+// The parameters can be fitted to measured data with fit_cost_model(), see
+// stream-cost-model-fit.cpp which does this for tiling_scan/<arch>/results.dat
+// and stores them with write_cost_model_parameters(). The tiling scan
+// binaries load such a file with read_cost_model_parameters(), otherwise
+// they rank with the uncalibrated defaults below.
+// The header does not depend on Kokkos such that it can be used offline.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <vector>
+
+struct CostModelParameters {
+  double mem_bandwidth = 200.0;         // GB/s, all threads, from DRAM
+  double cache_bandwidth = 800.0;       // GB/s, all threads, from the LLC
+  double llc_bytes = 256.0 * 1024 * 1024;  // aggregate last-level cache
+  double launch_overhead = 5.0e-6;      // s per kernel (fork / join)
+  double run_penalty = 128.0;           // bytes per contiguous run
+  double tile_overhead = 32.0;          // element updates per tile
+  double prefetch_streams = 16.0;       // streams tracked per core
+  double unprefetched_efficiency = 0.5; // relative bandwidth without prefetching
+};
+
+// keys of the parameter file, one "key = value" line each
+struct CostModelParameterKey {
+  const char *name;
+  double CostModelParameters::*value;
+};
+constexpr CostModelParameterKey cost_model_parameter_keys[] = {
+    {"mem_bandwidth", &CostModelParameters::mem_bandwidth},
+    {"cache_bandwidth", &CostModelParameters::cache_bandwidth},
+    {"llc_bytes", &CostModelParameters::llc_bytes},
+    {"launch_overhead", &CostModelParameters::launch_overhead},
+    {"run_penalty", &CostModelParameters::run_penalty},
+    {"tile_overhead", &CostModelParameters::tile_overhead},
+    {"prefetch_streams", &CostModelParameters::prefetch_streams},
+    {"unprefetched_efficiency", &CostModelParameters::unprefetched_efficiency}};
+
+inline bool write_cost_model_parameters(const char *path, const CostModelParameters &p) {
+  FILE *out = fopen(path, "w");
+  if (out == nullptr) {
+    fprintf(stderr, "Error: cannot write the cost model parameters to '%s'.\n", path);
+    return false;
+  }
+  fprintf(out, "# fitted with stream-cost-model-fit\n");
+  for (const auto &key : cost_model_parameter_keys) {
+    fprintf(out, "%s = %.9g\n", key.name, p.*key.value);
+  }
+  return fclose(out) == 0;
+}
+
+// Reads the parameters written by write_cost_model_parameters(), keys which
+// are not given keep their value in 'p'. Prints an error and returns false
+// if the file cannot be read or contains an invalid line.
+inline bool read_cost_model_parameters(const char *path, CostModelParameters &p) {
+  std::ifstream in(path);
+  if (!in) {
+    fprintf(stderr, "Error: cannot read the cost model parameters '%s'.\n", path);
+    return false;
+  }
+  std::string line;
+  int lineno = 0;
+  while (std::getline(in, line)) {
+    ++lineno;
+    line = line.substr(0, line.find('#'));
+    const auto trim = [](const std::string &str) {
+      const auto first = str.find_first_not_of(" \t\r");
+      if (first == std::string::npos) return std::string();
+      return str.substr(first, str.find_last_not_of(" \t\r") - first + 1);
+    };
+    if (trim(line).empty()) continue;
+    const auto eq = line.find('=');
+    const std::string key = trim(line.substr(0, eq));
+    const std::string value = eq == std::string::npos ? "" : trim(line.substr(eq + 1));
+    errno = 0;
+    char *end = nullptr;
+    const double number = std::strtod(value.c_str(), &end);
+    const auto known = std::find_if(
+        std::begin(cost_model_parameter_keys), std::end(cost_model_parameter_keys),
+        [&](const CostModelParameterKey &k) { return key == k.name; });
+    if (eq == std::string::npos || value.empty() || errno != 0 || *end != '\0' ||
+        !(number > 0.0) || known == std::end(cost_model_parameter_keys)) {
+      fprintf(stderr, "Error: %s:%d: expected '<parameter> = <positive number>'.\n", path,
+              lineno);
+      return false;
+    }
+    p.*known->value = number;
+  }
+  return true;
+}
+
+struct CostModelInput {
+  std::vector<std::size_t> extents;
+  std::vector<std::size_t> tile;
+  bool layout_right = true;
+  int nthreads = 1;
+  int nstreams = 3;  // arrays touched by the kernel
+  std::size_t element_size = sizeof(double);
+};
+
+// builds the model input from any indexable extents and tiling, such as
+// Kokkos::Array
+template <typename Extents, typename Tiling>
+CostModelInput make_cost_model_input(const std::size_t rank, const Extents &extents,
+                                     const Tiling &tiling, const int nthreads,
+                                     const int nstreams, const bool layout_right = true) {
+  CostModelInput in;
+  for (std::size_t d = 0; d < rank; ++d) {
+    in.extents.push_back(static_cast<std::size_t>(extents[d]));
+    in.tile.push_back(static_cast<std::size_t>(tiling[d]));
+  }
+  in.nthreads = nthreads;
+  in.nstreams = nstreams;
+  in.layout_right = layout_right;
+  return in;
+}
+
+struct CostModelPrediction {
+  double bandwidth = 0.0;  // GB/s
+  double time = 0.0;       // s
+  double contiguity = 0.0;
+  double tile_efficiency = 0.0;
+  double prefetch = 0.0;
+  double balance = 0.0;
+  bool in_cache = false;
+  std::size_t tiles = 0;
+  std::size_t run_length = 0;  // elements
+};
+
+inline CostModelPrediction predict_bandwidth(const CostModelInput &in,
+                                             const CostModelParameters &p) {
+  CostModelPrediction res;
+  const std::size_t rank = in.extents.size();
+
+  double nelem = 1.0;
+  double volume = 1.0;
+  res.tiles = 1;
+  for (std::size_t d = 0; d < rank; ++d) {
+    const std::size_t t = std::max<std::size_t>(1, std::min(in.tile[d], in.extents[d]));
+    nelem *= in.extents[d];
+    volume *= t;
+    res.tiles *= (in.extents[d] + t - 1) / t;
+  }
+
+  res.run_length = 1;
+  for (std::size_t i = 0; i < rank; ++i) {
+    const std::size_t d = in.layout_right ? rank - 1 - i : i;
+    const std::size_t t = std::max<std::size_t>(1, std::min(in.tile[d], in.extents[d]));
+    res.run_length *= t;
+    if (t != in.extents[d]) break;
+  }
+
+  const double run_bytes = static_cast<double>(res.run_length * in.element_size);
+  res.contiguity = run_bytes / (run_bytes + p.run_penalty);
+  res.tile_efficiency = volume / (volume + p.tile_overhead);
+
+  const double tracked = std::min(1.0, p.prefetch_streams / std::max(1, in.nstreams));
+  res.prefetch = tracked + (1.0 - tracked) * p.unprefetched_efficiency;
+
+  const std::size_t per_thread = (res.tiles + in.nthreads - 1) / in.nthreads;
+  res.balance = static_cast<double>(res.tiles) / (static_cast<double>(per_thread) * in.nthreads);
+
+  const double bytes = nelem * in.nstreams * in.element_size;
+  res.in_cache = bytes <= p.llc_bytes;
+  const double bw = 1.0e9 * (res.in_cache ? p.cache_bandwidth : p.mem_bandwidth);
+
+  res.time = p.launch_overhead +
+             bytes / (bw * res.contiguity * res.tile_efficiency * res.prefetch * res.balance);
+  res.bandwidth = 1.0e-9 * bytes / res.time;
+  return res;
+}
+
+struct CostModelSample {
+  CostModelInput input;
+  double bandwidth = 0.0;  // measured, GB/s
+};
+
+// mean squared error of log(predicted / measured)
+inline double cost_model_error(const std::vector<CostModelSample> &samples,
+                               const CostModelParameters &p) {
+  if (samples.empty()) return 0.0;
+  double err = 0.0;
+  for (const auto &s : samples) {
+    const double r = std::log(predict_bandwidth(s.input, p).bandwidth / s.bandwidth);
+    err += r * r;
+  }
+  return err / samples.size();
+}
+
+// Fits the bandwidths, launch overhead, run penalty and tile overhead by
+// multiplicative coordinate descent on the log error. The cache size and the
+// prefetcher parameters are machine properties and are kept fixed.
+inline CostModelParameters fit_cost_model(const std::vector<CostModelSample> &samples,
+                                          CostModelParameters p,
+                                          const int max_iterations = 500) {
+  const std::vector<std::function<double &(CostModelParameters &)>> fitted = {
+      [](CostModelParameters &q) -> double & { return q.mem_bandwidth; },
+      [](CostModelParameters &q) -> double & { return q.cache_bandwidth; },
+      [](CostModelParameters &q) -> double & { return q.launch_overhead; },
+      [](CostModelParameters &q) -> double & { return q.run_penalty; },
+      [](CostModelParameters &q) -> double & { return q.tile_overhead; }};
+
+  double err = cost_model_error(samples, p);
+  double step = 0.5;
+  for (int it = 0; it < max_iterations && step > 1.0e-4; ++it) {
+    bool improved = false;
+    for (const auto &param : fitted) {
+      for (const double f : {1.0 + step, 1.0 / (1.0 + step)}) {
+        CostModelParameters q = p;
+        param(q) *= f;
+        const double e = cost_model_error(samples, q);
+        if (e < err) {
+          err = e;
+          p = q;
+          improved = true;
+        }
+      }
+    }
+    if (!improved) step *= 0.5;
+  }
+  return p;
+}
@@ -0,0 +1,79 @@
+/*
+// Dot, Nstream and a multi-reducer kernel in addition to the STREAM kernels
+// (as in BabelStream):
+//
+//   Dot          sum(a * b)               reads a, b                2 arrays
+//   Nstream      a += b + scalar * c      reads a, b, c, writes a   4 arrays
+//   Sum+MaxNorm  sum(a) and max(|a|)      reads a                   1 array
+//
+// Sum+MaxNorm computes both results in one pass with two reducers. The
+// binaries run the three kernels in one timed loop after the validation of
+// the STREAM kernels, starting from freshly initialised views, keep the
+// results of the last iteration in ExtraKernelResults and compare them with
+// the expected values using check_extra_kernels(). c is initialised to
+// extra_cinit rather than the cinit = 0 of the STREAM kernels, so that the
+// scalar * c term of Nstream contributes to the checked results.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+
+constexpr int num_extra_kernels = 3;
+constexpr const char *extra_kernel_names[num_extra_kernels] = {"Dot", "Nstream",
+                                                               "Sum+MaxNorm"};
+// initial value of c for the extra kernels, must be non-zero
+constexpr double extra_cinit = 0.5;
+// arrays read or written per element
+constexpr double extra_kernel_streams[num_extra_kernels] = {2.0, 4.0, 1.0};
+
+struct ExtraKernelResults {
+  double dot      = 0.0;
+  double sum      = 0.0;
+  double max_norm = 0.0;
+};
+
+// Checks the results of the last of 'ntimes' iterations on views with
+// 'nelem' elements initialised to ainit, binit and cinit, returns the
+// number of failed checks.
+inline int check_extra_kernels(const ExtraKernelResults &r, const double nelem, const int ntimes,
+                               const double ainit, const double binit, const double cinit,
+                               const double scalar) {
+  // a before and after the last Nstream, added up as on the device
+  double a_last = ainit;
+  for (int k = 0; k < ntimes - 1; ++k) a_last += binit + scalar * cinit;
+  const double a_final = a_last + (binit + scalar * cinit);
+
+  // the reductions sum nelem equal values in any order
+  const double epsilon = 1.0e-8;
+  const struct {
+    const char *name;
+    double value;
+    double expected;
+  } checks[] = {{"Dot", r.dot, nelem * a_last * binit},
+                {"Sum", r.sum, nelem * a_final},
+                {"MaxNorm", r.max_norm, std::abs(a_final)}};
+
+  int errorCount = 0;
+  for (const auto &c : checks) {
+    if (std::abs(c.value - c.expected) > epsilon * std::abs(c.expected)) {
+      fprintf(stderr, "Error: validation check on %s failed, %g instead of %g.\n", c.name,
+              c.value, c.expected);
+      errorCount++;
+    }
+  }
+  if (errorCount == 0) {
+    printf("Dot, Nstream and Sum+MaxNorm checked and verified.\n");
+  }
+  return errorCount;
+}
+
+// 'bytes' is the size of one array
+inline void print_extra_kernel_bandwidth(const double times[num_extra_kernels],
+                                         const double bytes) {
+  for (int n = 0; n < num_extra_kernels; ++n) {
+    printf("%-16s%11.4f GB/s\n", extra_kernel_names[n],
+           1.0e-09 * extra_kernel_streams[n] * bytes / times[n]);
+  }
+}
@@ -0,0 +1,163 @@
+/*
+// Zero-copy flat aliasing of multi-dimensional STREAM views.
+//
+// Pointwise kernels such as Copy or Triad do not depend on the
+// multi-dimensional structure of the data. If the elements of a view occupy
+// exactly span() consecutive entries of its allocation, the same memory can
+// be accessed through an unmanaged rank-1 view of span() elements and the
+// kernels of stream-kokkos-range.cpp can be run on it without any copy.
+//
+// This is only valid if span() == size() and span_is_contiguous(): padded
+// allocations contain holes at the end of each row, strided views
+// (e.g. subviews) skip elements, and in both cases a flat loop over span()
+// would touch memory which does not belong to the logical view.
+// report_flat_alias_safety() shows this for the stream view itself, a small
+// padded allocation of the same layout and a strided view of the same data.
+*/
+
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <limits>
+#include <string>
+
+using FlatIndex = long long int;
+using FlatPolicy = Kokkos::RangePolicy<Kokkos::IndexType<FlatIndex>>;
+
+template <typename V>
+using FlatAlias = Kokkos::View<typename V::value_type *, typename V::device_type,
+                               Kokkos::MemoryTraits<Kokkos::Unmanaged | Kokkos::Restrict>>;
+
+template <typename V>
+bool flat_alias_is_safe(const V &view) {
+  return view.span_is_contiguous() && view.span() == view.size();
+}
+
+// rank-1 view of all span() elements of 'view', sharing its allocation
+template <typename V>
+FlatAlias<V> make_flat_alias(const V &view) {
+  return FlatAlias<V>(view.data(), view.span());
+}
+
+template <typename V>
+void report_flat_alias(const char *label, const V &view) {
+  printf("- %-12s size %12zu  span %12zu  contiguous %-3s  flat alias %s\n", label,
+         static_cast<std::size_t>(view.size()), static_cast<std::size_t>(view.span()),
+         view.span_is_contiguous() ? "yes" : "no",
+         flat_alias_is_safe(view) ? "safe" : "UNSAFE");
+}
+
+template <typename V>
+void report_flat_alias_safety(const V &view) {
+  constexpr std::size_t rank = V::rank();
+  printf("Flat aliasing of the %zuD views:\n", rank);
+  report_flat_alias("stream view", view);
+
+  // A small padded allocation of the same layout. Kokkos pads the stride-one
+  // extent to a multiple of the 64 byte alignment only if it is not one
+  // already and exceeds four alignment units, so the stream extents
+  // (e.g. the default 32) may not be padded at all. 4 units + 1 element
+  // always are, and only 2 elements are used along the other dimensions,
+  // which keeps the extra allocation negligible on devices as well.
+  constexpr std::size_t align = std::max<std::size_t>(1, 64 / sizeof(typename V::value_type));
+  auto padded_layout = view.layout();
+  for (std::size_t d = 0; d < rank; ++d) {
+    padded_layout.dimension[d] = view.stride(d) == 1 ? 4 * align + 1 : 2;
+  }
+  V padded(Kokkos::view_alloc(Kokkos::WithoutInitializing, Kokkos::AllowPadding, "padded"),
+           padded_layout);
+  report_flat_alias("padded small", padded);
+
+  // Every other element along the stride-one dimension of the same data,
+  // as obtained from a strided subview. Only the metadata is used.
+  Kokkos::LayoutStride layout;
+  for (std::size_t d = 0; d < rank; ++d) {
+    layout.dimension[d] = view.extent(d);
+    layout.stride[d] = view.stride(d);
+    if (view.stride(d) == 1) {
+      layout.dimension[d] = view.extent(d) / 2 > 0 ? view.extent(d) / 2 : 1;
+      layout.stride[d] = 2;
+    }
+  }
+  Kokkos::View<typename V::data_type, Kokkos::LayoutStride, typename V::device_type,
+               Kokkos::MemoryTraits<Kokkos::Unmanaged>>
+      strided(view.data(), layout);
+  report_flat_alias("strided", strided);
+}
+
+// the kernels of stream-kokkos-range.cpp on flat aliases
+
+template <typename A>
+void perform_flat_set(const A &a, const typename A::value_type scalar) {
+  Kokkos::parallel_for(
+      "flat_set", FlatPolicy(0, a.extent(0)),
+      KOKKOS_LAMBDA(const FlatIndex i) { a[i] = scalar; });
+
+  Kokkos::fence();
+}
+
+template <typename A>
+void perform_flat_copy(const A &a, const A &b) {
+  Kokkos::parallel_for(
+      "flat_copy", FlatPolicy(0, a.extent(0)),
+      KOKKOS_LAMBDA(const FlatIndex i) { b[i] = a[i]; });
+
+  Kokkos::fence();
+}
+
+template <typename A>
+void perform_flat_scale(const A &b, const A &c, const typename A::value_type scalar) {
+  Kokkos::parallel_for(
+      "flat_scale", FlatPolicy(0, b.extent(0)),
+      KOKKOS_LAMBDA(const FlatIndex i) { b[i] = scalar * c[i]; });
+
+  Kokkos::fence();
+}
+
+template <typename A>
+void perform_flat_add(const A &a, const A &b, const A &c) {
+  Kokkos::parallel_for(
+      "flat_add", FlatPolicy(0, a.extent(0)),
+      KOKKOS_LAMBDA(const FlatIndex i) { c[i] = a[i] + b[i]; });
+
+  Kokkos::fence();
+}
+
+template <typename A>
+void perform_flat_triad(const A &a, const A &b, const A &c,
+                        const typename A::value_type scalar) {
+  Kokkos::parallel_for(
+      "flat_triad", FlatPolicy(0, a.extent(0)),
+      KOKKOS_LAMBDA(const FlatIndex i) { a[i] = b[i] + scalar * c[i]; });
+
+  Kokkos::fence();
+}
+
+// Best time of 'ntimes' iterations of the flat Set, Copy, Scale, Add and
+// Triad kernels, in this order.
+template <typename A>
+void time_flat_kernels(const A &a, const A &b, const A &c, const typename A::value_type scalar,
+                       const int ntimes, double times[5]) {
+  for (int n = 0; n < 5; ++n) times[n] = std::numeric_limits<double>::max();
+  Kokkos::Timer timer;
+  for (int k = 0; k < ntimes; ++k) {
+    timer.reset();
+    perform_flat_set(c, 1.5);
+    times[0] = std::min(times[0], timer.seconds());
+    timer.reset();
+    perform_flat_copy(a, c);
+    times[1] = std::min(times[1], timer.seconds());
+    timer.reset();
+    perform_flat_scale(b, c, scalar);
+    times[2] = std::min(times[2], timer.seconds());
+    timer.reset();
+    perform_flat_add(a, b, c);
+    times[3] = std::min(times[3], timer.seconds());
+    timer.reset();
+    perform_flat_triad(a, b, c, scalar);
+    times[4] = std::min(times[4], timer.seconds());
+  }
+}
@@ -0,0 +1,83 @@
+/*
+// Runtime selection of the MDRange index type.
+//
+// The index type of a policy (Kokkos::IndexType<T>) determines the width of
+// the index arithmetic in the tile loops and therefore how well the inner
+// loops vectorise. The kernels are instantiated for 32 and 64 bit indices
+// and for the default index type of the execution space (no IndexType
+// given, as before), and dispatch_index_type() selects one at runtime.
+*/
+
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+enum class IndexWidth { Default, Int32, Int64 };
+
+constexpr IndexWidth index_widths[] = {IndexWidth::Default, IndexWidth::Int32,
+                                       IndexWidth::Int64};
+
+// void stands for the default index type of the execution space
+template <typename T>
+struct IndexTypeConstant {
+  using type = T;
+};
+
+// MDRangePolicy<Traits..., IndexType<Index>>, or MDRangePolicy<Traits...>
+// if Index is void
+template <typename Index, typename... Traits>
+struct IndexedMDRangePolicy {
+  using type = Kokkos::MDRangePolicy<Traits..., Kokkos::IndexType<Index>>;
+};
+template <typename... Traits>
+struct IndexedMDRangePolicy<void, Traits...> {
+  using type = Kokkos::MDRangePolicy<Traits...>;
+};
+
+// lower or upper bound with all entries equal to 'value', in the index
+// type of the MDRangePolicy P
+template <typename P>
+Kokkos::Array<typename P::index_type, P::rank> policy_bounds(const std::int64_t value) {
+  Kokkos::Array<typename P::index_type, P::rank> res;
+  for (std::size_t d = 0; d < P::rank; ++d) res[d] = static_cast<typename P::index_type>(value);
+  return res;
+}
+
+// type of the kernel arguments, 'Fallback' for the default index type
+template <typename Index, typename Fallback>
+using KernelIndexType = std::conditional_t<std::is_void_v<Index>, Fallback, Index>;
+
+inline const char *index_width_name(const IndexWidth w) {
+  switch (w) {
+    case IndexWidth::Int32: return "int32";
+    case IndexWidth::Int64: return "int64";
+    default: return "default";
+  }
+}
+
+// returns false if 'name' is not a valid index type
+inline bool parse_index_width(const char *name, IndexWidth &w) {
+  for (const auto q : index_widths) {
+    if (std::strcmp(name, index_width_name(q)) == 0) {
+      w = q;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Calls f(index) with an IndexTypeConstant matching 'w', such that
+// typename decltype(index)::type can be used as template argument.
+template <typename F>
+void dispatch_index_type(const IndexWidth w, F &&f) {
+  switch (w) {
+    case IndexWidth::Int32: f(IndexTypeConstant<std::int32_t>{}); break;
+    case IndexWidth::Int64: f(IndexTypeConstant<std::int64_t>{}); break;
+    default: f(IndexTypeConstant<void>{}); break;
+  }
+}
@@ -0,0 +1,68 @@
+/*
+// Kernel with a tunable arithmetic intensity for roofline measurements.
+//
+// The FMA chain kernel reads the Triad inputs b and c and writes
+//
+//   a = fma_chain(b, c, nfma),
+//
+// nfma fused multiply-adds r = r * fma_scalar + c per element (24 bytes of
+// traffic per element as Triad). If nfma is a multiple of fma_chains the
+// FMAs are spread over fma_chains independent chains, which keeps the FMA
+// pipelines busy, and the chains are summed at the end; otherwise a single
+// chain is used. With |fma_scalar| < 1 every chain converges to
+// c / (1 - fma_scalar), so any depth stays finite and normal. nfma = 1 has
+// the intensity of Triad (0.083 FLOP/byte), nfma = 600 about 50 FLOP/byte.
+*/
+
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+#include <vector>
+
+#include "stream-flat-alias.hpp"
+
+constexpr int fma_chains    = 8;
+constexpr double fma_scalar = 0.5;
+
+// default sweep, 0.08 ... 50 FLOP/byte
+inline const std::vector<int> default_fma_counts = {1, 2, 4, 8, 16, 32, 64, 128, 256, 512, 600};
+
+KOKKOS_INLINE_FUNCTION double fma_chain(const double x, const double y, const int nfma) {
+  if (nfma % fma_chains != 0) {
+    double r = x;
+    for (int n = 0; n < nfma; ++n) r = r * fma_scalar + y;
+    return r;
+  }
+  // distinct start values, identical chains could be merged by the compiler
+  double r[fma_chains];
+  r[0] = x;
+  for (int c = 1; c < fma_chains; ++c) r[c] = x + 0.125 * c;
+  for (int n = 0; n < nfma / fma_chains; ++n) {
+    for (int c = 0; c < fma_chains; ++c) r[c] = r[c] * fma_scalar + y;
+  }
+  double sum = r[0];
+  for (int c = 1; c < fma_chains; ++c) sum += r[c];
+  return sum;
+}
+
+// FLOP per element: 2 per FMA, plus the start values and the sum of the
+// independent chains
+inline double fma_chain_flops(const int nfma) {
+  return 2.0 * nfma + (nfma % fma_chains == 0 ? 2.0 * (fma_chains - 1) : 0.0);
+}
+
+// bytes per element, read b and c, write a
+template <typename T>
+constexpr double fma_chain_bytes() {
+  return 3.0 * sizeof(T);
+}
+
+template <typename A>
+void perform_flat_fma_chain(const A &a, const A &b, const A &c, const int nfma) {
+  Kokkos::parallel_for(
+      "flat_fma_chain", FlatPolicy(0, a.extent(0)),
+      KOKKOS_LAMBDA(const FlatIndex i) { a[i] = fma_chain(b[i], c[i], nfma); });
+
+  Kokkos::fence();
+}
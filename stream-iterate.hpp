@@ -0,0 +1,76 @@
+/*
+// Runtime selection of the MDRange iteration pattern.
+//
+// Kokkos::Rank<N, outer, inner> fixes at compile time in which order the
+// tiles are traversed (outer) and in which order the elements within a tile
+// are traversed (inner). The kernels are instantiated for all four
+// combinations of Iterate::Left and Iterate::Right, plus the default
+// pattern of the execution space, and dispatch_iterate() selects one of
+// these instantiations at runtime.
+*/
+
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+enum class IteratePattern { Default, RightRight, RightLeft, LeftRight, LeftLeft };
+
+// all explicit (outer, inner) combinations
+constexpr IteratePattern iterate_patterns[] = {IteratePattern::RightRight,
+                                               IteratePattern::RightLeft,
+                                               IteratePattern::LeftRight,
+                                               IteratePattern::LeftLeft};
+
+template <Kokkos::Iterate iterate>
+using IterateConstant = std::integral_constant<Kokkos::Iterate, iterate>;
+
+inline const char *iterate_pattern_name(const IteratePattern p) {
+  switch (p) {
+    case IteratePattern::RightRight: return "right,right";
+    case IteratePattern::RightLeft: return "right,left";
+    case IteratePattern::LeftRight: return "left,right";
+    case IteratePattern::LeftLeft: return "left,left";
+    default: return "default";
+  }
+}
+
+// returns false if 'name' is not a valid iteration pattern
+inline bool parse_iterate_pattern(const char *name, IteratePattern &p) {
+  for (const auto q : {IteratePattern::Default, IteratePattern::RightRight,
+                       IteratePattern::RightLeft, IteratePattern::LeftRight,
+                       IteratePattern::LeftLeft}) {
+    if (std::strcmp(name, iterate_pattern_name(q)) == 0) {
+      p = q;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Calls f(outer, inner) with IterateConstant arguments matching 'p', such
+// that decltype(outer)::value can be used as template argument.
+template <typename F>
+void dispatch_iterate(const IteratePattern p, F &&f) {
+  using Kokkos::Iterate;
+  switch (p) {
+    case IteratePattern::RightRight:
+      f(IterateConstant<Iterate::Right>{}, IterateConstant<Iterate::Right>{});
+      break;
+    case IteratePattern::RightLeft:
+      f(IterateConstant<Iterate::Right>{}, IterateConstant<Iterate::Left>{});
+      break;
+    case IteratePattern::LeftRight:
+      f(IterateConstant<Iterate::Left>{}, IterateConstant<Iterate::Right>{});
+      break;
+    case IteratePattern::LeftLeft:
+      f(IterateConstant<Iterate::Left>{}, IterateConstant<Iterate::Left>{});
+      break;
+    default:
+      f(IterateConstant<Iterate::Default>{}, IterateConstant<Iterate::Default>{});
+      break;
+  }
+}
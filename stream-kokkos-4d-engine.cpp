@@ -0,0 +1,585 @@
+/*
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 3.0
+//       Copyright (2020) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// 1. Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the Corporation nor the names of the
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY NTESS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NTESS OR THE
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ************************************************************************
+//
+// Modifications by Simon Schlepphorst (Uni Bonn) and
+//                  Bartosz Kostrzewa (Uni Bonn) 
+//
+//@HEADER
+*/
+
+// STREAM kernels executed by the MDRange engine of stream-mdrange-engine.hpp,
+// which uses compile-time tile shapes, compared against Kokkos::MDRangePolicy
+// with the same (runtime) tile shape.
+
+#include <Kokkos_Core.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <getopt.h>
+#include <utility>
+#include <iostream>
+#include <limits>
+
+#include <sys/time.h>
+
+#include "stream-affinity.hpp"
+#include "stream-large-index.hpp"
+#include "stream-mdrange-engine.hpp"
+#include "stream-memory.hpp"
+
+#define STREAM_NTIMES 20
+using real_t = double;
+
+#define HLINE "-------------------------------------------------------------\n"
+
+// the engine runs on the host threads, hence the views live in HostSpace
+using StreamDeviceArray =
+    Kokkos::View<real_t ****, Kokkos::HostSpace, Kokkos::MemoryTraits<Kokkos::Restrict>>;
+using constStreamDeviceArray =
+    Kokkos::View<const real_t ****, Kokkos::HostSpace, Kokkos::MemoryTraits<Kokkos::Restrict>>;
+using StreamHostArray = StreamDeviceArray;
+
+using StreamIndex = int;
+
+using StreamExtents = Kokkos::Array<std::int64_t, StreamDeviceArray::rank()>;
+
+// Tile shapes compiled into the binary, selected with -T <index>.
+// The innermost extent is the largest, as for the default MDRangePolicy tiling
+// of LayoutRight views on the host.
+#define STREAM_ENGINE_TILE_SHAPES(X) \
+  X(0, TileShape<1, 1, 1, 128>)      \
+  X(1, TileShape<1, 1, 8, 32>)       \
+  X(2, TileShape<1, 2, 16, 16>)      \
+  X(3, TileShape<2, 2, 4, 32>)       \
+  X(4, TileShape<1, 4, 4, 64>)       \
+  X(5, TileShape<1, 1, 2, 256>)
+
+constexpr int num_tile_shapes = 6;
+
+template <typename Shape>
+using Policy = Kokkos::MDRangePolicy<Kokkos::Rank<Shape::rank>, Kokkos::DefaultHostExecutionSpace>;
+
+template <std::size_t... Idcs>
+constexpr Kokkos::Array<std::int64_t, sizeof...(Idcs)>
+make_repeated_sequence_impl(std::int64_t value, std::integer_sequence<std::size_t, Idcs...>)
+{
+  return { ((void)Idcs, value)... };
+}
+
+template <std::size_t N>
+constexpr Kokkos::Array<std::int64_t,N> make_repeated_sequence(std::int64_t value)
+{
+  return make_repeated_sequence_impl(value, std::make_index_sequence<N>{});
+}
+
+template <typename Shape>
+constexpr Kokkos::Array<std::int64_t, Shape::rank> tile_of() {
+  Kokkos::Array<std::int64_t, Shape::rank> res{};
+  for (std::size_t d = 0; d < Shape::rank; ++d) res[d] = Shape::extents[d];
+  return res;
+}
+
+constexpr real_t ainit = 1.0;
+constexpr real_t binit = 1.1;
+constexpr real_t cinit = 0.0;
+
+void print_tile_shapes() {
+  printf("Available tile shapes:\n");
+#define STREAM_PRINT_SHAPE(idx, ...) \
+  printf("  %d: %s\n", idx, __VA_ARGS__::to_string().c_str());
+  STREAM_ENGINE_TILE_SHAPES(STREAM_PRINT_SHAPE)
+#undef STREAM_PRINT_SHAPE
+}
+
+int parse_args(int argc, char **argv, StreamIndex &stream_array_size, int &shape,
+               TileOrder &order, TileAssignment &assignment, bool &compare) {
+  // Defaults
+  stream_array_size = 32;
+  shape = 1;
+  order = TileOrder::Right;
+  assignment = TileAssignment::Blocks;
+  compare = false;
+
+  const std::string help_string =
+      "  -n <N>, --nelements <N>\n"
+      "     Create stream views containing <N>^4 elements.\n"
+      "     Default: 32\n"
+      "  -T <I>, --tile-shape <I>\n"
+      "     Index of the compile-time tile shape, see --list.\n"
+      "     Default: 1\n"
+      "  -o <O>, --order <O>\n"
+      "     Tile visitation order: right (rightmost tile index fastest) or left.\n"
+      "     Default: right\n"
+      "  -a <A>, --assignment <A>\n"
+      "     Assignment of tiles to threads: blocks, roundrobin or interleaved.\n"
+      "     Default: blocks\n"
+      "  -c, --compare\n"
+      "     Also run all kernels with Kokkos::MDRangePolicy using the same tile\n"
+      "     shape and report the ratio.\n"
+      "  -l, --list\n"
+      "     Lists the tile shapes compiled into the binary.\n"
+      "  -h, --help\n"
+      "     Prints this message.\n"
+      "     Hint: use --kokkos-help to see command line options provided by "
+      "Kokkos.\n";
+
+  static struct option long_options[] = {
+      {"nelements", required_argument, NULL, 'n'},
+      {"tile-shape", required_argument, NULL, 'T'},
+      {"order", required_argument, NULL, 'o'},
+      {"assignment", required_argument, NULL, 'a'},
+      {"compare", no_argument, NULL, 'c'},
+      {"list", no_argument, NULL, 'l'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0}};
+
+  int c;
+  int option_index = 0;
+  while ((c = getopt_long(argc, argv, "n:T:o:a:clh", long_options, &option_index)) !=
+         -1)
+    switch (c) {
+      case 'n':
+        if (!parse_extent(optarg, stream_array_size)) {
+          fprintf(stderr, "Error: '%s' is not a valid number of elements.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'T':
+        if (!parse_int_in_range(optarg, 0, num_tile_shapes - 1, shape)) {
+          fprintf(stderr, "Error: tile shape index must be in [0,%d).\n", num_tile_shapes);
+          print_tile_shapes();
+          return -1;
+        }
+        break;
+      case 'o':
+        if (!parse_tile_order(optarg, order)) {
+          fprintf(stderr, "Error: unknown tile order '%s'.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'a':
+        if (!parse_tile_assignment(optarg, assignment)) {
+          fprintf(stderr, "Error: unknown tile assignment '%s'.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'c': compare = true; break;
+      case 'l':
+        print_tile_shapes();
+        return -2;
+        break;
+      case 'h':
+        printf("%s", help_string.c_str());
+        return -2;
+        break;
+      case 0: break;
+      default:
+        printf("%s", help_string.c_str());
+        return -1;
+        break;
+    }
+  return 0;
+}
+
+template <typename Shape>
+void perform_set(const StreamDeviceArray a, const real_t scalar,
+                 const TileOrder order, const TileAssignment assignment) {
+  engine_parallel_for<Shape>(
+      "set",
+      make_repeated_sequence<Shape::rank>(a.extent(0)), order, assignment,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { a(i,j,k,l) = scalar; });
+}
+
+template <typename Shape>
+void perform_copy(const constStreamDeviceArray a, StreamDeviceArray b,
+                  const TileOrder order, const TileAssignment assignment) {
+  engine_parallel_for<Shape>(
+      "copy",
+      make_repeated_sequence<Shape::rank>(a.extent(0)), order, assignment,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { b(i,j,k,l) = a(i,j,k,l); });
+}
+
+template <typename Shape>
+void perform_scale(StreamDeviceArray b, const constStreamDeviceArray c,
+                   const real_t scalar, const TileOrder order,
+                   const TileAssignment assignment) {
+  engine_parallel_for<Shape>(
+      "scale",
+      make_repeated_sequence<Shape::rank>(b.extent(0)), order, assignment,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { b(i,j,k,l) = scalar * c(i,j,k,l); });
+}
+
+template <typename Shape>
+void perform_add(const constStreamDeviceArray a,
+                 const constStreamDeviceArray b, StreamDeviceArray c,
+                 const TileOrder order, const TileAssignment assignment) {
+  engine_parallel_for<Shape>(
+      "add",
+      make_repeated_sequence<Shape::rank>(a.extent(0)), order, assignment,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { c(i,j,k,l) = a(i,j,k,l) + b(i,j,k,l); });
+}
+
+template <typename Shape>
+void perform_triad(StreamDeviceArray a, const constStreamDeviceArray b,
+                   const constStreamDeviceArray c, const real_t scalar,
+                   const TileOrder order, const TileAssignment assignment) {
+  engine_parallel_for<Shape>(
+      "triad",
+      make_repeated_sequence<Shape::rank>(a.extent(0)), order, assignment,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { a(i,j,k,l) = b(i,j,k,l) + scalar * c(i,j,k,l); });
+}
+
+// best time of 'f' over STREAM_NTIMES runs, with the engine or with
+// Kokkos::MDRangePolicy using the same tile shape
+template <typename Shape, typename F>
+double best_time(const bool engine, const StreamExtents &upper, const TileOrder order,
+                 const TileAssignment assignment, const F &f) {
+  double best = std::numeric_limits<double>::max();
+  Kokkos::Timer timer;
+  for (int k = 0; k < STREAM_NTIMES; ++k) {
+    timer.reset();
+    if (engine) {
+      engine_parallel_for<Shape>("engine", upper, order, assignment, f);
+    } else {
+      Kokkos::parallel_for(
+          "mdrange",
+          Policy<Shape>(make_repeated_sequence<Shape::rank>(0), upper, tile_of<Shape>()), f);
+      Kokkos::fence();
+    }
+    best = std::min(best, timer.seconds());
+  }
+  return best;
+}
+
+template <typename Shape, typename F>
+void compare_kernel(const char *name, const double nstreams, const StreamExtents &upper,
+                    const TileOrder order, const TileAssignment assignment, const F &f) {
+  double nelem = 1.0;
+  for (std::size_t d = 0; d < Shape::rank; ++d) nelem *= upper[d];
+  const double bytes = 1.0e-9 * nstreams * (double)sizeof(real_t) * nelem;
+  const double engine = bytes / best_time<Shape>(true, upper, order, assignment, f);
+  const double mdrange = bytes / best_time<Shape>(false, upper, order, assignment, f);
+  printf("%-8s %14.4f %14.4f %10.3f\n", name, engine, mdrange, engine / mdrange);
+}
+
+// Runs all kernels with the engine and with Kokkos::MDRangePolicy
+// (default iteration pattern) using the same tile shape.
+template <typename Shape>
+void perform_mdrange_comparison(StreamDeviceArray a, StreamDeviceArray b,
+                                StreamDeviceArray c, const real_t scalar,
+                                const TileOrder order, const TileAssignment assignment) {
+  const StreamExtents upper = make_repeated_sequence<Shape::rank>(a.extent(0));
+  printf("Comparison with Kokkos::MDRangePolicy, tile %s:\n", Shape::to_string().c_str());
+  printf("%-8s %14s %14s %10s\n", "kernel", "engine", "mdrange", "ratio");
+  printf("%-8s %14s %14s %10s\n", "", "[Gbyte/s]", "[Gbyte/s]", "");
+  compare_kernel<Shape>("Set", 1.0, upper, order, assignment,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { c(i,j,k,l) = 1.5; });
+  compare_kernel<Shape>("Copy", 2.0, upper, order, assignment,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { c(i,j,k,l) = a(i,j,k,l); });
+  compare_kernel<Shape>("Scale", 2.0, upper, order, assignment,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { b(i,j,k,l) = scalar * c(i,j,k,l); });
+  compare_kernel<Shape>("Add", 3.0, upper, order, assignment,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { c(i,j,k,l) = a(i,j,k,l) + b(i,j,k,l); });
+  compare_kernel<Shape>("Triad", 3.0, upper, order, assignment,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { a(i,j,k,l) = b(i,j,k,l) + scalar * c(i,j,k,l); });
+}
+
+int perform_validation(StreamHostArray &a, StreamHostArray &b,
+                       StreamHostArray &c, const StreamIndex arraySize,
+                       const real_t scalar) {
+  real_t ai = ainit;
+  real_t bi = binit;
+  real_t ci = cinit;
+
+  for (StreamIndex i = 0; i < STREAM_NTIMES; ++i) {
+    ci = ai;
+    bi = scalar * ci;
+    ci = ai + bi;
+    ai = bi + scalar * ci;
+  };
+
+  std::cout << "ai: " << ai << "\n";
+  std::cout << "a(0,0,0,0): " << a(0,0,0,0) << "\n";
+  std::cout << "bi: " << bi << "\n";
+  std::cout << "b(0,0,0,0): " << b(0,0,0,0) << "\n";
+  std::cout << "ci: " << ci << "\n";
+  std::cout << "c(0,0,0,0): " << c(0,0,0,0) << "\n";
+ 
+  const double nelem = (double)arraySize*arraySize*arraySize*arraySize; 
+  const double epsilon = 2*4*STREAM_NTIMES*std::numeric_limits<real_t>::epsilon();
+
+  double aError = 0.0;
+  double bError = 0.0;
+  double cError = 0.0;
+
+  #pragma omp parallel reduction(+:aError,bError,cError)
+  {
+    double err = 0.0;
+    #pragma omp for collapse(2)
+    for (StreamIndex i = 0; i < arraySize; ++i) {
+      for (StreamIndex j = 0; j < arraySize; ++j) {
+        for (StreamIndex k = 0; k < arraySize; ++k) {
+          for (StreamIndex l = 0; l < arraySize; ++l) {
+            err = std::abs(a(i,j,k,l) - ai);
+            if( err > epsilon ){
+              //std::cout << "aError " << " i: " << i << " j: " << j << " k: " << k << " l: " << l << " err: " << err << "\n";
+              aError += err;
+            }
+            err = std::abs(b(i,j,k,l) - bi);
+            if( err > epsilon ){
+              //std::cout << "bError " << " i: " << i << " j: " << j << " k: " << k << " l: " << l << " err: " << err << "\n";
+              bError += err;
+            }
+            err = std::abs(c(i,j,k,l) - ci);
+            if( err > epsilon ){
+              //std::cout << "cError " << " i: " << i << " j: " << j << " k: " << k << " l: " << l << " err: " << err << "\n";
+              cError += err;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  std::cout << "aError = " << aError << "\n";
+  std::cout << "bError = " << bError << "\n";
+  std::cout << "cError = " << cError << "\n";
+
+  real_t aAvgError = aError / nelem;
+  real_t bAvgError = bError / nelem;
+  real_t cAvgError = cError / nelem;
+
+  std::cout << "aAvgErr = " << aAvgError << "\n";
+  std::cout << "bAvgError = " << bAvgError << "\n";
+  std::cout << "cAvgError = " << cAvgError << "\n";
+
+  int errorCount       = 0;
+
+  if (std::abs(aAvgError / ai) > epsilon) {
+    fprintf(stderr, "Error: validation check on View a failed.\n");
+    errorCount++;
+  }
+
+  if (std::abs(bAvgError / bi) > epsilon) {
+    fprintf(stderr, "Error: validation check on View b failed.\n");
+    errorCount++;
+  }
+
+  if (std::abs(cAvgError / ci) > epsilon) {
+    fprintf(stderr, "Error: validation check on View c failed.\n");
+    errorCount++;
+  }
+
+  if (errorCount == 0) {
+    printf("All solutions checked and verified.\n");
+  }
+
+  return errorCount;
+}
+
+template <typename Shape>
+int run_benchmark(const StreamIndex stream_array_size, const TileOrder order,
+                  const TileAssignment assignment, const bool compare) {
+  printf("Reports fastest timing per kernel\n");
+  report_memory_usage("initialize");
+  printf("Creating Views...\n");
+
+  const double nelem = (double)stream_array_size*
+                       (double)stream_array_size*
+                       (double)stream_array_size*
+                       (double)stream_array_size;
+
+  printf("Memory Sizes:\n");
+  printf("- Array Size:    %" PRIu64 "^4\n",
+         static_cast<uint64_t>(stream_array_size));
+  printf("- Per Array:     %12.2f MB\n",
+         1.0e-6 * nelem * (double)sizeof(real_t));
+  printf("- Total: %12.2f MB\n",
+         3.0e-6 * nelem * (double)sizeof(real_t));
+
+  printf("Benchmark kernels will be performed for %d iterations.\n",
+         STREAM_NTIMES);
+
+  printf("Engine configuration:\n");
+  printf("- Tile shape:    %s (%" PRId64 " tiles)\n", Shape::to_string().c_str(),
+         StaticTileMDRange<Shape>(make_repeated_sequence<Shape::rank>(stream_array_size),
+                                  order, assignment)
+             .num_tiles());
+  printf("- Tile order:    %s\n", tile_order_name(order));
+  printf("- Assignment:    %s\n", tile_assignment_name(assignment));
+
+  printf(HLINE);
+
+  // WithoutInitializing to circumvent first touch bug on arm systems
+  StreamDeviceArray a(Kokkos::view_alloc(Kokkos::WithoutInitializing, "a"),
+                      stream_array_size,stream_array_size,stream_array_size,stream_array_size);
+  StreamDeviceArray b(Kokkos::view_alloc(Kokkos::WithoutInitializing, "b"),
+                      stream_array_size,stream_array_size,stream_array_size,stream_array_size);
+  StreamDeviceArray c(Kokkos::view_alloc(Kokkos::WithoutInitializing, "c"),
+                      stream_array_size,stream_array_size,stream_array_size,stream_array_size);
+
+  const double scalar = 1.1;
+
+  double setTime   = std::numeric_limits<double>::max();
+  double copyTime  = std::numeric_limits<double>::max();
+  double scaleTime = std::numeric_limits<double>::max();
+  double addTime   = std::numeric_limits<double>::max();
+  double triadTime = std::numeric_limits<double>::max();
+
+  report_memory_usage("allocation");
+  printf("Initializing Views...\n");
+
+  // first touch with the same tile assignment as the kernels
+  engine_parallel_for<Shape>(
+      "init",
+      make_repeated_sequence<Shape::rank>(stream_array_size), order, assignment,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
+        a(i,j,k,l) = ainit;
+        b(i,j,k,l) = binit;
+        c(i,j,k,l) = cinit;
+      });
+
+  report_memory_usage("first touch");
+  printf("Starting benchmarking...\n");
+
+  Kokkos::Timer timer;
+
+  for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+    timer.reset();
+    perform_set<Shape>(c, 1.5, order, assignment);
+    setTime = std::min(setTime, timer.seconds());
+
+    timer.reset();
+    perform_copy<Shape>(a, c, order, assignment);
+    copyTime = std::min(copyTime, timer.seconds());
+
+    timer.reset();
+    perform_scale<Shape>(b, c, scalar, order, assignment);
+    scaleTime = std::min(scaleTime, timer.seconds());
+
+    timer.reset();
+    perform_add<Shape>(a, b, c, order, assignment);
+    addTime = std::min(addTime, timer.seconds());
+
+    timer.reset();
+    perform_triad<Shape>(a, b, c, scalar, order, assignment);
+    triadTime = std::min(triadTime, timer.seconds());
+  }
+
+  report_memory_usage("kernels");
+  printf("Performing validation...\n");
+  int rc = perform_validation(a, b, c, stream_array_size, scalar);
+  report_memory_usage("validation");
+
+  printf(HLINE);
+
+  printf("Set             %11.4f GB/s\n",
+         (1.0e-09 * 1.0 * (double)sizeof(real_t) * (double)a.size()) /
+             setTime);
+  printf("Copy            %11.4f GB/s\n",
+         real_t(1.0e-09 * 2.0 * (double)sizeof(real_t) *
+                (double)a.size()) /
+                copyTime);
+  printf("Scale           %11.4f GB/s\n",
+         real_t(1.0e-09 * 2.0 * (double)sizeof(real_t) *
+                (double)a.size()) /
+                scaleTime);
+  printf("Add             %11.4f GB/s\n",
+         real_t(1.0e-09 * 3.0 * (double)sizeof(real_t) *
+                (double)a.size()) /
+                addTime);
+  printf("Triad           %11.4f GB/s\n",
+         real_t(1.0e-09 * 3.0 * (double)sizeof(real_t) *
+                (double)a.size()) /
+                triadTime);
+
+  printf(HLINE);
+
+  if (compare) {
+    // runs after validation, the views are overwritten
+    perform_mdrange_comparison<Shape>(a, b, c, scalar, order, assignment);
+    printf(HLINE);
+  }
+
+  return rc;
+}
+
+int main(int argc, char *argv[]) {
+  printf(HLINE);
+  printf("Kokkos 4D MDRange engine STREAM Benchmark\n");
+  printf(HLINE);
+
+  Kokkos::initialize(argc, argv);
+  int rc;
+  StreamIndex stream_array_size;
+  int shape;
+  TileOrder order;
+  TileAssignment assignment;
+  bool compare;
+  rc = parse_args(argc, argv, stream_array_size, shape, order, assignment, compare);
+  if (rc == 0) {
+    report_thread_affinity();
+    printf(HLINE);
+    switch (shape) {
+#define STREAM_RUN_SHAPE(idx, ...)                                              \
+  case idx:                                                                     \
+    rc = run_benchmark<__VA_ARGS__>(stream_array_size, order, assignment, compare); \
+    break;
+      STREAM_ENGINE_TILE_SHAPES(STREAM_RUN_SHAPE)
+#undef STREAM_RUN_SHAPE
+    }
+  } else if (rc == -2) {
+    // Don't return error code when called with "-h"
+    rc = 0;
+  }
+  Kokkos::finalize();
+
+  return rc;
+}
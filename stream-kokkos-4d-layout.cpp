@@ -0,0 +1,444 @@
+/*
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 3.0
+//       Copyright (2020) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// 1. Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the Corporation nor the names of the
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY NTESS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NTESS OR THE
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ************************************************************************
+//
+// Modifications by Simon Schlepphorst (Uni Bonn) and
+//                  Bartosz Kostrzewa (Uni Bonn) 
+//
+//@HEADER
+*/
+
+// STREAM kernels on 4D views with LayoutRight, LayoutLeft, a permuted
+// LayoutStride and padded LayoutRight / LayoutLeft, each run with an
+// MDRangePolicy in all four combinations of outer and inner Iterate. Shows what code written for the
+// default GPU layout (LayoutLeft) costs on CPUs and vice versa.
+//
+// Kokkos::AllowPadding only pads the stride-one extent if it exceeds four
+// 64 byte alignment units and is not a multiple of one already, so for the
+// usual extents it would not pad at all. The padded cases are therefore
+// LayoutStride views with the row-major / column-major strides of a
+// stride-one extent rounded up to an odd multiple of the alignment.
+
+#include <Kokkos_Core.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <getopt.h>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <iostream>
+#include <limits>
+
+#include <sys/time.h>
+
+#include "stream-affinity.hpp"
+#include "stream-iterate.hpp"
+#include "stream-large-index.hpp"
+#include "stream-memory.hpp"
+#include "stream-validation.hpp"
+
+#define STREAM_NTIMES 20
+using real_t = double;
+
+#define HLINE "-------------------------------------------------------------\n"
+
+template <typename Layout>
+using StreamDeviceArray =
+    Kokkos::View<real_t ****, Layout, Kokkos::MemoryTraits<Kokkos::Restrict>>;
+
+using StreamIndex = int;
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner>
+using Policy = Kokkos::MDRangePolicy<Kokkos::Rank<4, outer, inner>>;
+
+enum class LayoutCase { Right, Left, Stride, PaddedRight, PaddedLeft };
+
+constexpr real_t ainit = 1.0;
+constexpr real_t binit = 1.1;
+constexpr real_t cinit = 0.0;
+
+// order of the dimensions of the LayoutStride case from the fastest to the
+// slowest running one
+constexpr int stride_order[4] = {1, 3, 0, 2};
+
+// elements per 64 byte alignment unit
+constexpr StreamIndex padding_alignment = 64 / sizeof(real_t);
+
+bool is_padded_case(const LayoutCase lc) {
+  return lc == LayoutCase::PaddedRight || lc == LayoutCase::PaddedLeft;
+}
+
+// smallest odd multiple of the alignment larger than n, such that rows
+// neither start at the same cache set nor coincide with the unpadded layout
+StreamIndex padded_extent(const StreamIndex n) {
+  StreamIndex units = n / padding_alignment + 1;
+  if (units % 2 == 0) ++units;
+  return units * padding_alignment;
+}
+
+const char *layout_case_name(const LayoutCase lc) {
+  switch (lc) {
+    case LayoutCase::Right: return "right";
+    case LayoutCase::Left: return "left";
+    case LayoutCase::Stride: return "stride";
+    case LayoutCase::PaddedRight: return "padded-right";
+    default: return "padded-left";
+  }
+}
+
+int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
+  // Defaults
+  stream_array_size = 32;
+
+  const std::string help_string =
+      "  -n <N>, --nelements <N>\n"
+      "     Create stream views containing <N>^4 elements.\n"
+      "     Default: 32\n"
+      "  -h, --help\n"
+      "     Prints this message.\n"
+      "     Hint: use --kokkos-help to see command line options provided by "
+      "Kokkos.\n";
+
+  static struct option long_options[] = {
+      {"nelements", required_argument, NULL, 'n'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0}};
+
+  int c;
+  int option_index = 0;
+  while ((c = getopt_long(argc, argv, "n:h", long_options, &option_index)) !=
+         -1)
+    switch (c) {
+      case 'n':
+        if (!parse_extent(optarg, stream_array_size)) {
+          fprintf(stderr, "Error: '%s' is not a valid number of elements.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'h':
+        printf("%s", help_string.c_str());
+        return -2;
+        break;
+      case 0: break;
+      default:
+        printf("%s", help_string.c_str());
+        return -1;
+        break;
+    }
+  return 0;
+}
+
+template <typename Layout>
+StreamDeviceArray<Layout> make_array(const std::string &label, const LayoutCase lc,
+                                     const StreamIndex n) {
+  if constexpr (std::is_same_v<Layout, Kokkos::LayoutStride>) {
+    if (is_padded_case(lc)) {
+      const std::size_t e = n;
+      const std::size_t p = padded_extent(n);
+      const auto layout = lc == LayoutCase::PaddedRight
+                              ? Kokkos::LayoutStride(e, p * e * e, e, p * e, e, p, e, 1)
+                              : Kokkos::LayoutStride(e, 1, e, p, e, p * e, e, p * e * e);
+      return StreamDeviceArray<Layout>(Kokkos::view_alloc(Kokkos::WithoutInitializing, label),
+                                       layout);
+    }
+    const int dims[4] = {n, n, n, n};
+    return StreamDeviceArray<Layout>(Kokkos::view_alloc(Kokkos::WithoutInitializing, label),
+                                     Kokkos::LayoutStride::order_dimensions(4, stride_order, dims));
+  } else {
+    return StreamDeviceArray<Layout>(Kokkos::view_alloc(Kokkos::WithoutInitializing, label),
+                                     n, n, n, n);
+  }
+}
+
+// the policy is matched to the layout if its innermost loop runs over the
+// stride-one dimension
+template <Kokkos::Iterate inner, typename V>
+bool is_matched(const V &a) {
+  return inner == Kokkos::Iterate::Left ? a.stride(0) == 1 : a.stride(3) == 1;
+}
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, typename V>
+void perform_set(const V a, const real_t scalar) {
+  const StreamIndex n = a.extent(0);
+  Kokkos::parallel_for(
+      "set",
+      Policy<outer, inner>({0, 0, 0, 0}, {n, n, n, n}),
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { a(i,j,k,l) = scalar; });
+
+  Kokkos::fence();
+}
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, typename V>
+void perform_copy(const V a, const V b) {
+  const StreamIndex n = a.extent(0);
+  Kokkos::parallel_for(
+      "copy",
+      Policy<outer, inner>({0, 0, 0, 0}, {n, n, n, n}),
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { b(i,j,k,l) = a(i,j,k,l); });
+
+  Kokkos::fence();
+}
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, typename V>
+void perform_scale(const V b, const V c, const real_t scalar) {
+  const StreamIndex n = b.extent(0);
+  Kokkos::parallel_for(
+      "scale",
+      Policy<outer, inner>({0, 0, 0, 0}, {n, n, n, n}),
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { b(i,j,k,l) = scalar * c(i,j,k,l); });
+
+  Kokkos::fence();
+}
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, typename V>
+void perform_add(const V a, const V b, const V c) {
+  const StreamIndex n = a.extent(0);
+  Kokkos::parallel_for(
+      "add",
+      Policy<outer, inner>({0, 0, 0, 0}, {n, n, n, n}),
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { c(i,j,k,l) = a(i,j,k,l) + b(i,j,k,l); });
+
+  Kokkos::fence();
+}
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, typename V>
+void perform_triad(const V a, const V b, const V c, const real_t scalar) {
+  const StreamIndex n = a.extent(0);
+  Kokkos::parallel_for(
+      "triad",
+      Policy<outer, inner>({0, 0, 0, 0}, {n, n, n, n}),
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { a(i,j,k,l) = b(i,j,k,l) + scalar * c(i,j,k,l); });
+
+  Kokkos::fence();
+}
+
+// Compares all elements to the expected values on the device, returns the
+// number of views which failed the check.
+template <typename V>
+int perform_validation(const V dev_a, const V dev_b, const V dev_c, const real_t scalar) {
+  real_t ai = ainit;
+  real_t bi = binit;
+  real_t ci = cinit;
+
+  for (StreamIndex i = 0; i < STREAM_NTIMES; ++i) {
+    ci = ai;
+    bi = scalar * ci;
+    ci = ai + bi;
+    ai = bi + scalar * ci;
+  };
+
+  const double nelem = (double)dev_a.size();
+  const double epsilon = 2*4*STREAM_NTIMES*std::numeric_limits<real_t>::epsilon();
+
+  const ValidationErrors errors = validate_on_device(dev_a, dev_b, dev_c, ai, bi, ci, epsilon);
+
+  int errorCount = 0;
+  if (std::abs(errors.sum[0] / nelem / ai) > epsilon) errorCount++;
+  if (std::abs(errors.sum[1] / nelem / bi) > epsilon) errorCount++;
+  if (std::abs(errors.sum[2] / nelem / ci) > epsilon) errorCount++;
+  return errorCount;
+}
+
+template <typename Layout>
+void print_layout(const LayoutCase lc, const StreamIndex n) {
+  // metadata only, nothing is touched
+  const auto a = make_array<Layout>("a", lc, n);
+  printf("- %-13s strides [%zu,%zu,%zu,%zu]  span/size %.4f\n", layout_case_name(lc),
+         static_cast<std::size_t>(a.stride(0)), static_cast<std::size_t>(a.stride(1)),
+         static_cast<std::size_t>(a.stride(2)), static_cast<std::size_t>(a.stride(3)),
+         (double)a.span() / (double)a.size());
+}
+
+// Runs all kernels for one combination of layout and iteration pattern and
+// prints one row of the result table.
+template <typename Layout, Kokkos::Iterate outer, Kokkos::Iterate inner>
+int run_case(const LayoutCase lc, const IteratePattern pattern, const StreamIndex n) {
+  auto dev_a = make_array<Layout>("a", lc, n);
+  auto dev_b = make_array<Layout>("b", lc, n);
+  auto dev_c = make_array<Layout>("c", lc, n);
+  if (is_padded_case(lc) && dev_a.span() <= dev_a.size()) {
+    fprintf(stderr, "Error: the %s views are not padded.\n", layout_case_name(lc));
+    return 3;
+  }
+
+  const double scalar = 1.1;
+
+  double setTime   = std::numeric_limits<double>::max();
+  double copyTime  = std::numeric_limits<double>::max();
+  double scaleTime = std::numeric_limits<double>::max();
+  double addTime   = std::numeric_limits<double>::max();
+  double triadTime = std::numeric_limits<double>::max();
+
+  // first touch with the same iteration pattern as the kernels
+  Kokkos::parallel_for(
+      "init_dev",
+      Policy<outer, inner>({0, 0, 0, 0}, {n, n, n, n}),
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
+        dev_a(i,j,k,l) = ainit;
+        dev_b(i,j,k,l) = binit;
+        dev_c(i,j,k,l) = cinit;
+      });
+  Kokkos::fence();
+
+  Kokkos::Timer timer;
+
+  for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+    timer.reset();
+    perform_set<outer, inner>(dev_c, 1.5);
+    setTime = std::min(setTime, timer.seconds());
+
+    timer.reset();
+    perform_copy<outer, inner>(dev_a, dev_c);
+    copyTime = std::min(copyTime, timer.seconds());
+
+    timer.reset();
+    perform_scale<outer, inner>(dev_b, dev_c, scalar);
+    scaleTime = std::min(scaleTime, timer.seconds());
+
+    timer.reset();
+    perform_add<outer, inner>(dev_a, dev_b, dev_c);
+    addTime = std::min(addTime, timer.seconds());
+
+    timer.reset();
+    perform_triad<outer, inner>(dev_a, dev_b, dev_c, scalar);
+    triadTime = std::min(triadTime, timer.seconds());
+  }
+
+  const int rc = perform_validation(dev_a, dev_b, dev_c, scalar);
+
+  const double bytes = 1.0e-09 * (double)sizeof(real_t) * (double)dev_a.size();
+  printf("%-13s %-12s %-7s %10.4f %10.4f %10.4f %10.4f %10.4f  %s\n", layout_case_name(lc),
+         iterate_pattern_name(pattern), is_matched<inner>(dev_a) ? "yes" : "no",
+         1.0 * bytes / setTime, 2.0 * bytes / copyTime, 2.0 * bytes / scaleTime,
+         3.0 * bytes / addTime, 3.0 * bytes / triadTime, rc == 0 ? "ok" : "FAILED");
+  return rc;
+}
+
+template <typename Layout>
+int run_layout(const LayoutCase lc, const StreamIndex n) {
+  int rc = 0;
+  for (const auto pattern : iterate_patterns) {
+    dispatch_iterate(pattern, [&](auto outer, auto inner) {
+      rc += run_case<Layout, decltype(outer)::value, decltype(inner)::value>(lc, pattern, n);
+    });
+  }
+  return rc;
+}
+
+int run_benchmark(const StreamIndex stream_array_size) {
+  printf("Reports fastest timing per kernel\n");
+  report_memory_usage("initialize");
+
+  const double nelem = (double)stream_array_size*
+                       (double)stream_array_size*
+                       (double)stream_array_size*
+                       (double)stream_array_size;
+
+  printf("Memory Sizes:\n");
+  printf("- Array Size:    %" PRIu64 "^4\n",
+         static_cast<uint64_t>(stream_array_size));
+  printf("- Per Array:     %12.2f MB\n",
+         1.0e-6 * nelem * (double)sizeof(real_t));
+  printf("- Total: %12.2f MB\n",
+         3.0e-6 * nelem * (double)sizeof(real_t));
+
+  printf("Benchmark kernels will be performed for %d iterations.\n",
+         STREAM_NTIMES);
+
+  printf("Layouts:\n");
+  print_layout<Kokkos::LayoutRight>(LayoutCase::Right, stream_array_size);
+  print_layout<Kokkos::LayoutLeft>(LayoutCase::Left, stream_array_size);
+  print_layout<Kokkos::LayoutStride>(LayoutCase::Stride, stream_array_size);
+  print_layout<Kokkos::LayoutStride>(LayoutCase::PaddedRight, stream_array_size);
+  print_layout<Kokkos::LayoutStride>(LayoutCase::PaddedLeft, stream_array_size);
+
+  printf(HLINE);
+
+  printf("%-13s %-12s %-7s %10s %10s %10s %10s %10s  %s\n", "layout", "outer,inner", "matched",
+         "Set", "Copy", "Scale", "Add", "Triad", "valid");
+  printf("%-13s %-12s %-7s %10s %10s %10s %10s %10s\n", "", "", "", "[Gbyte/s]",
+         "[Gbyte/s]", "[Gbyte/s]", "[Gbyte/s]", "[Gbyte/s]");
+
+  int rc = 0;
+  rc += run_layout<Kokkos::LayoutRight>(LayoutCase::Right, stream_array_size);
+  rc += run_layout<Kokkos::LayoutLeft>(LayoutCase::Left, stream_array_size);
+  rc += run_layout<Kokkos::LayoutStride>(LayoutCase::Stride, stream_array_size);
+  rc += run_layout<Kokkos::LayoutStride>(LayoutCase::PaddedRight, stream_array_size);
+  rc += run_layout<Kokkos::LayoutStride>(LayoutCase::PaddedLeft, stream_array_size);
+
+  report_memory_usage("benchmark");
+
+  printf(HLINE);
+
+  if (rc != 0) {
+    fprintf(stderr, "Error: validation check failed for %d views.\n", rc);
+  } else {
+    printf("All solutions checked and verified.\n");
+  }
+
+  return rc;
+}
+
+int main(int argc, char *argv[]) {
+  printf(HLINE);
+  printf("Kokkos 4D MDRangePolicy layout comparison STREAM Benchmark\n");
+  printf(HLINE);
+
+  Kokkos::initialize(argc, argv);
+  int rc;
+  StreamIndex stream_array_size;
+  rc = parse_args(argc, argv, stream_array_size);
+  if (rc == 0) {
+    report_thread_affinity();
+    printf(HLINE);
+    rc = run_benchmark(stream_array_size);
+  } else if (rc == -2) {
+    // Don't return error code when called with "-h"
+    rc = 0;
+  }
+  Kokkos::finalize();
+
+  return rc;
+}
@@ -55,6 +55,12 @@
 
 #include <sys/time.h>
 
+#include "stream-affinity.hpp"
+#include "stream-index-type.hpp"
+#include "stream-large-index.hpp"
+#include "stream-memory.hpp"
+#include "stream-validation.hpp"
+
 #define STREAM_NTIMES 20
 using real_t = double;
 
@@ -69,12 +75,14 @@ using constStreamDeviceArray =
 using constStreamDeviceArray =
     Kokkos::View<const real_t ****, Kokkos::MemoryTraits<Kokkos::Restrict>>;
 #endif
-using StreamHostArray = typename StreamDeviceArray::HostMirror;
+using StreamIndex = int;
 
-using StreamIndex = long int;
+template <int rank, typename Index = void>
+using Policy      = typename IndexedMDRangePolicy<Index, Kokkos::Rank<rank>>::type;
 
-template <int rank>
-using Policy      = Kokkos::MDRangePolicy<Kokkos::Rank<rank>>;
+// argument type of the kernels for the policy index type Index
+template <typename Index>
+using KernelIndex = KernelIndexType<Index, StreamIndex>;
 
 template <std::size_t... Idcs>
 constexpr Kokkos::Array<StreamIndex, sizeof...(Idcs)>
@@ -93,14 +101,20 @@ constexpr real_t ainit = 1.0;
 constexpr real_t binit = 1.1;
 constexpr real_t cinit = 0.0;
 
-int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
+int parse_args(int argc, char **argv, StreamIndex &stream_array_size,
+               IndexWidth &index_width) {
   // Defaults
   stream_array_size = 32;
+  index_width = IndexWidth::Default;
 
   const std::string help_string =
       "  -n <N>, --nelements <N>\n"
       "     Create stream views containing <N>^4 elements.\n"
       "     Default: 32\n"
+      "  -x <T>, --index-type <T>\n"
+      "     Index type of the MDRangePolicy, int32, int64 or default (the\n"
+      "     default index type of the execution space).\n"
+      "     Default: default\n"
       "  -h, --help\n"
       "     Prints this message.\n"
       "     Hint: use --kokkos-help to see command line options provided by "
@@ -108,15 +122,27 @@ int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
 
   static struct option long_options[] = {
       {"nelements", required_argument, NULL, 'n'},
+      {"index-type", required_argument, NULL, 'x'},
       {"help", no_argument, NULL, 'h'},
       {NULL, 0, NULL, 0}};
 
   int c;
   int option_index = 0;
-  while ((c = getopt_long(argc, argv, "n:h", long_options, &option_index)) !=
+  while ((c = getopt_long(argc, argv, "n:x:h", long_options, &option_index)) !=
          -1)
     switch (c) {
-      case 'n': stream_array_size = atoi(optarg); break;
+      case 'n':
+        if (!parse_extent(optarg, stream_array_size)) {
+          fprintf(stderr, "Error: '%s' is not a valid number of elements.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'x':
+        if (!parse_index_width(optarg, index_width)) {
+          fprintf(stderr, "Error: '%s' is not a valid index type.\n", optarg);
+          return -1;
+        }
+        break;
       case 'h':
         printf("%s", help_string.c_str());
         return -2;
@@ -130,76 +156,81 @@ int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
   return 0;
 }
 
+template <typename Index = void>
 void perform_set(const StreamDeviceArray a, const real_t scalar) {
   constexpr auto rank = a.rank();
-  const auto stream_array_size = a.extent(0);
-  Kokkos::Array<StreamIndex,rank> tiling = Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0))).tile_size_recommended();
+  using P = Policy<rank, Index>;
+  const auto tiling = P(policy_bounds<P>(0), policy_bounds<P>(a.extent(0))).tile_size_recommended();
   Kokkos::parallel_for(
-      "set", 
-      Policy<rank>(make_repeated_sequence<rank>(0),make_repeated_sequence<rank>(a.extent(0)),tiling),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      "set",
+      P(policy_bounds<P>(0), policy_bounds<P>(a.extent(0)), tiling),
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
       { a(i,j,k,l) = scalar; });
 
   Kokkos::fence();
 }
 
+template <typename Index = void>
 void perform_copy(const constStreamDeviceArray a, StreamDeviceArray b) {
   constexpr auto rank = a.rank();
-  const auto stream_array_size = a.extent(0);
-  Kokkos::Array<StreamIndex,rank> tiling = Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0))).tile_size_recommended();
+  using P = Policy<rank, Index>;
+  const auto tiling = P(policy_bounds<P>(0), policy_bounds<P>(a.extent(0))).tile_size_recommended();
   Kokkos::parallel_for(
       "copy",
-      Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)),tiling),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      P(policy_bounds<P>(0), policy_bounds<P>(a.extent(0)), tiling),
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
       { b(i,j,k,l) = a(i,j,k,l); });
 
   Kokkos::fence();
 }
 
+template <typename Index = void>
 void perform_scale(StreamDeviceArray b, const constStreamDeviceArray c,
                    const real_t scalar) {
   constexpr auto rank = b.rank();
-  const auto stream_array_size = b.extent(0);
-  Kokkos::Array<StreamIndex,rank> tiling = Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(b.extent(0))).tile_size_recommended();
+  using P = Policy<rank, Index>;
+  const auto tiling = P(policy_bounds<P>(0), policy_bounds<P>(b.extent(0))).tile_size_recommended();
   Kokkos::parallel_for(
       "scale",
-      Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(b.extent(0)),tiling),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      P(policy_bounds<P>(0), policy_bounds<P>(b.extent(0)), tiling),
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
       { b(i,j,k,l) = scalar * c(i,j,k,l); });
 
   Kokkos::fence();
 }
 
+template <typename Index = void>
 void perform_add(const constStreamDeviceArray a,
                  const constStreamDeviceArray b, StreamDeviceArray c) {
   constexpr auto rank = a.rank();
-  const auto stream_array_size = a.extent(0);
-  Kokkos::Array<StreamIndex,rank> tiling = Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0))).tile_size_recommended();
+  using P = Policy<rank, Index>;
+  const auto tiling = P(policy_bounds<P>(0), policy_bounds<P>(a.extent(0))).tile_size_recommended();
   Kokkos::parallel_for(
       "add",
-      Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)),tiling),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      P(policy_bounds<P>(0), policy_bounds<P>(a.extent(0)), tiling),
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
       { c(i,j,k,l) = a(i,j,k,l) + b(i,j,k,l); });
 
   Kokkos::fence();
 }
 
+template <typename Index = void>
 void perform_triad(StreamDeviceArray a, const constStreamDeviceArray b,
                    const constStreamDeviceArray c, const real_t scalar) {
   constexpr auto rank = a.rank();
-  const auto stream_array_size = a.extent(0);
-  Kokkos::Array<StreamIndex,rank> tiling = Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0))).tile_size_recommended();
+  using P = Policy<rank, Index>;
+  const auto tiling = P(policy_bounds<P>(0), policy_bounds<P>(a.extent(0))).tile_size_recommended();
   Kokkos::parallel_for(
-      "triad", 
-      Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)),tiling),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      "triad",
+      P(policy_bounds<P>(0), policy_bounds<P>(a.extent(0)), tiling),
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
       { a(i,j,k,l) = b(i,j,k,l) + scalar * c(i,j,k,l); });
 
   Kokkos::fence();
 }
 
-int perform_validation(StreamHostArray &a, StreamHostArray &b,
-                       StreamHostArray &c, const StreamIndex arraySize,
+int perform_validation(const StreamDeviceArray &a, const StreamDeviceArray &b,
+                       const StreamDeviceArray &c, const StreamIndex arraySize,
                        const real_t scalar) {
   real_t ai = ainit;
   real_t bi = binit;
@@ -213,47 +244,19 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
   };
 
   std::cout << "ai: " << ai << "\n";
-  std::cout << "a(0,0,0,0): " << a(0,0,0,0) << "\n";
+  std::cout << "a(0,0,0,0): " << first_element(a) << "\n";
   std::cout << "bi: " << bi << "\n";
-  std::cout << "b(0,0,0,0): " << b(0,0,0,0) << "\n";
+  std::cout << "b(0,0,0,0): " << first_element(b) << "\n";
   std::cout << "ci: " << ci << "\n";
-  std::cout << "c(0,0,0,0): " << c(0,0,0,0) << "\n";
+  std::cout << "c(0,0,0,0): " << first_element(c) << "\n";
  
   const double nelem = (double)arraySize*arraySize*arraySize*arraySize; 
   const double epsilon = 2*4*STREAM_NTIMES*std::numeric_limits<real_t>::epsilon();
 
-  double aError = 0.0;
-  double bError = 0.0;
-  double cError = 0.0;
-
-  #pragma omp parallel reduction(+:aError,bError,cError)
-  {
-    double err = 0.0;
-    #pragma omp for collapse(2)
-    for (StreamIndex i = 0; i < arraySize; ++i) {
-      for (StreamIndex j = 0; j < arraySize; ++j) {
-        for (StreamIndex k = 0; k < arraySize; ++k) {
-          for (StreamIndex l = 0; l < arraySize; ++l) {
-            err = std::abs(a(i,j,k,l) - ai);
-            if( err > epsilon ){
-              //std::cout << "aError " << " i: " << i << " j: " << j << " k: " << k << " l: " << l << " err: " << err << "\n";
-              aError += err;
-            }
-            err = std::abs(b(i,j,k,l) - bi);
-            if( err > epsilon ){
-              //std::cout << "bError " << " i: " << i << " j: " << j << " k: " << k << " l: " << l << " err: " << err << "\n";
-              bError += err;
-            }
-            err = std::abs(c(i,j,k,l) - ci);
-            if( err > epsilon ){
-              //std::cout << "cError " << " i: " << i << " j: " << j << " k: " << k << " l: " << l << " err: " << err << "\n";
-              cError += err;
-            }
-          }
-        }
-      }
-    }
-  }
+  const ValidationErrors errors = validate_on_device(a, b, c, ai, bi, ci, epsilon);
+  const double aError = errors.sum[0];
+  const double bError = errors.sum[1];
+  const double cError = errors.sum[2];
 
   std::cout << "aError = " << aError << "\n";
   std::cout << "bError = " << bError << "\n";
@@ -266,6 +269,9 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
   std::cout << "aAvgErr = " << aAvgError << "\n";
   std::cout << "bAvgError = " << bAvgError << "\n";
   std::cout << "cAvgError = " << cAvgError << "\n";
+  std::cout << "aMaxErr = " << errors.max[0] << "\n";
+  std::cout << "bMaxErr = " << errors.max[1] << "\n";
+  std::cout << "cMaxErr = " << errors.max[2] << "\n";
 
   int errorCount       = 0;
 
@@ -291,8 +297,9 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
   return errorCount;
 }
 
-int run_benchmark(const StreamIndex stream_array_size) {
+int run_benchmark(const StreamIndex stream_array_size, const IndexWidth index_width) {
   printf("Reports fastest timing per kernel\n");
+  report_memory_usage("initialize");
   printf("Creating Views...\n");
 
   const double nelem = (double)stream_array_size*
@@ -321,10 +328,6 @@ int run_benchmark(const StreamIndex stream_array_size) {
   StreamDeviceArray dev_c(Kokkos::view_alloc(Kokkos::WithoutInitializing, "c"),
                           stream_array_size,stream_array_size,stream_array_size,stream_array_size);
 
-  StreamHostArray a = Kokkos::create_mirror_view(dev_a);
-  StreamHostArray b = Kokkos::create_mirror_view(dev_b);
-  StreamHostArray c = Kokkos::create_mirror_view(dev_c);
-
   const double scalar = 1.1;
 
   double setTime   = std::numeric_limits<double>::max();
@@ -333,29 +336,17 @@ int run_benchmark(const StreamIndex stream_array_size) {
   double addTime   = std::numeric_limits<double>::max();
   double triadTime = std::numeric_limits<double>::max();
 
+  report_memory_usage("allocation");
   printf("Initializing Views...\n");
 
-  Kokkos::Array<StreamIndex,a.rank()> tiling = Policy<a.rank()>(make_repeated_sequence<a.rank()>(0), make_repeated_sequence<a.rank()>(stream_array_size)).tile_size_recommended();
-  std::cout << "Extents: [" << a.extent(0) << "," << a.extent(1) << "," << a.extent(2) << "," << a.extent(3) << "]    " <<
+  const auto tiling = Policy<dev_a.rank()>(make_repeated_sequence<dev_a.rank()>(0), make_repeated_sequence<dev_a.rank()>(stream_array_size)).tile_size_recommended();
+  std::cout << "Extents: [" << dev_a.extent(0) << "," << dev_a.extent(1) << "," << dev_a.extent(2) << "," << dev_a.extent(3) << "]    " <<
     "Recommended tiling: [" << tiling[0] << "," << tiling[1] << "," << tiling[2] << "," << tiling[3] << "]\n";
 
-  Kokkos::parallel_for(
-      "init",
-      Kokkos::MDRangePolicy<Kokkos::Rank<a.rank()>,
-                            Kokkos::DefaultHostExecutionSpace>(make_repeated_sequence<a.rank()>(0),
-                                                               make_repeated_sequence<a.rank()>(stream_array_size),
-                                                               tiling),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
-        a(i,j,k,l) = ainit;
-        b(i,j,k,l) = binit;
-        c(i,j,k,l) = cinit;
-      });
-  Kokkos::fence();
-
   Kokkos::parallel_for(
       "init_dev",
-      Kokkos::MDRangePolicy<Kokkos::Rank<a.rank()>>(make_repeated_sequence<a.rank()>(0),
-                                                    make_repeated_sequence<a.rank()>(stream_array_size),
+      Kokkos::MDRangePolicy<Kokkos::Rank<dev_a.rank()>>(make_repeated_sequence<dev_a.rank()>(0),
+                                                    make_repeated_sequence<dev_a.rank()>(stream_array_size),
                                                     tiling),
       KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
         dev_a(i,j,k,l) = ainit;
@@ -364,59 +355,65 @@ int run_benchmark(const StreamIndex stream_array_size) {
       });
   Kokkos::fence();
 
+  printf("Index type:        %s\n", index_width_name(index_width));
+  warn_int32_index(index_width, dev_a.size());
+  report_memory_usage("first touch");
   printf("Starting benchmarking...\n");
 
   Kokkos::Timer timer;
 
-  for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
-    timer.reset();
-    perform_set(dev_c, 1.5);
-    setTime = std::min(setTime, timer.seconds());
-
-    timer.reset();
-    perform_copy(dev_a, dev_c);
-    copyTime = std::min(copyTime, timer.seconds());
+  dispatch_index_type(index_width, [&](auto index) {
+    using Index = typename decltype(index)::type;
+    for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+      timer.reset();
+      perform_set<Index>(dev_c, 1.5);
+      setTime = std::min(setTime, timer.seconds());
 
-    timer.reset();
-    perform_scale(dev_b, dev_c, scalar);
-    scaleTime = std::min(scaleTime, timer.seconds());
+      timer.reset();
+      perform_copy<Index>(dev_a, dev_c);
+      copyTime = std::min(copyTime, timer.seconds());
 
-    timer.reset();
-    perform_add(dev_a, dev_b, dev_c);
-    addTime = std::min(addTime, timer.seconds());
+      timer.reset();
+      perform_scale<Index>(dev_b, dev_c, scalar);
+      scaleTime = std::min(scaleTime, timer.seconds());
 
-    timer.reset();
-    perform_triad(dev_a, dev_b, dev_c, scalar);
-    triadTime = std::min(triadTime, timer.seconds());
-  }
+      timer.reset();
+      perform_add<Index>(dev_a, dev_b, dev_c);
+      addTime = std::min(addTime, timer.seconds());
 
-  Kokkos::deep_copy(a, dev_a);
-  Kokkos::deep_copy(b, dev_b);
-  Kokkos::deep_copy(c, dev_c);
+      timer.reset();
+      perform_triad<Index>(dev_a, dev_b, dev_c, scalar);
+      triadTime = std::min(triadTime, timer.seconds());
+    }
+  });
 
+  report_memory_usage("kernels");
   printf("Performing validation...\n");
-  int rc = perform_validation(a, b, c, stream_array_size, scalar);
+  timer.reset();
+  int rc = perform_validation(dev_a, dev_b, dev_c, stream_array_size, scalar);
+  printf("Validation time: %.4f s\n", timer.seconds());
+  report_memory_usage("validation");
 
   printf(HLINE);
 
   printf("Set             %11.4f GB/s\n",
-         (1.0e-09 * 1.0 * (double)sizeof(real_t) * (double)a.size()) /
+         (1.0e-09 * 1.0 * (double)sizeof(real_t) * (double)dev_a.size()) /
              setTime);
   printf("Copy            %11.4f GB/s\n",
          real_t(1.0e-09 * 2.0 * (double)sizeof(real_t) *
-                (double)a.size()) /
+                (double)dev_a.size()) /
                 copyTime);
   printf("Scale           %11.4f GB/s\n",
          real_t(1.0e-09 * 2.0 * (double)sizeof(real_t) *
-                (double)a.size()) /
+                (double)dev_a.size()) /
                 scaleTime);
   printf("Add             %11.4f GB/s\n",
          real_t(1.0e-09 * 3.0 * (double)sizeof(real_t) *
-                (double)a.size()) /
+                (double)dev_a.size()) /
                 addTime);
   printf("Triad           %11.4f GB/s\n",
          real_t(1.0e-09 * 3.0 * (double)sizeof(real_t) *
-                (double)a.size()) /
+                (double)dev_a.size()) /
                 triadTime);
 
   printf(HLINE);
@@ -432,9 +429,12 @@ int main(int argc, char *argv[]) {
   Kokkos::initialize(argc, argv);
   int rc;
   StreamIndex stream_array_size;
-  rc = parse_args(argc, argv, stream_array_size);
+  IndexWidth index_width;
+  rc = parse_args(argc, argv, stream_array_size, index_width);
   if (rc == 0) {
-    rc = run_benchmark(stream_array_size);
+    report_thread_affinity();
+    printf(HLINE);
+    rc = run_benchmark(stream_array_size, index_width);
   } else if (rc == -2) {
     // Don't return error code when called with "-h"
     rc = 0;
@@ -52,9 +52,21 @@
 #include <utility>
 #include <iostream>
 #include <limits>
+#include <string>
+#include <vector>
 
 #include <sys/time.h>
 
+#include "stream-affinity.hpp"
+#include "stream-cost-model.hpp"
+#include "stream-index-type.hpp"
+#include "stream-memory.hpp"
+#include "stream-tile-accounting.hpp"
+#include "stream-iterate.hpp"
+#include "stream-large-index.hpp"
+#include "stream-tiling.hpp"
+#include "stream-validation.hpp"
+
 #define STREAM_NTIMES 20
 using real_t = double;
 
@@ -73,8 +85,15 @@ using StreamHostArray = typename StreamDeviceArray::HostMirror;
 
 using StreamIndex = int;
 
-template <int rank>
-using Policy      = Kokkos::MDRangePolicy<Kokkos::Rank<rank>>;
+template <int rank, Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
+using Policy      = typename IndexedMDRangePolicy<Index, Kokkos::Rank<rank, outer, inner>>::type;
+
+// argument type of the kernels for the policy index type Index
+template <typename Index>
+using KernelIndex = KernelIndexType<Index, StreamIndex>;
+
+using StreamTiling = Kokkos::Array<std::size_t, StreamDeviceArray::rank()>;
 
 template <std::size_t... Idcs>
 constexpr Kokkos::Array<std::size_t, sizeof...(Idcs)>
@@ -134,10 +153,25 @@ constexpr real_t ainit = 1.0;
 constexpr real_t binit = 1.1;
 constexpr real_t cinit = 0.0;
 
-int parse_args(int argc, char **argv, StreamIndex &stream_array_size, size_t &tiling_factor) {
+int parse_args(int argc, char **argv, StreamIndex &stream_array_size, size_t &tiling_factor,
+               bool &instrument, int &tile_count_threads, bool &heuristic,
+               bool &scan, IteratePattern &iterate, bool &iterate_all,
+               IndexWidth &index_width,
+               bool &large_index_test, CostModelParameters &model,
+               std::string &model_file) {
   // Defaults
+  model = CostModelParameters();
+  model_file = "";
+  large_index_test = false;
   stream_array_size = 32;
   tiling_factor = 1;
+  instrument = false;
+  tile_count_threads = 0;
+  heuristic = false;
+  scan = false;
+  iterate = IteratePattern::Default;
+  iterate_all = false;
+  index_width = IndexWidth::Default;
 
   const std::string help_string =
       "  -n <N>, --nelements <N>\n"
@@ -146,6 +180,35 @@ int parse_args(int argc, char **argv, StreamIndex &stream_array_size, size_t &ti
       "  -f <F>, --factor <F>\n"
       "     factor to inversely scale the fastest and slowest-running tile dimensions\n"
       "     Default: 1\n"
+      "  -i, --instrument\n"
+      "     After the benchmark, run all kernels on the host with per-thread\n"
+      "     tile, element and busy-time accounting and report the load imbalance.\n"
+      "  -t <T>, --tile-count <T>\n"
+      "     Only print the number of tiles and their distribution over <T> threads\n"
+      "     for all tiling factors from 1 to 64, then exit.\n"
+      "  -m <FILE>, --model <FILE>\n"
+      "     Rank the tilings of -t with the cost model parameters in <FILE>, as\n"
+      "     written by stream-cost-model-fit -o. Without it the uncalibrated\n"
+      "     default parameters are used.\n"
+      "  -H, --heuristic\n"
+      "     Use the cache-topology-aware tiling heuristic instead of the tiling factor.\n"
+      "  -s, --scan\n"
+      "     After the benchmark, measure all tiling factors from 1 to 64 as well as\n"
+      "     the heuristic tiling and compare the heuristic pick to the measured best.\n"
+      "  -I <P>, --iterate <P>\n"
+      "     MDRange iteration pattern <outer>,<inner> of the kernels, one of\n"
+      "     default, right,right, right,left, left,right and left,left.\n"
+      "     Default: default\n"
+      "  -A, --iterate-all\n"
+      "     After the benchmark, run all kernels with all four explicit\n"
+      "     iteration patterns and the same tiling.\n"
+      "  -x <T>, --index-type <T>\n"
+      "     Index type of the MDRangePolicy, int32, int64 or default (the\n"
+      "     default index type of the execution space).\n"
+      "     Default: default\n"
+      "  -L, --large-index-test\n"
+      "     Only check the index arithmetic for more than 2^32 elements (no\n"
+      "     memory is allocated), then exit.\n"
       "  -h, --help\n"
       "     Prints this message.\n"
       "     Hint: use --kokkos-help to see command line options provided by "
@@ -154,16 +217,65 @@ int parse_args(int argc, char **argv, StreamIndex &stream_array_size, size_t &ti
   static struct option long_options[] = {
       {"nelements", required_argument, NULL, 'n'},
       {"factor", required_argument, NULL, 'f'},
+      {"instrument", no_argument, NULL, 'i'},
+      {"tile-count", required_argument, NULL, 't'},
+      {"model", required_argument, NULL, 'm'},
+      {"heuristic", no_argument, NULL, 'H'},
+      {"scan", no_argument, NULL, 's'},
+      {"iterate", required_argument, NULL, 'I'},
+      {"iterate-all", no_argument, NULL, 'A'},
+      {"index-type", required_argument, NULL, 'x'},
+      {"large-index-test", no_argument, NULL, 'L'},
       {"help", no_argument, NULL, 'h'},
       {NULL, 0, NULL, 0}};
 
   int c;
   int option_index = 0;
-  while ((c = getopt_long(argc, argv, "n:f:h", long_options, &option_index)) !=
+  while ((c = getopt_long(argc, argv, "n:f:it:m:HsI:Ax:Lh", long_options, &option_index)) !=
          -1)
     switch (c) {
-      case 'n': stream_array_size = atoi(optarg); break;
-      case 'f': tiling_factor = static_cast<size_t>(atoi(optarg)); break;
+      case 'n':
+        if (!parse_extent(optarg, stream_array_size)) {
+          fprintf(stderr, "Error: '%s' is not a valid number of elements.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'L': large_index_test = true; break;
+      case 'f': {
+        int factor;
+        if (!parse_int_in_range(optarg, 1, INT_MAX, factor)) {
+          fprintf(stderr, "Error: '%s' is not a valid tiling factor.\n", optarg);
+          return -1;
+        }
+        tiling_factor = static_cast<size_t>(factor);
+        break;
+      }
+      case 'i': instrument = true; break;
+      case 't':
+        if (!parse_int_in_range(optarg, 1, INT_MAX, tile_count_threads)) {
+          fprintf(stderr, "Error: '%s' is not a valid number of threads.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'm':
+        if (!read_cost_model_parameters(optarg, model)) return -1;
+        model_file = optarg;
+        break;
+      case 'H': heuristic = true; break;
+      case 's': scan = true; break;
+      case 'I':
+        if (!parse_iterate_pattern(optarg, iterate)) {
+          fprintf(stderr, "Error: unknown iteration pattern '%s'.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'A': iterate_all = true; break;
+      case 'x':
+        if (!parse_index_width(optarg, index_width)) {
+          fprintf(stderr, "Error: '%s' is not a valid index type.\n", optarg);
+          return -1;
+        }
+        break;
       case 'h':
         printf("%s", help_string.c_str());
         return -2;
@@ -177,73 +289,234 @@ int parse_args(int argc, char **argv, StreamIndex &stream_array_size, size_t &ti
   return 0;
 }
 
-void perform_set(const StreamDeviceArray a, const real_t scalar, const size_t tiling_factor) {
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
+void perform_set(const StreamDeviceArray a, const real_t scalar, const StreamTiling &tiling) {
   constexpr auto rank = a.rank();
-  const auto tiling = get_tiling(a,tiling_factor);
+  using P = Policy<rank, outer, inner, Index>;
   Kokkos::parallel_for(
-      "set", 
-      Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      "set",
+      P(policy_bounds<P>(0), policy_bounds<P>(a.extent(0)), tiling),
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
       { a(i,j,k,l) = scalar; });
 
   Kokkos::fence();
 }
 
-void perform_copy(const constStreamDeviceArray a, StreamDeviceArray b, const size_t tiling_factor) {
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
+void perform_copy(const constStreamDeviceArray a, StreamDeviceArray b, const StreamTiling &tiling) {
   constexpr auto rank = a.rank();
-  const auto tiling = get_tiling(a,tiling_factor);
+  using P = Policy<rank, outer, inner, Index>;
   Kokkos::parallel_for(
       "copy",
-      Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      P(policy_bounds<P>(0), policy_bounds<P>(a.extent(0)), tiling),
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
       { b(i,j,k,l) = a(i,j,k,l); });
 
   Kokkos::fence();
 }
 
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
 void perform_scale(StreamDeviceArray a, const constStreamDeviceArray b,
-                   const real_t scalar, const size_t tiling_factor) {
+                   const real_t scalar, const StreamTiling &tiling) {
   constexpr auto rank = b.rank();
-  const auto tiling = get_tiling(a,tiling_factor);
+  using P = Policy<rank, outer, inner, Index>;
   Kokkos::parallel_for(
       "scale",
-      Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      P(policy_bounds<P>(0), policy_bounds<P>(a.extent(0)), tiling),
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
       { a(i,j,k,l) = scalar * b(i,j,k,l); });
 
   Kokkos::fence();
 }
 
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
 void perform_add(const constStreamDeviceArray a,
                  const constStreamDeviceArray b, StreamDeviceArray c,
-                 const size_t tiling_factor) {
+                 const StreamTiling &tiling) {
   constexpr auto rank = a.rank();
-  const auto tiling = get_tiling(a,tiling_factor);
+  using P = Policy<rank, outer, inner, Index>;
   Kokkos::parallel_for(
       "add",
-      Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)),tiling),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      P(policy_bounds<P>(0), policy_bounds<P>(a.extent(0)), tiling),
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
       { c(i,j,k,l) = a(i,j,k,l) + b(i,j,k,l); });
 
   Kokkos::fence();
 }
 
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
 void perform_triad(StreamDeviceArray a, const constStreamDeviceArray b,
                    const constStreamDeviceArray c, const real_t scalar,
-                   const size_t tiling_factor) {
+                   const StreamTiling &tiling) {
   constexpr auto rank = a.rank();
-  const auto tiling = get_tiling(a,tiling_factor);
+  using P = Policy<rank, outer, inner, Index>;
   Kokkos::parallel_for(
-      "triad", 
-      Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)),tiling),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      "triad",
+      P(policy_bounds<P>(0), policy_bounds<P>(a.extent(0)), tiling),
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
       { a(i,j,k,l) = b(i,j,k,l) + scalar * c(i,j,k,l); });
 
   Kokkos::fence();
 }
 
-int perform_validation(StreamHostArray &a, StreamHostArray &b,
-                       StreamHostArray &c, const StreamIndex arraySize,
+void perform_instrumented(const StreamHostArray a, const StreamHostArray b,
+                          const StreamHostArray c, const real_t scalar,
+                          const StreamTiling &tiling) {
+  constexpr auto rank = a.rank();
+  const auto upper = make_repeated_sequence<rank>(a.extent(0));
+  const auto acc = make_tile_accounting();
+
+  printf("Instrumented kernels, accumulated over %d iterations (timings not representative):\n",
+         STREAM_NTIMES);
+  print_tile_counts(upper, tiling, static_cast<int>(acc.extent(0)));
+
+  double wallTime = 0.0;
+  reset_tile_accounting(acc);
+  for (int n = 0; n < STREAM_NTIMES; ++n) {
+    wallTime += instrumented_parallel_for("set", upper, tiling, acc,
+      [=](const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { c(i,j,k,l) = 1.5; });
+  }
+  report_tile_accounting("set", acc, wallTime);
+
+  wallTime = 0.0;
+  reset_tile_accounting(acc);
+  for (int n = 0; n < STREAM_NTIMES; ++n) {
+    wallTime += instrumented_parallel_for("copy", upper, tiling, acc,
+      [=](const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { c(i,j,k,l) = a(i,j,k,l); });
+  }
+  report_tile_accounting("copy", acc, wallTime);
+
+  wallTime = 0.0;
+  reset_tile_accounting(acc);
+  for (int n = 0; n < STREAM_NTIMES; ++n) {
+    wallTime += instrumented_parallel_for("scale", upper, tiling, acc,
+      [=](const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { b(i,j,k,l) = scalar * c(i,j,k,l); });
+  }
+  report_tile_accounting("scale", acc, wallTime);
+
+  wallTime = 0.0;
+  reset_tile_accounting(acc);
+  for (int n = 0; n < STREAM_NTIMES; ++n) {
+    wallTime += instrumented_parallel_for("add", upper, tiling, acc,
+      [=](const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { c(i,j,k,l) = a(i,j,k,l) + b(i,j,k,l); });
+  }
+  report_tile_accounting("add", acc, wallTime);
+
+  wallTime = 0.0;
+  reset_tile_accounting(acc);
+  for (int n = 0; n < STREAM_NTIMES; ++n) {
+    wallTime += instrumented_parallel_for("triad", upper, tiling, acc,
+      [=](const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { a(i,j,k,l) = b(i,j,k,l) + scalar * c(i,j,k,l); });
+  }
+  report_tile_accounting("triad", acc, wallTime);
+}
+
+void perform_tiling_scan(StreamDeviceArray a, StreamDeviceArray b,
+                         StreamDeviceArray c, const real_t scalar,
+                         const IteratePattern iterate, const IndexWidth index_width) {
+  std::vector<StreamTiling> tilings;
+  std::vector<std::string> labels;
+  for (size_t factor = 1; factor <= 64; factor *= 2) {
+    tilings.push_back(get_tiling(a, factor));
+    labels.push_back("factor " + std::to_string(factor));
+  }
+  const auto heuristic = heuristic_tiling(a);
+  tilings.push_back(heuristic);
+  labels.push_back("heuristic");
+
+  const double nbytes = (double)sizeof(real_t) * (double)a.size();
+  std::vector<double> triadBW(tilings.size());
+
+  printf("Tiling scan, best of %d iterations:\n", STREAM_NTIMES);
+  Kokkos::Timer timer;
+  for (size_t t = 0; t < tilings.size(); ++t) {
+    double copyTime  = std::numeric_limits<double>::max();
+    double triadTime = std::numeric_limits<double>::max();
+    dispatch_index_type(index_width, [&](auto index) {
+      using Index = typename decltype(index)::type;
+      dispatch_iterate(iterate, [&](auto outer, auto inner) {
+        constexpr Kokkos::Iterate outer_it = decltype(outer)::value;
+        constexpr Kokkos::Iterate inner_it = decltype(inner)::value;
+        for (int k = 0; k < STREAM_NTIMES; ++k) {
+          timer.reset();
+          perform_copy<outer_it, inner_it, Index>(a, c, tilings[t]);
+          copyTime = std::min(copyTime, timer.seconds());
+
+          timer.reset();
+          perform_triad<outer_it, inner_it, Index>(a, b, c, scalar, tilings[t]);
+          triadTime = std::min(triadTime, timer.seconds());
+        }
+      });
+    });
+    triadBW[t] = 1.0e-09 * 3.0 * nbytes / triadTime;
+    printf("- %-10s %-22s Copy %11.4f GB/s  Triad %11.4f GB/s\n",
+           labels[t].c_str(), tiling_to_string(tilings[t]).c_str(),
+           1.0e-09 * 2.0 * nbytes / copyTime, triadBW[t]);
+  }
+
+  const size_t best = std::max_element(triadBW.begin(), triadBW.end()) - triadBW.begin();
+  const size_t pick = tilings.size() - 1;
+  size_t pick_rank = 1;
+  for (size_t t = 0; t < tilings.size(); ++t) {
+    if (triadBW[t] > triadBW[pick]) ++pick_rank;
+  }
+  printf("Heuristic pick %s reaches %.1f%% of the measured best %s %s (rank %zu of %zu)\n",
+         tiling_to_string(heuristic).c_str(), 100.0 * triadBW[pick] / triadBW[best],
+         labels[best].c_str(), tiling_to_string(tilings[best]).c_str(),
+         pick_rank, tilings.size());
+}
+
+void perform_tile_count_scan(const StreamIndex stream_array_size, const int nthreads,
+                             const CostModelParameters &model, const std::string &model_file) {
+  // unmanaged view without data, only used to derive the tiling from the extents
+  const StreamDeviceArray view(static_cast<real_t *>(nullptr), stream_array_size, stream_array_size, stream_array_size, stream_array_size);
+  constexpr auto rank = view.rank();
+  const auto extents = make_repeated_sequence<rank>(stream_array_size);
+  const bool layout_right =
+      !std::is_same_v<typename StreamDeviceArray::array_layout, Kokkos::LayoutLeft>;
+
+  // rank the tilings with the cost model, the uncalibrated defaults use the
+  // LLC size of this machine
+  CostModelParameters params = model;
+  if (model_file.empty()) {
+    const CpuTopology topo = read_cpu_topology();
+    if (const CacheLevel *llc = topo.cache(3)) {
+      params.llc_bytes = (double)llc->size * topo.cpus / llc->shared_cpus;
+    }
+    printf("Cost model: uncalibrated default parameters, fit them with\n"
+           "stream-cost-model-fit -o <file> and pass -m <file>.\n");
+  } else {
+    printf("Cost model: parameters from %s\n", model_file.c_str());
+  }
+  std::vector<double> predicted;
+  for (size_t factor = 1; factor <= 64; factor *= 2) {
+    predicted.push_back(predict_bandwidth(make_cost_model_input(rank, extents,
+                                                                get_tiling(view, factor),
+                                                                nthreads, 3, layout_right),
+                                          params).bandwidth);
+  }
+  const double best = *std::max_element(predicted.begin(), predicted.end());
+
+  printf("Tile counts for %d threads:\n", nthreads);
+  for (size_t factor = 1, i = 0; factor <= 64; factor *= 2, ++i) {
+    printf("- Tiling Factor: %2lu  model: %5.1f%% of best  ", factor,
+           100.0 * predicted[i] / best);
+    print_tile_counts(extents, get_tiling(view, factor), nthreads);
+  }
+}
+
+int perform_validation(const StreamDeviceArray &a, const StreamDeviceArray &b,
+                       const StreamDeviceArray &c, const StreamIndex arraySize,
                        const real_t scalar) {
   real_t ai = ainit;
   real_t bi = binit;
@@ -257,11 +530,11 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
   };
 
   std::cout << "ai: " << ai << "\n";
-  std::cout << "a(0,0,0,0): " << a(0,0,0,0) << "\n";
+  std::cout << "a(0,0,0,0): " << first_element(a) << "\n";
   std::cout << "bi: " << bi << "\n";
-  std::cout << "b(0,0,0,0): " << b(0,0,0,0) << "\n";
+  std::cout << "b(0,0,0,0): " << first_element(b) << "\n";
   std::cout << "ci: " << ci << "\n";
-  std::cout << "c(0,0,0,0): " << c(0,0,0,0) << "\n";
+  std::cout << "c(0,0,0,0): " << first_element(c) << "\n";
  
   const double nelem = (double)arraySize*
                        (double)arraySize*
@@ -270,35 +543,10 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
 
   const double epsilon = 2*4*STREAM_NTIMES*std::numeric_limits<real_t>::epsilon();
 
-  double aError = 0.0;
-  double bError = 0.0;
-  double cError = 0.0;
-
-  #pragma omp parallel reduction(+:aError,bError,cError)
-  {
-    double err = 0.0;
-    #pragma omp for collapse(2)
-    for (StreamIndex i = 0; i < arraySize; ++i) {
-      for (StreamIndex j = 0; j < arraySize; ++j) {
-        for (StreamIndex k = 0; k < arraySize; ++k) {
-          for (StreamIndex l = 0; l < arraySize; ++l) {
-            err = std::abs(a(i,j,k,l) - ai);
-            if( err > epsilon ){
-              aError += err;
-            }
-            err = std::abs(b(i,j,k,l) - bi);
-            if( err > epsilon ){
-              bError += err;
-            }
-            err = std::abs(c(i,j,k,l) - ci);
-            if( err > epsilon ){
-              cError += err;
-            }
-          }
-        }
-      }
-    }
-  }
+  const ValidationErrors errors = validate_on_device(a, b, c, ai, bi, ci, epsilon);
+  const double aError = errors.sum[0];
+  const double bError = errors.sum[1];
+  const double cError = errors.sum[2];
 
   std::cout << "aError = " << aError << "\n";
   std::cout << "bError = " << bError << "\n";
@@ -311,6 +559,9 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
   std::cout << "aAvgErr = " << aAvgError << "\n";
   std::cout << "bAvgError = " << bAvgError << "\n";
   std::cout << "cAvgError = " << cAvgError << "\n";
+  std::cout << "aMaxErr = " << errors.max[0] << "\n";
+  std::cout << "bMaxErr = " << errors.max[1] << "\n";
+  std::cout << "cMaxErr = " << errors.max[2] << "\n";
 
   int errorCount       = 0;
 
@@ -336,8 +587,55 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
   return errorCount;
 }
 
-int run_benchmark(const StreamIndex stream_array_size, const size_t tiling_factor) {
+// Times every kernel with all four combinations of the outer and inner
+// iteration direction, using the same tiling.
+void perform_iterate_sweep(StreamDeviceArray a, StreamDeviceArray b,
+                           StreamDeviceArray c, const real_t scalar,
+                           const StreamTiling &tiling) {
+  const double streams[] = {1.0, 2.0, 2.0, 3.0, 3.0};
+  printf("Iteration patterns with tiling %s:\n", tiling_to_string(tiling).c_str());
+  printf("%-12s %10s %10s %10s %10s %10s\n", "outer,inner", "Set", "Copy", "Scale", "Add",
+         "Triad");
+  printf("%-12s %10s %10s %10s %10s %10s\n", "", "[Gbyte/s]", "[Gbyte/s]", "[Gbyte/s]",
+         "[Gbyte/s]", "[Gbyte/s]");
+  for (const auto pattern : iterate_patterns) {
+    double times[5];
+    for (int n = 0; n < 5; ++n) times[n] = std::numeric_limits<double>::max();
+    dispatch_iterate(pattern, [&](auto outer, auto inner) {
+      constexpr Kokkos::Iterate outer_it = decltype(outer)::value;
+      constexpr Kokkos::Iterate inner_it = decltype(inner)::value;
+      Kokkos::Timer timer;
+      for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+        timer.reset();
+        perform_set<outer_it, inner_it>(c, 1.5, tiling);
+        times[0] = std::min(times[0], timer.seconds());
+        timer.reset();
+        perform_copy<outer_it, inner_it>(a, c, tiling);
+        times[1] = std::min(times[1], timer.seconds());
+        timer.reset();
+        perform_scale<outer_it, inner_it>(b, c, scalar, tiling);
+        times[2] = std::min(times[2], timer.seconds());
+        timer.reset();
+        perform_add<outer_it, inner_it>(a, b, c, tiling);
+        times[3] = std::min(times[3], timer.seconds());
+        timer.reset();
+        perform_triad<outer_it, inner_it>(a, b, c, scalar, tiling);
+        times[4] = std::min(times[4], timer.seconds());
+      }
+    });
+    const double bytes = 1.0e-9 * (double)sizeof(real_t) * (double)a.size();
+    printf("%-12s", iterate_pattern_name(pattern));
+    for (int n = 0; n < 5; ++n) printf(" %10.4f", streams[n] * bytes / times[n]);
+    printf("\n");
+  }
+}
+
+int run_benchmark(const StreamIndex stream_array_size, const size_t tiling_factor,
+                  const bool instrument, const bool heuristic, const bool scan,
+                  const IteratePattern iterate, const bool iterate_all,
+                  const IndexWidth index_width) {
   printf("Reports fastest timing per kernel\n");
+  report_memory_usage("initialize");
   printf("Creating Views...\n");
 
   const double nelem = (double)stream_array_size*
@@ -352,7 +650,11 @@ int run_benchmark(const StreamIndex stream_array_size, const size_t tiling_facto
          1.0e-6 * nelem * (double)sizeof(real_t));
   printf("- Total: %12.2f MB\n",
          3.0e-6 * nelem * (double)sizeof(real_t));
-  printf("- Tiling Factor: %lu\n", tiling_factor);
+  if (heuristic) {
+    printf("- Tiling:        heuristic\n");
+  } else {
+    printf("- Tiling Factor: %lu\n", tiling_factor);
+  }
 
   printf("Benchmark kernels will be performed for %d iterations.\n",
          STREAM_NTIMES);
@@ -367,10 +669,6 @@ int run_benchmark(const StreamIndex stream_array_size, const size_t tiling_facto
   StreamDeviceArray dev_c(Kokkos::view_alloc(Kokkos::WithoutInitializing, "c"),
                           stream_array_size,stream_array_size,stream_array_size,stream_array_size);
 
-  StreamHostArray a = Kokkos::create_mirror_view(dev_a);
-  StreamHostArray b = Kokkos::create_mirror_view(dev_b);
-  StreamHostArray c = Kokkos::create_mirror_view(dev_c);
-
   const double scalar = 1.1;
 
   double setTime   = std::numeric_limits<double>::max();
@@ -379,27 +677,13 @@ int run_benchmark(const StreamIndex stream_array_size, const size_t tiling_facto
   double addTime   = std::numeric_limits<double>::max();
   double triadTime = std::numeric_limits<double>::max();
 
+  report_memory_usage("allocation");
   printf("Initializing Views...\n");
 
-  auto tiling = get_tiling(a,tiling_factor);
-  Kokkos::parallel_for(
-      "init",
-      Kokkos::MDRangePolicy<Kokkos::Rank<a.rank()>,
-                            Kokkos::DefaultHostExecutionSpace>(make_repeated_sequence<a.rank()>(0),
-                                                               make_repeated_sequence<a.rank()>(stream_array_size),
-                                                               tiling),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
-        a(i,j,k,l) = ainit;
-        b(i,j,k,l) = binit;
-        c(i,j,k,l) = cinit;
-      });
-  Kokkos::fence();
-  
-
   const auto dev_policy = Policy<dev_a.rank()>(make_repeated_sequence<dev_a.rank()>(0),
                                                make_repeated_sequence<dev_a.rank()>(stream_array_size));
   const auto recommended_tiling = dev_policy.tile_size_recommended();
-  tiling = get_tiling(dev_a,tiling_factor);
+  const StreamTiling tiling = heuristic ? heuristic_tiling(dev_a, 3, true) : get_tiling(dev_a,tiling_factor);
 
   std::cout << "Recommended tiling: [";
   for( size_t i = 0; i < recommended_tiling.size(); ++i){
@@ -427,38 +711,49 @@ int run_benchmark(const StreamIndex stream_array_size, const size_t tiling_facto
       });
   Kokkos::fence();
 
+  printf("Iteration pattern: %s\n", iterate_pattern_name(iterate));
+  printf("Index type:        %s\n", index_width_name(index_width));
+  warn_int32_index(index_width, dev_a.size());
+  report_memory_usage("first touch");
   printf("Starting benchmarking...\n");
 
   Kokkos::Timer timer;
 
-  for (int k = 0; k < STREAM_NTIMES; ++k) {
-    timer.reset();
-    perform_set(dev_c, 1.5, tiling_factor);
-    setTime = std::min(setTime, timer.seconds());
-
-    timer.reset();
-    perform_copy(dev_a, dev_c, tiling_factor);
-    copyTime = std::min(copyTime, timer.seconds());
-
-    timer.reset();
-    perform_scale(dev_b, dev_c, scalar, tiling_factor);
-    scaleTime = std::min(scaleTime, timer.seconds());
-
-    timer.reset();
-    perform_add(dev_a, dev_b, dev_c, tiling_factor);
-    addTime = std::min(addTime, timer.seconds());
-
-    timer.reset();
-    perform_triad(dev_a, dev_b, dev_c, scalar, tiling_factor);
-    triadTime = std::min(triadTime, timer.seconds());
-  }
-
-  Kokkos::deep_copy(a, dev_a);
-  Kokkos::deep_copy(b, dev_b);
-  Kokkos::deep_copy(c, dev_c);
+  dispatch_index_type(index_width, [&](auto index) {
+    using Index = typename decltype(index)::type;
+    dispatch_iterate(iterate, [&](auto outer, auto inner) {
+      constexpr Kokkos::Iterate outer_it = decltype(outer)::value;
+      constexpr Kokkos::Iterate inner_it = decltype(inner)::value;
+      for (int k = 0; k < STREAM_NTIMES; ++k) {
+        timer.reset();
+        perform_set<outer_it, inner_it, Index>(dev_c, 1.5, tiling);
+        setTime = std::min(setTime, timer.seconds());
+
+        timer.reset();
+        perform_copy<outer_it, inner_it, Index>(dev_a, dev_c, tiling);
+        copyTime = std::min(copyTime, timer.seconds());
+
+        timer.reset();
+        perform_scale<outer_it, inner_it, Index>(dev_b, dev_c, scalar, tiling);
+        scaleTime = std::min(scaleTime, timer.seconds());
+
+        timer.reset();
+        perform_add<outer_it, inner_it, Index>(dev_a, dev_b, dev_c, tiling);
+        addTime = std::min(addTime, timer.seconds());
+
+        timer.reset();
+        perform_triad<outer_it, inner_it, Index>(dev_a, dev_b, dev_c, scalar, tiling);
+        triadTime = std::min(triadTime, timer.seconds());
+      }
+    });
+  });
 
+  report_memory_usage("kernels");
   printf("Performing validation...\n");
-  int rc = perform_validation(a, b, c, stream_array_size, scalar);
+  timer.reset();
+  int rc = perform_validation(dev_a, dev_b, dev_c, stream_array_size, scalar);
+  printf("Validation time: %.4f s\n", timer.seconds());
+  report_memory_usage("validation");
 
   printf(HLINE);
 
@@ -479,6 +774,30 @@ int run_benchmark(const StreamIndex stream_array_size, const size_t tiling_facto
 
   printf(HLINE);
 
+  if (instrument) {
+    // host copies of the validated views, only needed for the host kernels
+    StreamHostArray a = Kokkos::create_mirror_view(dev_a);
+    StreamHostArray b = Kokkos::create_mirror_view(dev_b);
+    StreamHostArray c = Kokkos::create_mirror_view(dev_c);
+    Kokkos::deep_copy(a, dev_a);
+    Kokkos::deep_copy(b, dev_b);
+    Kokkos::deep_copy(c, dev_c);
+    perform_instrumented(a, b, c, scalar,
+                         heuristic ? heuristic_tiling(a) : get_tiling(a, tiling_factor));
+    printf(HLINE);
+  }
+
+  if (scan) {
+    perform_tiling_scan(dev_a, dev_b, dev_c, scalar, iterate, index_width);
+    printf(HLINE);
+  }
+
+  if (iterate_all) {
+    // runs after validation, the views are overwritten
+    perform_iterate_sweep(dev_a, dev_b, dev_c, scalar, tiling);
+    printf(HLINE);
+  }
+
   return rc;
 }
 
@@ -489,11 +808,31 @@ int main(int argc, char *argv[]) {
 
   Kokkos::initialize(argc, argv);
   int rc;
+  bool large_index_test;
+  CostModelParameters model;
+  std::string model_file;
   StreamIndex stream_array_size;
   size_t tiling_factor;
-  rc = parse_args(argc, argv, stream_array_size, tiling_factor);
-  if (rc == 0) {
-    rc = run_benchmark(stream_array_size, tiling_factor);
+  bool instrument;
+  int tile_count_threads;
+  bool heuristic;
+  bool scan;
+  IteratePattern iterate;
+  bool iterate_all;
+  IndexWidth index_width;
+  rc = parse_args(argc, argv, stream_array_size, tiling_factor, instrument, tile_count_threads,
+                  heuristic, scan, iterate, iterate_all, index_width,
+                  large_index_test, model,
+                  model_file);
+  if (rc == 0 && large_index_test) {
+    rc = large_index_test_mdrange<StreamDeviceArray>();
+  } else if (rc == 0 && tile_count_threads > 0) {
+    perform_tile_count_scan(stream_array_size, tile_count_threads, model, model_file);
+  } else if (rc == 0) {
+    report_thread_affinity();
+    printf(HLINE);
+    rc = run_benchmark(stream_array_size, tiling_factor, instrument, heuristic, scan, iterate,
+                       iterate_all, index_width);
   } else if (rc == -2) {
     // Don't return error code when called with "-h"
     rc = 0;
@@ -52,9 +52,23 @@
 #include <utility>
 #include <iostream>
 #include <limits>
+#include <vector>
 
 #include <sys/time.h>
 
+#include "stream-affinity.hpp"
+#include "stream-collapse.hpp"
+#include "stream-extra-kernels.hpp"
+#include "stream-flat-alias.hpp"
+#include "stream-index-type.hpp"
+#include "stream-intensity.hpp"
+#include "stream-iterate.hpp"
+#include "stream-large-index.hpp"
+#include "stream-memory.hpp"
+#include "stream-roofline.hpp"
+#include "stream-tiling.hpp"
+#include "stream-validation.hpp"
+
 #define STREAM_NTIMES 20
 using real_t = double;
 
@@ -73,8 +87,15 @@ using StreamHostArray = typename StreamDeviceArray::HostMirror;
 
 using StreamIndex = int;
 
-template <int rank>
-using Policy      = Kokkos::MDRangePolicy<Kokkos::Rank<rank>>;
+template <int rank, Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
+using Policy      = typename IndexedMDRangePolicy<Index, Kokkos::Rank<rank, outer, inner>>::type;
+
+// argument type of the kernels for the policy index type Index
+template <typename Index>
+using KernelIndex = KernelIndexType<Index, StreamIndex>;
+
+using StreamTiling = Kokkos::Array<std::size_t, StreamDeviceArray::rank()>;
 
 template <std::size_t... Idcs>
 constexpr Kokkos::Array<std::size_t, sizeof...(Idcs)>
@@ -93,14 +114,71 @@ constexpr real_t ainit = 1.0;
 constexpr real_t binit = 1.1;
 constexpr real_t cinit = 0.0;
 
-int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
+int parse_args(int argc, char **argv, StreamIndex &stream_array_size, bool &heuristic,
+               bool &collapse, bool &flat,
+               IteratePattern &iterate, bool &iterate_all,
+               IndexWidth &index_width, bool &index_all,
+               bool &extra_kernels, bool &intensity_sweep, std::vector<int> &fma_counts,
+               bool &large_index_test,
+               MachineDescription &machine) {
   // Defaults
+  machine = MachineDescription();
+  extra_kernels = false;
+  intensity_sweep = false;
+  fma_counts = default_fma_counts;
+  large_index_test = false;
   stream_array_size = 32;
+  heuristic = false;
+  collapse = false;
+  flat = false;
+  iterate = IteratePattern::Default;
+  iterate_all = false;
+  index_width = IndexWidth::Default;
+  index_all = false;
 
   const std::string help_string =
       "  -n <N>, --nelements <N>\n"
       "     Create stream views containing <N>^4 elements.\n"
       "     Default: 32\n"
+      "  -H, --heuristic\n"
+      "     Use the cache-topology-aware tiling heuristic instead of the\n"
+      "     default tiling of the MDRangePolicy.\n"
+      "  -C, --collapse\n"
+      "     Collapse fully covered contiguous trailing dimensions into fewer\n"
+      "     MDRange dimensions and compare against the uncollapsed kernels.\n"
+      "  -F, --flat\n"
+      "     Also run the kernels of stream-kokkos-range on a flat rank-1 alias\n"
+      "     of the same views and report the MDRange overhead.\n"
+      "  -I <P>, --iterate <P>\n"
+      "     MDRange iteration pattern <outer>,<inner> of the kernels, one of\n"
+      "     default, right,right, right,left, left,right and left,left.\n"
+      "     Default: default\n"
+      "  -A, --iterate-all\n"
+      "     After the benchmark, run all kernels with all four explicit\n"
+      "     iteration patterns and the same tiling.\n"
+      "  -x <T>, --index-type <T>\n"
+      "     Index type of the MDRangePolicy, int32, int64 or default (the\n"
+      "     default index type of the execution space).\n"
+      "     Default: default\n"
+      "  -X, --index-all\n"
+      "     After the benchmark, run all kernels with all three index types.\n"
+      "  -E, --extra-kernels\n"
+      "     After the benchmark, also run the Dot, Nstream and Sum+MaxNorm\n"
+      "     kernels (parallel_reduce) with the same policy and validate them.\n"
+      "  -R, --intensity-sweep\n"
+      "     After the benchmark, run the FMA chain kernel on the Triad inputs\n"
+      "     with increasing arithmetic intensity (0.08 ... 50 FLOP/byte) with\n"
+      "     the same policy and on a flat alias, report GB/s and GFLOP/s.\n"
+      "  -f <F>[,<F>...], --fmas <F>[,<F>...]\n"
+      "     FMAs per element of the intensity sweep, implies -R.\n"
+      "     Default: 1,2,4,8,16,32,64,128,256,512,600\n"
+      "  -L, --large-index-test\n"
+      "     Only check the index arithmetic for more than 2^32 elements (no\n"
+      "     memory is allocated), then exit.\n"
+      "  -M <file>, --machine <file>\n"
+      "     Read the peak bandwidth, FLOP rate and cache sizes from the machine\n"
+      "     description <file> (see machines/) and report each kernel as a\n"
+      "     fraction of its roofline ceiling and relative to the RangePolicy.\n"
       "  -h, --help\n"
       "     Prints this message.\n"
       "     Hint: use --kokkos-help to see command line options provided by "
@@ -108,15 +186,62 @@ int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
 
   static struct option long_options[] = {
       {"nelements", required_argument, NULL, 'n'},
+      {"heuristic", no_argument, NULL, 'H'},
+      {"collapse", no_argument, NULL, 'C'},
+      {"flat", no_argument, NULL, 'F'},
+      {"iterate", required_argument, NULL, 'I'},
+      {"iterate-all", no_argument, NULL, 'A'},
+      {"index-type", required_argument, NULL, 'x'},
+      {"index-all", no_argument, NULL, 'X'},
+      {"extra-kernels", no_argument, NULL, 'E'},
+      {"intensity-sweep", no_argument, NULL, 'R'},
+      {"fmas", required_argument, NULL, 'f'},
+      {"large-index-test", no_argument, NULL, 'L'},
+      {"machine", required_argument, NULL, 'M'},
       {"help", no_argument, NULL, 'h'},
       {NULL, 0, NULL, 0}};
 
   int c;
   int option_index = 0;
-  while ((c = getopt_long(argc, argv, "n:h", long_options, &option_index)) !=
+  while ((c = getopt_long(argc, argv, "n:HCFI:Ax:XERf:LM:h", long_options, &option_index)) !=
          -1)
     switch (c) {
-      case 'n': stream_array_size = atoi(optarg); break;
+      case 'n':
+        if (!parse_extent(optarg, stream_array_size)) {
+          fprintf(stderr, "Error: '%s' is not a valid number of elements.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'E': extra_kernels = true; break;
+      case 'R': intensity_sweep = true; break;
+      case 'f':
+        if (!parse_int_list(optarg, 1, 100000, fma_counts)) {
+          fprintf(stderr, "Error: '%s' is not a valid list of FMA counts.\n", optarg);
+          return -1;
+        }
+        intensity_sweep = true;
+        break;
+      case 'L': large_index_test = true; break;
+      case 'M':
+        if (!read_machine_description(optarg, machine)) return -1;
+        break;
+      case 'H': heuristic = true; break;
+      case 'F': flat = true; break;
+      case 'I':
+        if (!parse_iterate_pattern(optarg, iterate)) {
+          fprintf(stderr, "Error: unknown iteration pattern '%s'.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'A': iterate_all = true; break;
+      case 'x':
+        if (!parse_index_width(optarg, index_width)) {
+          fprintf(stderr, "Error: '%s' is not a valid index type.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'X': index_all = true; break;
+      case 'C': collapse = true; break;
       case 'h':
         printf("%s", help_string.c_str());
         return -2;
@@ -130,66 +255,183 @@ int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
   return 0;
 }
 
-void perform_set(const StreamDeviceArray a, const real_t scalar) {
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
+void perform_set(const StreamDeviceArray a, const real_t scalar,
+                 const StreamTiling &tiling,
+                 const bool collapse) {
   constexpr auto rank = a.rank();
+  const auto kernel =
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
+      { a(i,j,k,l) = scalar; };
+  if (collapse) {
+    collapsed_parallel_for<Policy<rank, outer, inner, Index>>("set", a, make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling, kernel);
+    return;
+  }
   Kokkos::parallel_for(
-      "set", 
-      Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0))),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
-      { a(i,j,k,l) = scalar; });
+      "set",
+      Policy<rank, outer, inner, Index>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling),
+      kernel);
 
   Kokkos::fence();
 }
 
-void perform_copy(const constStreamDeviceArray a, StreamDeviceArray b) {
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
+void perform_copy(const constStreamDeviceArray a, StreamDeviceArray b,
+                  const StreamTiling &tiling,
+                  const bool collapse) {
   constexpr auto rank = a.rank();
+  const auto kernel =
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
+      { b(i,j,k,l) = a(i,j,k,l); };
+  if (collapse) {
+    collapsed_parallel_for<Policy<rank, outer, inner, Index>>("copy", a, make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling, kernel);
+    return;
+  }
   Kokkos::parallel_for(
       "copy",
-      Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0))),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
-      { b(i,j,k,l) = a(i,j,k,l); });
+      Policy<rank, outer, inner, Index>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling),
+      kernel);
 
   Kokkos::fence();
 }
 
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
 void perform_scale(StreamDeviceArray b, const constStreamDeviceArray c,
-                   const real_t scalar) {
+                   const real_t scalar, const StreamTiling &tiling,
+                   const bool collapse) {
   constexpr auto rank = b.rank();
+  const auto kernel =
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
+      { b(i,j,k,l) = scalar * c(i,j,k,l); };
+  if (collapse) {
+    collapsed_parallel_for<Policy<rank, outer, inner, Index>>("scale", b, make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(b.extent(0)), tiling, kernel);
+    return;
+  }
   Kokkos::parallel_for(
       "scale",
-      Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(b.extent(0))),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
-      { b(i,j,k,l) = scalar * c(i,j,k,l); });
+      Policy<rank, outer, inner, Index>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(b.extent(0)), tiling),
+      kernel);
 
   Kokkos::fence();
 }
 
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
 void perform_add(const constStreamDeviceArray a,
-                 const constStreamDeviceArray b, StreamDeviceArray c) {
+                 const constStreamDeviceArray b, StreamDeviceArray c,
+                 const StreamTiling &tiling,
+                 const bool collapse) {
   constexpr auto rank = a.rank();
+  const auto kernel =
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
+      { c(i,j,k,l) = a(i,j,k,l) + b(i,j,k,l); };
+  if (collapse) {
+    collapsed_parallel_for<Policy<rank, outer, inner, Index>>("add", a, make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling, kernel);
+    return;
+  }
   Kokkos::parallel_for(
       "add",
-      Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0))),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
-      { c(i,j,k,l) = a(i,j,k,l) + b(i,j,k,l); });
+      Policy<rank, outer, inner, Index>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling),
+      kernel);
 
   Kokkos::fence();
 }
 
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
 void perform_triad(StreamDeviceArray a, const constStreamDeviceArray b,
-                   const constStreamDeviceArray c, const real_t scalar) {
+                   const constStreamDeviceArray c, const real_t scalar,
+                   const StreamTiling &tiling,
+                   const bool collapse) {
+  constexpr auto rank = a.rank();
+  const auto kernel =
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
+      { a(i,j,k,l) = b(i,j,k,l) + scalar * c(i,j,k,l); };
+  if (collapse) {
+    collapsed_parallel_for<Policy<rank, outer, inner, Index>>("triad", a, make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling, kernel);
+    return;
+  }
+  Kokkos::parallel_for(
+      "triad",
+      Policy<rank, outer, inner, Index>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling),
+      kernel);
+
+  Kokkos::fence();
+}
+
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
+real_t perform_dot(const constStreamDeviceArray a, const constStreamDeviceArray b,
+                   const StreamTiling &tiling) {
+  constexpr auto rank = a.rank();
+  real_t sum = 0.0;
+  Kokkos::parallel_reduce(
+      "dot",
+      Policy<rank, outer, inner, Index>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling),
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l, real_t &update)
+      { update += a(i,j,k,l) * b(i,j,k,l); },
+      sum);
+
+  Kokkos::fence();
+  return sum;
+}
+
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
+void perform_nstream(StreamDeviceArray a, const constStreamDeviceArray b,
+                     const constStreamDeviceArray c, const real_t scalar,
+                     const StreamTiling &tiling) {
   constexpr auto rank = a.rank();
   Kokkos::parallel_for(
-      "triad", 
-      Policy<rank>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0))),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
-      { a(i,j,k,l) = b(i,j,k,l) + scalar * c(i,j,k,l); });
+      "nstream",
+      Policy<rank, outer, inner, Index>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling),
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
+      { a(i,j,k,l) += b(i,j,k,l) + scalar * c(i,j,k,l); });
 
   Kokkos::fence();
 }
 
-int perform_validation(StreamHostArray &a, StreamHostArray &b,
-                       StreamHostArray &c, const StreamIndex arraySize,
+// sum and maximum norm of a in one pass
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
+void perform_sum_max_norm(const constStreamDeviceArray a, const StreamTiling &tiling,
+                          real_t &sum, real_t &max_norm) {
+  constexpr auto rank = a.rank();
+  Kokkos::parallel_reduce(
+      "sum_max_norm",
+      Policy<rank, outer, inner, Index>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling),
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l, real_t &update_sum, real_t &update_max) {
+        const real_t value = a(i,j,k,l);
+        const real_t norm  = value < 0 ? -value : value;
+        update_sum += value;
+        update_max = norm > update_max ? norm : update_max;
+      },
+      sum, Kokkos::Max<real_t>(max_norm));
+
+  Kokkos::fence();
+}
+
+// a = fma_chain(b, c, nfma), see stream-intensity.hpp
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default, typename Index = void>
+void perform_fma_chain(StreamDeviceArray a, const constStreamDeviceArray b,
+                       const constStreamDeviceArray c, const int nfma,
+                       const StreamTiling &tiling) {
+  constexpr auto rank = a.rank();
+  Kokkos::parallel_for(
+      "fma_chain",
+      Policy<rank, outer, inner, Index>(make_repeated_sequence<rank>(0), make_repeated_sequence<rank>(a.extent(0)), tiling),
+      KOKKOS_LAMBDA(const KernelIndex<Index> i, const KernelIndex<Index> j, const KernelIndex<Index> k, const KernelIndex<Index> l)
+      { a(i,j,k,l) = fma_chain(b(i,j,k,l), c(i,j,k,l), nfma); });
+
+  Kokkos::fence();
+}
+
+int perform_validation(const StreamDeviceArray &a, const StreamDeviceArray &b,
+                       const StreamDeviceArray &c, const StreamIndex arraySize,
                        const real_t scalar) {
   real_t ai = ainit;
   real_t bi = binit;
@@ -203,47 +445,19 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
   };
 
   std::cout << "ai: " << ai << "\n";
-  std::cout << "a(0,0,0,0): " << a(0,0,0,0) << "\n";
+  std::cout << "a(0,0,0,0): " << first_element(a) << "\n";
   std::cout << "bi: " << bi << "\n";
-  std::cout << "b(0,0,0,0): " << b(0,0,0,0) << "\n";
+  std::cout << "b(0,0,0,0): " << first_element(b) << "\n";
   std::cout << "ci: " << ci << "\n";
-  std::cout << "c(0,0,0,0): " << c(0,0,0,0) << "\n";
+  std::cout << "c(0,0,0,0): " << first_element(c) << "\n";
  
   const double nelem = (double)arraySize*arraySize*arraySize*arraySize; 
   const double epsilon = 2*4*STREAM_NTIMES*std::numeric_limits<real_t>::epsilon();
 
-  double aError = 0.0;
-  double bError = 0.0;
-  double cError = 0.0;
-
-  #pragma omp parallel reduction(+:aError,bError,cError)
-  {
-    double err = 0.0;
-    #pragma omp for collapse(2)
-    for (StreamIndex i = 0; i < arraySize; ++i) {
-      for (StreamIndex j = 0; j < arraySize; ++j) {
-        for (StreamIndex k = 0; k < arraySize; ++k) {
-          for (StreamIndex l = 0; l < arraySize; ++l) {
-            err = std::abs(a(i,j,k,l) - ai);
-            if( err > epsilon ){
-              //std::cout << "aError " << " i: " << i << " j: " << j << " k: " << k << " l: " << l << " err: " << err << "\n";
-              aError += err;
-            }
-            err = std::abs(b(i,j,k,l) - bi);
-            if( err > epsilon ){
-              //std::cout << "bError " << " i: " << i << " j: " << j << " k: " << k << " l: " << l << " err: " << err << "\n";
-              bError += err;
-            }
-            err = std::abs(c(i,j,k,l) - ci);
-            if( err > epsilon ){
-              //std::cout << "cError " << " i: " << i << " j: " << j << " k: " << k << " l: " << l << " err: " << err << "\n";
-              cError += err;
-            }
-          }
-        }
-      }
-    }
-  }
+  const ValidationErrors errors = validate_on_device(a, b, c, ai, bi, ci, epsilon);
+  const double aError = errors.sum[0];
+  const double bError = errors.sum[1];
+  const double cError = errors.sum[2];
 
   std::cout << "aError = " << aError << "\n";
   std::cout << "bError = " << bError << "\n";
@@ -256,6 +470,9 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
   std::cout << "aAvgErr = " << aAvgError << "\n";
   std::cout << "bAvgError = " << bAvgError << "\n";
   std::cout << "cAvgError = " << cAvgError << "\n";
+  std::cout << "aMaxErr = " << errors.max[0] << "\n";
+  std::cout << "bMaxErr = " << errors.max[1] << "\n";
+  std::cout << "cMaxErr = " << errors.max[2] << "\n";
 
   int errorCount       = 0;
 
@@ -281,8 +498,322 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
   return errorCount;
 }
 
-int run_benchmark(const StreamIndex stream_array_size) {
+// Times every kernel with the uncollapsed MDRangePolicy and with the
+// collapsed iteration space.
+void perform_collapse_comparison(StreamDeviceArray a, StreamDeviceArray b,
+                                 StreamDeviceArray c, const real_t scalar,
+                                 const StreamTiling &tiling, const IteratePattern iterate,
+                                 const IndexWidth index_width) {
+  const char *names[] = {"Set", "Copy", "Scale", "Add", "Triad"};
+  const double streams[] = {1.0, 2.0, 2.0, 3.0, 3.0};
+  double times[2][5];
+  Kokkos::Timer timer;
+  dispatch_index_type(index_width, [&](auto index) {
+    using Index = typename decltype(index)::type;
+    dispatch_iterate(iterate, [&](auto outer, auto inner) {
+      constexpr Kokkos::Iterate outer_it = decltype(outer)::value;
+      constexpr Kokkos::Iterate inner_it = decltype(inner)::value;
+      for (int collapse = 0; collapse < 2; ++collapse) {
+        for (int n = 0; n < 5; ++n) times[collapse][n] = std::numeric_limits<double>::max();
+        for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+          timer.reset();
+          perform_set<outer_it, inner_it, Index>(c, 1.5, tiling, collapse);
+          times[collapse][0] = std::min(times[collapse][0], timer.seconds());
+          timer.reset();
+          perform_copy<outer_it, inner_it, Index>(a, c, tiling, collapse);
+          times[collapse][1] = std::min(times[collapse][1], timer.seconds());
+          timer.reset();
+          perform_scale<outer_it, inner_it, Index>(b, c, scalar, tiling, collapse);
+          times[collapse][2] = std::min(times[collapse][2], timer.seconds());
+          timer.reset();
+          perform_add<outer_it, inner_it, Index>(a, b, c, tiling, collapse);
+          times[collapse][3] = std::min(times[collapse][3], timer.seconds());
+          timer.reset();
+          perform_triad<outer_it, inner_it, Index>(a, b, c, scalar, tiling, collapse);
+          times[collapse][4] = std::min(times[collapse][4], timer.seconds());
+        }
+      }
+    });
+  });
+  printf("Comparison with the uncollapsed %dD MDRangePolicy (iterate %s, index %s):\n",
+         (int)a.rank(), iterate_pattern_name(iterate), index_width_name(index_width));
+  printf("%-8s %14s %14s %10s\n", "kernel", "uncollapsed", "collapsed", "speedup");
+  printf("%-8s %14s %14s %10s\n", "", "[Gbyte/s]", "[Gbyte/s]", "");
+  for (int n = 0; n < 5; ++n) {
+    const double bytes = 1.0e-9 * streams[n] * (double)sizeof(real_t) * (double)a.size();
+    printf("%-8s %14.4f %14.4f %10.3f\n", names[n], bytes / times[0][n], bytes / times[1][n],
+           times[0][n] / times[1][n]);
+  }
+}
+
+// Times every kernel with the 4D MDRangePolicy and with the RangePolicy
+// kernels on a flat alias of the same views.
+void perform_flat_comparison(StreamDeviceArray a, StreamDeviceArray b,
+                             StreamDeviceArray c, const real_t scalar,
+                             const StreamTiling &tiling, const IteratePattern iterate,
+                             const IndexWidth index_width) {
+  report_flat_alias_safety(a);
+  if (!flat_alias_is_safe(a) || !flat_alias_is_safe(b) || !flat_alias_is_safe(c)) {
+    printf("The stream views cannot be aliased, skipping the comparison.\n");
+    return;
+  }
+  const auto flat_a = make_flat_alias(a);
+  const auto flat_b = make_flat_alias(b);
+  const auto flat_c = make_flat_alias(c);
+
+  const char *names[] = {"Set", "Copy", "Scale", "Add", "Triad"};
+  const double streams[] = {1.0, 2.0, 2.0, 3.0, 3.0};
+  double times[2][5];
+  Kokkos::Timer timer;
+  for (int v = 0; v < 2; ++v) {
+    for (int n = 0; n < 5; ++n) times[v][n] = std::numeric_limits<double>::max();
+  }
+  dispatch_index_type(index_width, [&](auto index) {
+    using Index = typename decltype(index)::type;
+    dispatch_iterate(iterate, [&](auto outer, auto inner) {
+      constexpr Kokkos::Iterate outer_it = decltype(outer)::value;
+      constexpr Kokkos::Iterate inner_it = decltype(inner)::value;
+      for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+        timer.reset();
+        perform_set<outer_it, inner_it, Index>(c, 1.5, tiling, false);
+        times[0][0] = std::min(times[0][0], timer.seconds());
+        timer.reset();
+        perform_copy<outer_it, inner_it, Index>(a, c, tiling, false);
+        times[0][1] = std::min(times[0][1], timer.seconds());
+        timer.reset();
+        perform_scale<outer_it, inner_it, Index>(b, c, scalar, tiling, false);
+        times[0][2] = std::min(times[0][2], timer.seconds());
+        timer.reset();
+        perform_add<outer_it, inner_it, Index>(a, b, c, tiling, false);
+        times[0][3] = std::min(times[0][3], timer.seconds());
+        timer.reset();
+        perform_triad<outer_it, inner_it, Index>(a, b, c, scalar, tiling, false);
+        times[0][4] = std::min(times[0][4], timer.seconds());
+      }
+    });
+  });
+  time_flat_kernels(flat_a, flat_b, flat_c, scalar, STREAM_NTIMES, times[1]);
+  printf("Comparison with the RangePolicy on a flat alias (iterate %s, index %s):\n",
+         iterate_pattern_name(iterate), index_width_name(index_width));
+  printf("%-8s %14s %14s %10s\n", "kernel", "4d-mdrange", "flat range", "overhead");
+  printf("%-8s %14s %14s %10s\n", "", "[Gbyte/s]", "[Gbyte/s]", "[%]");
+  for (int n = 0; n < 5; ++n) {
+    const double bytes = 1.0e-9 * streams[n] * (double)sizeof(real_t) * (double)a.size();
+    printf("%-8s %14.4f %14.4f %10.1f\n", names[n], bytes / times[0][n], bytes / times[1][n],
+           100.0 * (times[0][n] / times[1][n] - 1.0));
+  }
+}
+
+// Times every kernel with all four combinations of the outer and inner
+// iteration direction, using the same tiling.
+void perform_iterate_sweep(StreamDeviceArray a, StreamDeviceArray b,
+                           StreamDeviceArray c, const real_t scalar,
+                           const StreamTiling &tiling) {
+  const double streams[] = {1.0, 2.0, 2.0, 3.0, 3.0};
+  printf("Iteration patterns with tiling %s:\n", tiling_to_string(tiling).c_str());
+  printf("%-12s %10s %10s %10s %10s %10s\n", "outer,inner", "Set", "Copy", "Scale", "Add",
+         "Triad");
+  printf("%-12s %10s %10s %10s %10s %10s\n", "", "[Gbyte/s]", "[Gbyte/s]", "[Gbyte/s]",
+         "[Gbyte/s]", "[Gbyte/s]");
+  for (const auto pattern : iterate_patterns) {
+    double times[5];
+    for (int n = 0; n < 5; ++n) times[n] = std::numeric_limits<double>::max();
+    dispatch_iterate(pattern, [&](auto outer, auto inner) {
+      constexpr Kokkos::Iterate outer_it = decltype(outer)::value;
+      constexpr Kokkos::Iterate inner_it = decltype(inner)::value;
+      Kokkos::Timer timer;
+      for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+        timer.reset();
+        perform_set<outer_it, inner_it>(c, 1.5, tiling, false);
+        times[0] = std::min(times[0], timer.seconds());
+        timer.reset();
+        perform_copy<outer_it, inner_it>(a, c, tiling, false);
+        times[1] = std::min(times[1], timer.seconds());
+        timer.reset();
+        perform_scale<outer_it, inner_it>(b, c, scalar, tiling, false);
+        times[2] = std::min(times[2], timer.seconds());
+        timer.reset();
+        perform_add<outer_it, inner_it>(a, b, c, tiling, false);
+        times[3] = std::min(times[3], timer.seconds());
+        timer.reset();
+        perform_triad<outer_it, inner_it>(a, b, c, scalar, tiling, false);
+        times[4] = std::min(times[4], timer.seconds());
+      }
+    });
+    const double bytes = 1.0e-9 * (double)sizeof(real_t) * (double)a.size();
+    printf("%-12s", iterate_pattern_name(pattern));
+    for (int n = 0; n < 5; ++n) printf(" %10.4f", streams[n] * bytes / times[n]);
+    printf("\n");
+  }
+}
+
+// Times every kernel with the default index type of the execution space
+// and with 32 and 64 bit indices, using the same tiling.
+void perform_index_comparison(StreamDeviceArray a, StreamDeviceArray b,
+                              StreamDeviceArray c, const real_t scalar,
+                              const StreamTiling &tiling) {
+  const double streams[] = {1.0, 2.0, 2.0, 3.0, 3.0};
+  printf("Index types with tiling %s:\n", tiling_to_string(tiling).c_str());
+  printf("%-8s %5s %10s %10s %10s %10s %10s\n", "index", "bytes", "Set", "Copy", "Scale",
+         "Add", "Triad");
+  printf("%-8s %5s %10s %10s %10s %10s %10s\n", "", "", "[Gbyte/s]", "[Gbyte/s]",
+         "[Gbyte/s]", "[Gbyte/s]", "[Gbyte/s]");
+  for (const auto width : index_widths) {
+    double times[5];
+    std::size_t index_bytes = 0;
+    for (int n = 0; n < 5; ++n) times[n] = std::numeric_limits<double>::max();
+    dispatch_index_type(width, [&](auto index) {
+      using Index = typename decltype(index)::type;
+      index_bytes = sizeof(typename Policy<4, Kokkos::Iterate::Default,
+                                           Kokkos::Iterate::Default, Index>::index_type);
+      Kokkos::Timer timer;
+      for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+        timer.reset();
+        perform_set<Kokkos::Iterate::Default, Kokkos::Iterate::Default, Index>(c, 1.5, tiling, false);
+        times[0] = std::min(times[0], timer.seconds());
+        timer.reset();
+        perform_copy<Kokkos::Iterate::Default, Kokkos::Iterate::Default, Index>(a, c, tiling, false);
+        times[1] = std::min(times[1], timer.seconds());
+        timer.reset();
+        perform_scale<Kokkos::Iterate::Default, Kokkos::Iterate::Default, Index>(b, c, scalar, tiling, false);
+        times[2] = std::min(times[2], timer.seconds());
+        timer.reset();
+        perform_add<Kokkos::Iterate::Default, Kokkos::Iterate::Default, Index>(a, b, c, tiling, false);
+        times[3] = std::min(times[3], timer.seconds());
+        timer.reset();
+        perform_triad<Kokkos::Iterate::Default, Kokkos::Iterate::Default, Index>(a, b, c, scalar, tiling, false);
+        times[4] = std::min(times[4], timer.seconds());
+      }
+    });
+    const double bytes = 1.0e-9 * (double)sizeof(real_t) * (double)a.size();
+    printf("%-8s %5zu", index_width_name(width), index_bytes);
+    for (int n = 0; n < 5; ++n) printf(" %10.4f", streams[n] * bytes / times[n]);
+    printf("\n");
+  }
+}
+
+// Times Dot, Nstream and Sum+MaxNorm (stream-extra-kernels.hpp) on freshly
+// initialised views and checks the results of the last iteration.
+int perform_extra_kernels(StreamDeviceArray a, StreamDeviceArray b, StreamDeviceArray c,
+                          const real_t scalar, const StreamTiling &tiling,
+                          const IteratePattern iterate, const IndexWidth index_width) {
+  perform_set(a, ainit, tiling, false);
+  perform_set(b, binit, tiling, false);
+  perform_set(c, extra_cinit, tiling, false);
+
+  double times[num_extra_kernels];
+  for (int n = 0; n < num_extra_kernels; ++n) times[n] = std::numeric_limits<double>::max();
+  ExtraKernelResults results;
+  Kokkos::Timer timer;
+  dispatch_index_type(index_width, [&](auto index) {
+    using Index = typename decltype(index)::type;
+    dispatch_iterate(iterate, [&](auto outer, auto inner) {
+      constexpr Kokkos::Iterate outer_it = decltype(outer)::value;
+      constexpr Kokkos::Iterate inner_it = decltype(inner)::value;
+      for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+        timer.reset();
+        results.dot = perform_dot<outer_it, inner_it, Index>(a, b, tiling);
+        times[0] = std::min(times[0], timer.seconds());
+
+        timer.reset();
+        perform_nstream<outer_it, inner_it, Index>(a, b, c, scalar, tiling);
+        times[1] = std::min(times[1], timer.seconds());
+
+        timer.reset();
+        perform_sum_max_norm<outer_it, inner_it, Index>(a, tiling, results.sum,
+                                                        results.max_norm);
+        times[2] = std::min(times[2], timer.seconds());
+      }
+    });
+  });
+
+  const int rc = check_extra_kernels(results, (double)a.size(), STREAM_NTIMES, ainit, binit,
+                                     extra_cinit, scalar);
+  print_extra_kernel_bandwidth(times, (double)sizeof(real_t) * (double)a.size());
+  return rc;
+}
+
+// Times the FMA chain kernel for each FMA count with the MDRangePolicy of
+// the benchmark and with the RangePolicy on a flat alias of the same views,
+// and checks a after each kernel. The flat GFLOP/s show from which
+// intensity on the MDRange overhead no longer matters.
+int perform_intensity_sweep(StreamDeviceArray a, StreamDeviceArray b, StreamDeviceArray c,
+                            const StreamTiling &tiling, const IteratePattern iterate,
+                            const IndexWidth index_width, const std::vector<int> &fma_counts) {
+  perform_set(b, binit, tiling, false);
+  perform_set(c, ainit, tiling, false);
+
+  const bool flat = flat_alias_is_safe(a) && flat_alias_is_safe(b) && flat_alias_is_safe(c);
+  const auto flat_a = make_flat_alias(a);
+  const auto flat_b = make_flat_alias(b);
+  const auto flat_c = make_flat_alias(c);
+
+  const double nelem   = (double)a.size();
+  const double epsilon = 1.0e-12;
+  int rc               = 0;
+
+  printf("FMA chain sweep, a = fma_chain(b, c), %.0f bytes per element:\n",
+         fma_chain_bytes<real_t>());
+  printf("%6s %10s %12s %12s %12s %10s\n", "FMAs", "intensity", "4d-mdrange", "4d-mdrange",
+         "flat range", "overhead");
+  printf("%6s %10s %12s %12s %12s %10s\n", "", "[FLOP/B]", "[Gbyte/s]", "[GFLOP/s]",
+         "[GFLOP/s]", "[%]");
+  for (const int nfma : fma_counts) {
+    const real_t expected = fma_chain(binit, ainit, nfma);
+    double times[2]       = {std::numeric_limits<double>::max(),
+                             std::numeric_limits<double>::max()};
+    Kokkos::Timer timer;
+    dispatch_index_type(index_width, [&](auto index) {
+      using Index = typename decltype(index)::type;
+      dispatch_iterate(iterate, [&](auto outer, auto inner) {
+        constexpr Kokkos::Iterate outer_it = decltype(outer)::value;
+        constexpr Kokkos::Iterate inner_it = decltype(inner)::value;
+        for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+          timer.reset();
+          perform_fma_chain<outer_it, inner_it, Index>(a, b, c, nfma, tiling);
+          times[0] = std::min(times[0], timer.seconds());
+        }
+      });
+    });
+    int errors = validate_on_device(a, b, c, expected, binit, ainit, 0.0).max[0] >
+                 epsilon * std::abs(expected);
+
+    if (flat) {
+      for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+        timer.reset();
+        perform_flat_fma_chain(flat_a, flat_b, flat_c, nfma);
+        times[1] = std::min(times[1], timer.seconds());
+      }
+      errors += validate_on_device(a, b, c, expected, binit, ainit, 0.0).max[0] >
+                epsilon * std::abs(expected);
+    }
+
+    const double flops = 1.0e-9 * fma_chain_flops(nfma) * nelem;
+    printf("%6d %10.3f %12.4f %12.4f", nfma, fma_chain_flops(nfma) / fma_chain_bytes<real_t>(),
+           1.0e-9 * fma_chain_bytes<real_t>() * nelem / times[0], flops / times[0]);
+    if (flat) {
+      printf(" %12.4f %10.1f", flops / times[1], 100.0 * (times[0] / times[1] - 1.0));
+    } else {
+      printf(" %12s %10s", "n/a", "n/a");
+    }
+    printf("%s\n", errors == 0 ? "" : "  FAILED");
+    if (errors != 0) {
+      fprintf(stderr, "Error: validation check on the FMA chain with %d FMAs failed.\n", nfma);
+      rc++;
+    }
+  }
+  return rc;
+}
+
+int run_benchmark(const StreamIndex stream_array_size, const bool heuristic,
+                  const bool collapse, const bool flat,
+                  const IteratePattern iterate, const bool iterate_all,
+                  const IndexWidth index_width, const bool index_all,
+                  const bool extra_kernels, const bool intensity_sweep,
+                  const std::vector<int> &fma_counts,
+                  const MachineDescription &machine) {
   printf("Reports fastest timing per kernel\n");
+  report_memory_usage("initialize");
   printf("Creating Views...\n");
 
   const double nelem = (double)stream_array_size*
@@ -297,6 +828,9 @@ int run_benchmark(const StreamIndex stream_array_size) {
          1.0e-6 * nelem * (double)sizeof(real_t));
   printf("- Total: %12.2f MB\n",
          3.0e-6 * nelem * (double)sizeof(real_t));
+  printf("- Host Memory:   %12.2f MB (no host mirrors)\n",
+         views_in_host_memory<StreamDeviceArray>() ? 3.0e-6 * nelem * (double)sizeof(real_t)
+                                                   : 0.0);
 
   printf("Benchmark kernels will be performed for %d iterations.\n",
          STREAM_NTIMES);
@@ -311,10 +845,6 @@ int run_benchmark(const StreamIndex stream_array_size) {
   StreamDeviceArray dev_c(Kokkos::view_alloc(Kokkos::WithoutInitializing, "c"),
                           stream_array_size,stream_array_size,stream_array_size,stream_array_size);
 
-  StreamHostArray a = Kokkos::create_mirror_view(dev_a);
-  StreamHostArray b = Kokkos::create_mirror_view(dev_b);
-  StreamHostArray c = Kokkos::create_mirror_view(dev_c);
-
   const double scalar = 1.1;
 
   double setTime   = std::numeric_limits<double>::max();
@@ -323,24 +853,25 @@ int run_benchmark(const StreamIndex stream_array_size) {
   double addTime   = std::numeric_limits<double>::max();
   double triadTime = std::numeric_limits<double>::max();
 
+  report_memory_usage("allocation");
   printf("Initializing Views...\n");
 
-  Kokkos::parallel_for(
-      "init",
-      Kokkos::MDRangePolicy<Kokkos::Rank<a.rank()>,
-                            Kokkos::DefaultHostExecutionSpace>(make_repeated_sequence<a.rank()>(0),
-                                                               make_repeated_sequence<a.rank()>(stream_array_size)),
-      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
-        a(i,j,k,l) = ainit;
-        b(i,j,k,l) = binit;
-        c(i,j,k,l) = cinit;
-      });
-  Kokkos::fence();
+  // zero tile sizes select the default tiling of the MDRangePolicy
+  StreamTiling tiling = make_repeated_sequence<dev_a.rank()>(0);
+  if (heuristic) {
+    tiling = heuristic_tiling(dev_a, 3, true);
+    std::cout << "Used tiling: " << tiling_to_string(tiling) << "\n";
+  }
+  if (collapse) {
+    print_collapse_plan(dev_a, make_repeated_sequence<dev_a.rank()>(0),
+                        make_repeated_sequence<dev_a.rank()>(stream_array_size));
+  }
 
   Kokkos::parallel_for(
       "init_dev",
-      Kokkos::MDRangePolicy<Kokkos::Rank<a.rank()>>(make_repeated_sequence<a.rank()>(0),
-                                                    make_repeated_sequence<a.rank()>(stream_array_size)),
+      Kokkos::MDRangePolicy<Kokkos::Rank<dev_a.rank()>>(make_repeated_sequence<dev_a.rank()>(0),
+                                                    make_repeated_sequence<dev_a.rank()>(stream_array_size),
+                                                    tiling),
       KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
         dev_a(i,j,k,l) = ainit;
         dev_b(i,j,k,l) = binit;
@@ -348,63 +879,118 @@ int run_benchmark(const StreamIndex stream_array_size) {
       });
   Kokkos::fence();
 
+  printf("Iteration pattern: %s\n", iterate_pattern_name(iterate));
+  printf("Index type:        %s\n", index_width_name(index_width));
+  warn_int32_index(index_width, dev_a.size());
+  report_memory_usage("first touch");
   printf("Starting benchmarking...\n");
 
   Kokkos::Timer timer;
 
-  for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
-    timer.reset();
-    perform_set(dev_c, 1.5);
-    setTime = std::min(setTime, timer.seconds());
-
-    timer.reset();
-    perform_copy(dev_a, dev_c);
-    copyTime = std::min(copyTime, timer.seconds());
-
-    timer.reset();
-    perform_scale(dev_b, dev_c, scalar);
-    scaleTime = std::min(scaleTime, timer.seconds());
-
-    timer.reset();
-    perform_add(dev_a, dev_b, dev_c);
-    addTime = std::min(addTime, timer.seconds());
-
-    timer.reset();
-    perform_triad(dev_a, dev_b, dev_c, scalar);
-    triadTime = std::min(triadTime, timer.seconds());
-  }
-
-  Kokkos::deep_copy(a, dev_a);
-  Kokkos::deep_copy(b, dev_b);
-  Kokkos::deep_copy(c, dev_c);
+  dispatch_index_type(index_width, [&](auto index) {
+    using Index = typename decltype(index)::type;
+    dispatch_iterate(iterate, [&](auto outer, auto inner) {
+      constexpr Kokkos::Iterate outer_it = decltype(outer)::value;
+      constexpr Kokkos::Iterate inner_it = decltype(inner)::value;
+      for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+        timer.reset();
+        perform_set<outer_it, inner_it, Index>(dev_c, 1.5, tiling, collapse);
+        setTime = std::min(setTime, timer.seconds());
+
+        timer.reset();
+        perform_copy<outer_it, inner_it, Index>(dev_a, dev_c, tiling, collapse);
+        copyTime = std::min(copyTime, timer.seconds());
+
+        timer.reset();
+        perform_scale<outer_it, inner_it, Index>(dev_b, dev_c, scalar, tiling, collapse);
+        scaleTime = std::min(scaleTime, timer.seconds());
+
+        timer.reset();
+        perform_add<outer_it, inner_it, Index>(dev_a, dev_b, dev_c, tiling, collapse);
+        addTime = std::min(addTime, timer.seconds());
+
+        timer.reset();
+        perform_triad<outer_it, inner_it, Index>(dev_a, dev_b, dev_c, scalar, tiling, collapse);
+        triadTime = std::min(triadTime, timer.seconds());
+      }
+    });
+  });
 
+  report_memory_usage("kernels");
   printf("Performing validation...\n");
-  int rc = perform_validation(a, b, c, stream_array_size, scalar);
+  timer.reset();
+  int rc = perform_validation(dev_a, dev_b, dev_c, stream_array_size, scalar);
+  printf("Validation time: %.4f s\n", timer.seconds());
+  report_memory_usage("validation");
 
   printf(HLINE);
 
   printf("Set             %11.4f GB/s\n",
-         (1.0e-09 * 1.0 * (double)sizeof(real_t) * (double)a.size()) /
+         (1.0e-09 * 1.0 * (double)sizeof(real_t) * (double)dev_a.size()) /
              setTime);
   printf("Copy            %11.4f GB/s\n",
          real_t(1.0e-09 * 2.0 * (double)sizeof(real_t) *
-                (double)a.size()) /
+                (double)dev_a.size()) /
                 copyTime);
   printf("Scale           %11.4f GB/s\n",
          real_t(1.0e-09 * 2.0 * (double)sizeof(real_t) *
-                (double)a.size()) /
+                (double)dev_a.size()) /
                 scaleTime);
   printf("Add             %11.4f GB/s\n",
          real_t(1.0e-09 * 3.0 * (double)sizeof(real_t) *
-                (double)a.size()) /
+                (double)dev_a.size()) /
                 addTime);
   printf("Triad           %11.4f GB/s\n",
          real_t(1.0e-09 * 3.0 * (double)sizeof(real_t) *
-                (double)a.size()) /
+                (double)dev_a.size()) /
                 triadTime);
 
   printf(HLINE);
 
+  if (machine.valid()) {
+    // runs after validation, the views are overwritten
+    const double times[5] = {setTime, copyTime, scaleTime, addTime, triadTime};
+    perform_stream_roofline(machine, dev_a, dev_b, dev_c, scalar, STREAM_NTIMES, times);
+    printf(HLINE);
+  }
+
+  if (extra_kernels) {
+    // runs after validation, the views are overwritten
+    rc += perform_extra_kernels(dev_a, dev_b, dev_c, scalar, tiling, iterate, index_width);
+    printf(HLINE);
+  }
+
+  if (intensity_sweep) {
+    // runs after validation, the views are overwritten
+    rc += perform_intensity_sweep(dev_a, dev_b, dev_c, tiling, iterate, index_width,
+                                  fma_counts);
+    printf(HLINE);
+  }
+
+  if (collapse) {
+    // runs after validation, the views are overwritten
+    perform_collapse_comparison(dev_a, dev_b, dev_c, scalar, tiling, iterate, index_width);
+    printf(HLINE);
+  }
+
+  if (flat) {
+    // runs after validation, the views are overwritten
+    perform_flat_comparison(dev_a, dev_b, dev_c, scalar, tiling, iterate, index_width);
+    printf(HLINE);
+  }
+
+  if (iterate_all) {
+    // runs after validation, the views are overwritten
+    perform_iterate_sweep(dev_a, dev_b, dev_c, scalar, tiling);
+    printf(HLINE);
+  }
+
+  if (index_all) {
+    // runs after validation, the views are overwritten
+    perform_index_comparison(dev_a, dev_b, dev_c, scalar, tiling);
+    printf(HLINE);
+  }
+
   return rc;
 }
 
@@ -415,10 +1001,32 @@ int main(int argc, char *argv[]) {
 
   Kokkos::initialize(argc, argv);
   int rc;
+  bool extra_kernels;
+  bool intensity_sweep;
+  std::vector<int> fma_counts;
+  bool large_index_test;
+  MachineDescription machine;
   StreamIndex stream_array_size;
-  rc = parse_args(argc, argv, stream_array_size);
-  if (rc == 0) {
-    rc = run_benchmark(stream_array_size);
+  bool heuristic;
+  bool collapse;
+  bool flat;
+  IteratePattern iterate;
+  bool iterate_all;
+  IndexWidth index_width;
+  bool index_all;
+  rc = parse_args(argc, argv, stream_array_size, heuristic, collapse, flat, iterate,
+                  iterate_all,
+                  index_width, index_all,
+                  extra_kernels, intensity_sweep, fma_counts, large_index_test, machine);
+  if (rc == 0 && large_index_test) {
+    rc = large_index_test_mdrange<StreamDeviceArray>();
+  } else if (rc == 0) {
+    report_thread_affinity();
+    printf(HLINE);
+    rc = run_benchmark(stream_array_size, heuristic, collapse, flat, iterate,
+                       iterate_all,
+                       index_width, index_all,
+                       extra_kernels, intensity_sweep, fma_counts, machine);
   } else if (rc == -2) {
     // Don't return error code when called with "-h"
     rc = 0;
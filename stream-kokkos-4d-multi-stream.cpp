@@ -0,0 +1,462 @@
+/*
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 3.0
+//       Copyright (2020) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// 1. Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the Corporation nor the names of the
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY NTESS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NTESS OR THE
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ************************************************************************
+//
+// Modifications by Simon Schlepphorst (Uni Bonn) and
+//                  Bartosz Kostrzewa (Uni Bonn) 
+//
+//@HEADER
+*/
+
+
+// Generalised STREAM kernel on 4D views with K input and M output views,
+//
+//   out_m(i,j,k,l) = (m + 1) * sum_q in_q(i,j,k,l),
+//
+// with K = 1 ... 16 and M = 1 ... 4 as template parameters, run with an
+// MDRangePolicy. Lattice kernels touch many fields at once (e.g. eight
+// neighbour spinors and the gauge links), the three arrays of STREAM
+// underestimate the pressure on the TLB and the hardware prefetchers. The
+// table shows for each tiling at which number of streams the bandwidth
+// drops.
+
+#include <Kokkos_Core.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <getopt.h>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+#include <sys/time.h>
+
+#include "stream-affinity.hpp"
+#include "stream-iterate.hpp"
+#include "stream-large-index.hpp"
+#include "stream-memory.hpp"
+#include "stream-tiling.hpp"
+
+#define STREAM_NTIMES 20
+using real_t = double;
+
+#define HLINE "-------------------------------------------------------------\n"
+
+using StreamDeviceArray =
+    Kokkos::View<real_t ****, Kokkos::MemoryTraits<Kokkos::Restrict>>;
+#if defined(KOKKOS_ENABLE_CUDA)
+using constStreamDeviceArray =
+    Kokkos::View<const real_t ****, Kokkos::MemoryTraits<Kokkos::RandomAccess>>;
+#else
+using constStreamDeviceArray =
+    Kokkos::View<const real_t ****, Kokkos::MemoryTraits<Kokkos::Restrict>>;
+#endif
+
+using StreamIndex = int;
+
+template <Kokkos::Iterate outer = Kokkos::Iterate::Default,
+          Kokkos::Iterate inner = Kokkos::Iterate::Default>
+using Policy = Kokkos::MDRangePolicy<Kokkos::Rank<4, outer, inner>>;
+
+using StreamTiling = Kokkos::Array<std::size_t, StreamDeviceArray::rank()>;
+
+template <std::size_t... Idcs>
+constexpr Kokkos::Array<std::size_t, sizeof...(Idcs)>
+make_repeated_sequence_impl(std::size_t value, std::integer_sequence<std::size_t, Idcs...>)
+{
+  return { ((void)Idcs, value)... };
+}
+
+template <std::size_t N>
+constexpr Kokkos::Array<std::size_t,N> make_repeated_sequence(std::size_t value)
+{
+  return make_repeated_sequence_impl(value, std::make_index_sequence<N>{});
+}
+
+// range of the template parameters
+constexpr int max_inputs  = 16;
+constexpr int max_outputs = 4;
+
+// in_q is initialised to input_init(q), all values and sums are exact
+KOKKOS_INLINE_FUNCTION constexpr real_t input_init(const int q) { return 1.0 + 0.25 * q; }
+
+int parse_args(int argc, char **argv, StreamIndex &stream_array_size,
+               std::vector<int> &inputs, std::vector<int> &outputs,
+               std::vector<StreamTiling> &tilings, bool &heuristic,
+               IteratePattern &iterate) {
+  // Defaults
+  stream_array_size = 32;
+  inputs.clear();
+  for (int k = 1; k <= max_inputs; ++k) inputs.push_back(k);
+  outputs.clear();
+  for (int m = 1; m <= max_outputs; ++m) outputs.push_back(m);
+  tilings.clear();
+  heuristic = false;
+  iterate = IteratePattern::Default;
+
+  const std::string help_string =
+      "  -n <N>, --nelements <N>\n"
+      "     Create stream views containing <N>^4 elements.\n"
+      "     Default: 32\n"
+      "  -k <K>[,<K>...], --inputs <K>[,<K>...]\n"
+      "     Numbers of input views, each in 1...16.\n"
+      "     Default: 1,2,...,16\n"
+      "  -m <M>[,<M>...], --outputs <M>[,<M>...]\n"
+      "     Numbers of output views, each in 1...4.\n"
+      "     Default: 1,2,3,4\n"
+      "  -t <T0>,<T1>,<T2>,<T3>, --tiling <T0>,<T1>,<T2>,<T3>\n"
+      "     Add a tiling of the MDRangePolicy (0 lets Kokkos choose the tile\n"
+      "     extent), can be given several times.\n"
+      "     Default: the default tiling of the MDRangePolicy\n"
+      "  -H, --heuristic\n"
+      "     Add the cache-topology-aware tiling heuristic for the K+M streams\n"
+      "     of each kernel.\n"
+      "  -I <P>, --iterate <P>\n"
+      "     MDRange iteration pattern <outer>,<inner> of the kernels, one of\n"
+      "     default, right,right, right,left, left,right and left,left.\n"
+      "     Default: default\n"
+      "  -h, --help\n"
+      "     Prints this message.\n"
+      "     Hint: use --kokkos-help to see command line options provided by "
+      "Kokkos.\n";
+
+  static struct option long_options[] = {
+      {"nelements", required_argument, NULL, 'n'},
+      {"inputs", required_argument, NULL, 'k'},
+      {"outputs", required_argument, NULL, 'm'},
+      {"tiling", required_argument, NULL, 't'},
+      {"heuristic", no_argument, NULL, 'H'},
+      {"iterate", required_argument, NULL, 'I'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0}};
+
+  int c;
+  int option_index = 0;
+  StreamTiling tiling;
+  while ((c = getopt_long(argc, argv, "n:k:m:t:HI:h", long_options, &option_index)) !=
+         -1)
+    switch (c) {
+      case 'n':
+        if (!parse_extent(optarg, stream_array_size)) {
+          fprintf(stderr, "Error: '%s' is not a valid number of elements.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'k':
+        if (!parse_int_list(optarg, 1, max_inputs, inputs)) {
+          fprintf(stderr, "Error: '%s' is not a valid list of input counts.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'm':
+        if (!parse_int_list(optarg, 1, max_outputs, outputs)) {
+          fprintf(stderr, "Error: '%s' is not a valid list of output counts.\n", optarg);
+          return -1;
+        }
+        break;
+      case 't':
+        if (!parse_tiling<4>(optarg, tiling)) {
+          fprintf(stderr, "Error: '%s' is not a valid tiling.\n", optarg);
+          return -1;
+        }
+        tilings.push_back(tiling);
+        break;
+      case 'H': heuristic = true; break;
+      case 'I':
+        if (!parse_iterate_pattern(optarg, iterate)) {
+          fprintf(stderr, "Error: unknown iteration pattern '%s'.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'h':
+        printf("%s", help_string.c_str());
+        return -2;
+        break;
+      case 0: break;
+      default:
+        printf("%s", help_string.c_str());
+        return -1;
+        break;
+    }
+  if (tilings.empty()) tilings.push_back(StreamTiling{0, 0, 0, 0});
+  return 0;
+}
+
+// Calls f(std::integral_constant<int, n>{}) for first <= n <= last.
+template <int first, int last, typename F>
+void dispatch_count(const int n, F &&f) {
+  if constexpr (first <= last) {
+    if (n == first) {
+      f(std::integral_constant<int, first>{});
+    } else {
+      dispatch_count<first + 1, last>(n, f);
+    }
+  }
+}
+
+template <int K, int M>
+struct MultiStreamFunctor {
+  Kokkos::Array<constStreamDeviceArray, K> in;
+  Kokkos::Array<StreamDeviceArray, M> out;
+
+  KOKKOS_INLINE_FUNCTION void operator()(const StreamIndex i, const StreamIndex j,
+                                         const StreamIndex k, const StreamIndex l) const {
+    real_t sum = 0.0;
+    for (int q = 0; q < K; ++q) sum += in[q](i,j,k,l);
+    for (int m = 0; m < M; ++m) out[m](i,j,k,l) = (m + 1) * sum;
+  }
+};
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, int K, int M>
+void perform_multi_stream(const MultiStreamFunctor<K, M> &functor, const StreamTiling &tiling) {
+  constexpr auto rank = StreamDeviceArray::rank();
+  Kokkos::parallel_for(
+      "multi_stream",
+      Policy<outer, inner>(make_repeated_sequence<rank>(0),
+                           make_repeated_sequence<rank>(functor.out[0].extent(0)), tiling),
+      functor);
+
+  Kokkos::fence();
+}
+
+// Returns the maximal relative deviation of the outputs of 'functor' from
+// the expected values.
+template <int K, int M>
+real_t perform_validation(const MultiStreamFunctor<K, M> &functor) {
+  real_t sum = 0.0;
+  for (int q = 0; q < K; ++q) sum += input_init(q);
+
+  real_t max_error = 0.0;
+  for (int m = 0; m < M; ++m) {
+    const StreamDeviceArray out = functor.out[m];
+    const real_t expected       = (m + 1) * sum;
+    const StreamIndex n         = out.extent(0);
+    real_t error                = 0.0;
+    Kokkos::parallel_reduce(
+        "validation",
+        Policy<>({0, 0, 0, 0}, {n, n, n, n}),
+        KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l,
+                      real_t &update) {
+          const real_t diff = out(i,j,k,l) - expected;
+          const real_t err  = (diff < 0 ? -diff : diff) / expected;
+          update = err > update ? err : update;
+        },
+        Kokkos::Max<real_t>(error));
+    max_error = std::max(max_error, error);
+  }
+  return max_error;
+}
+
+// Times the kernel with K inputs and M outputs, returns the bandwidth in
+// GB/s counting all K+M views, or a negative value if the validation failed.
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, int K, int M>
+double run_case(const std::vector<StreamDeviceArray> &in, const std::vector<StreamDeviceArray> &out,
+                const StreamTiling &tiling) {
+  MultiStreamFunctor<K, M> functor;
+  for (int q = 0; q < K; ++q) functor.in[q] = in[q];
+  for (int m = 0; m < M; ++m) functor.out[m] = out[m];
+
+  double time = std::numeric_limits<double>::max();
+  Kokkos::Timer timer;
+  for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+    timer.reset();
+    perform_multi_stream<outer, inner>(functor, tiling);
+    time = std::min(time, timer.seconds());
+  }
+
+  const real_t epsilon = 4 * max_inputs * std::numeric_limits<real_t>::epsilon();
+  if (perform_validation(functor) > epsilon) return -1.0;
+
+  return 1.0e-09 * (K + M) * (double)sizeof(real_t) * (double)out[0].size() / time;
+}
+
+// Prints the bandwidth table for one tiling, rows K and columns M. With
+// 'heuristic' the tiling of each kernel is chosen for its K+M streams.
+template <Kokkos::Iterate outer, Kokkos::Iterate inner>
+int run_tiling(const std::vector<StreamDeviceArray> &in, const std::vector<StreamDeviceArray> &out,
+               const std::vector<int> &inputs, const std::vector<int> &outputs,
+               const StreamTiling &tiling, const bool heuristic) {
+  if (heuristic) {
+    printf("Tiling: heuristic for K+M streams\n");
+  } else {
+    printf("Tiling: %s\n", tiling_to_string(tiling).c_str());
+  }
+  printf("%4s", "K");
+  for (const int m : outputs) printf("      M = %d", m);
+  printf("\n%4s", "");
+  for (std::size_t m = 0; m < outputs.size(); ++m) printf(" %10s", "[Gbyte/s]");
+  printf("\n");
+
+  int rc = 0;
+  for (const int k : inputs) {
+    printf("%4d", k);
+    for (const int m : outputs) {
+      const StreamTiling t = heuristic ? heuristic_tiling(out[0], k + m) : tiling;
+      double bandwidth     = 0.0;
+      dispatch_count<1, max_inputs>(k, [&](auto nin) {
+        dispatch_count<1, max_outputs>(m, [&](auto nout) {
+          bandwidth = run_case<outer, inner, decltype(nin)::value, decltype(nout)::value>(in, out, t);
+        });
+      });
+      if (bandwidth < 0.0) {
+        printf(" %10s", "FAILED");
+        rc++;
+      } else {
+        printf(" %10.4f", bandwidth);
+      }
+      fflush(stdout);
+    }
+    printf("\n");
+  }
+  return rc;
+}
+
+int run_benchmark(const StreamIndex stream_array_size, const std::vector<int> &inputs,
+                  const std::vector<int> &outputs, const std::vector<StreamTiling> &tilings,
+                  const bool heuristic, const IteratePattern iterate) {
+  printf("Reports fastest timing per kernel\n");
+  report_memory_usage("initialize");
+
+  int max_k = 0;
+  int max_m = 0;
+  for (const int k : inputs) max_k = std::max(max_k, k);
+  for (const int m : outputs) max_m = std::max(max_m, m);
+
+  const double nelem = (double)stream_array_size*
+                       (double)stream_array_size*
+                       (double)stream_array_size*
+                       (double)stream_array_size;
+
+  printf("Memory Sizes:\n");
+  printf("- Array Size:    %" PRIu64 "^4\n",
+         static_cast<uint64_t>(stream_array_size));
+  printf("- Per Array:     %12.2f MB\n",
+         1.0e-6 * nelem * (double)sizeof(real_t));
+  printf("- Total: %12.2f MB (%d inputs, %d outputs)\n",
+         1.0e-6 * (max_k + max_m) * nelem * (double)sizeof(real_t), max_k, max_m);
+
+  printf("Benchmark kernels will be performed for %d iterations.\n",
+         STREAM_NTIMES);
+  printf("Iteration pattern: %s\n", iterate_pattern_name(iterate));
+  printf("Bandwidth counts K+M arrays per element.\n");
+
+  printf(HLINE);
+
+  const StreamIndex n = stream_array_size;
+  std::vector<StreamDeviceArray> in, out;
+  for (int q = 0; q < max_k; ++q)
+    in.emplace_back(Kokkos::view_alloc(Kokkos::WithoutInitializing, "in" + std::to_string(q)),
+                    n, n, n, n);
+  for (int m = 0; m < max_m; ++m)
+    out.emplace_back(Kokkos::view_alloc(Kokkos::WithoutInitializing, "out" + std::to_string(m)),
+                     n, n, n, n);
+  report_memory_usage("allocation");
+
+  // first touch with the same policy as the kernels
+  for (int q = 0; q < max_k; ++q) {
+    const StreamDeviceArray a = in[q];
+    const real_t value        = input_init(q);
+    Kokkos::parallel_for(
+        "init_dev", Policy<>({0, 0, 0, 0}, {n, n, n, n}),
+        KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+        { a(i,j,k,l) = value; });
+  }
+  for (int m = 0; m < max_m; ++m) {
+    const StreamDeviceArray a = out[m];
+    Kokkos::parallel_for(
+        "init_dev", Policy<>({0, 0, 0, 0}, {n, n, n, n}),
+        KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+        { a(i,j,k,l) = 0.0; });
+  }
+  Kokkos::fence();
+  report_memory_usage("first touch");
+
+  int rc = 0;
+  dispatch_iterate(iterate, [&](auto o, auto i) {
+    constexpr Kokkos::Iterate outer = decltype(o)::value;
+    constexpr Kokkos::Iterate inner = decltype(i)::value;
+    for (const auto &tiling : tilings) {
+      rc += run_tiling<outer, inner>(in, out, inputs, outputs, tiling, false);
+      printf(HLINE);
+    }
+    if (heuristic) {
+      rc += run_tiling<outer, inner>(in, out, inputs, outputs, StreamTiling{0, 0, 0, 0}, true);
+      printf(HLINE);
+    }
+  });
+
+  report_memory_usage("kernels");
+
+  if (rc != 0) {
+    fprintf(stderr, "Error: validation check failed for %d kernels.\n", rc);
+  } else {
+    printf("All solutions checked and verified.\n");
+  }
+
+  return rc;
+}
+
+int main(int argc, char *argv[]) {
+  printf(HLINE);
+  printf("Kokkos 4D MDRangePolicy multi-stream STREAM Benchmark\n");
+  printf(HLINE);
+
+  Kokkos::initialize(argc, argv);
+  int rc;
+  StreamIndex stream_array_size;
+  std::vector<int> inputs, outputs;
+  std::vector<StreamTiling> tilings;
+  bool heuristic;
+  IteratePattern iterate;
+  rc = parse_args(argc, argv, stream_array_size, inputs, outputs, tilings, heuristic, iterate);
+  if (rc == 0) {
+    report_thread_affinity();
+    printf(HLINE);
+    rc = run_benchmark(stream_array_size, inputs, outputs, tilings, heuristic, iterate);
+  } else if (rc == -2) {
+    // Don't return error code when called with "-h"
+    rc = 0;
+  }
+  Kokkos::finalize();
+
+  return rc;
+}
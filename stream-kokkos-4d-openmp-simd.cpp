@@ -55,6 +55,11 @@
 
 #include <sys/time.h>
 
+#include "stream-affinity.hpp"
+#include "stream-large-index.hpp"
+#include "stream-memory.hpp"
+#include "stream-omp-schedule.hpp"
+
 #define COLLAPSE 3
 
 #define STREAM_NTIMES 20
@@ -95,14 +100,30 @@ constexpr real_t ainit = 1.0;
 constexpr real_t binit = 1.1;
 constexpr real_t cinit = 0.0;
 
-int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
+int parse_args(int argc, char **argv, StreamIndex &stream_array_size,
+               std::string &schedule, bool &schedule_sweep,
+               bool &large_index_test) {
   // Defaults
+  large_index_test = false;
   stream_array_size = 32;
+  schedule.clear();
+  schedule_sweep = false;
 
   const std::string help_string =
       "  -n <N>, --nelements <N>\n"
       "     Create stream views containing <N>^4 elements.\n"
       "     Default: 32\n"
+      "  -s <S>, --schedule <S>\n"
+      "     OpenMP loop schedule as in OMP_SCHEDULE, <kind>[,<chunk>] with kind\n"
+      "     static, dynamic, guided or auto.\n"
+      "     Default: OMP_SCHEDULE if set, else static\n"
+      "  -S, --schedule-sweep\n"
+      "     After the benchmark, run all kernels with static, dynamic and guided\n"
+      "     schedules and several chunk sizes, and report the per-thread load\n"
+      "     imbalance.\n"
+      "  -L, --large-index-test\n"
+      "     Only check the index arithmetic for more than 2^32 elements (no\n"
+      "     memory is allocated), then exit.\n"
       "  -h, --help\n"
       "     Prints this message.\n"
       "     Hint: use --kokkos-help to see command line options provided by "
@@ -110,15 +131,34 @@ int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
 
   static struct option long_options[] = {
       {"nelements", required_argument, NULL, 'n'},
+      {"schedule", required_argument, NULL, 's'},
+      {"schedule-sweep", no_argument, NULL, 'S'},
+      {"large-index-test", no_argument, NULL, 'L'},
       {"help", no_argument, NULL, 'h'},
       {NULL, 0, NULL, 0}};
 
   int c;
   int option_index = 0;
-  while ((c = getopt_long(argc, argv, "n:h", long_options, &option_index)) !=
+  while ((c = getopt_long(argc, argv, "n:s:SLh", long_options, &option_index)) !=
          -1)
     switch (c) {
-      case 'n': stream_array_size = atoi(optarg); break;
+      case 'n':
+        if (!parse_extent(optarg, stream_array_size)) {
+          fprintf(stderr, "Error: '%s' is not a valid number of elements.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'L': large_index_test = true; break;
+      case 's': {
+        OmpSchedule parsed;
+        if (!parse_omp_schedule(optarg, parsed)) {
+          fprintf(stderr, "Error: '%s' is not a valid OpenMP schedule.\n", optarg);
+          return -1;
+        }
+        schedule = optarg;
+        break;
+      }
+      case 'S': schedule_sweep = true; break;
       case 'h':
         printf("%s", help_string.c_str());
         return -2;
@@ -132,81 +172,110 @@ int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
   return 0;
 }
 
-void perform_set(const StreamDeviceArray a, const real_t scalar) {
+void perform_set(const StreamDeviceArray a, const real_t scalar,
+                 double *busy = nullptr) {
   const StreamIndex N = a.extent(0);
-#pragma omp parallel for collapse(COLLAPSE)
-  for(StreamIndex i = 0; i < N; ++i){
-    for(StreamIndex j = 0; j < N; ++j){
-      for(StreamIndex k = 0; k < N; ++k){
+#pragma omp parallel
+  {
+    const double start = omp_wall_time();
+#pragma omp for collapse(COLLAPSE) schedule(runtime) nowait
+    for(StreamIndex i = 0; i < N; ++i){
+      for(StreamIndex j = 0; j < N; ++j){
+        for(StreamIndex k = 0; k < N; ++k){
 #pragma omp simd
-        for(StreamIndex l = 0; l < N; ++l){
-          a(i,j,k,l) = scalar;
+          for(StreamIndex l = 0; l < N; ++l){
+            a(i,j,k,l) = scalar;
+          }
         }
       }
     }
+    record_thread_busy(busy, start);
   }
 }
 
-void perform_copy(const constStreamDeviceArray a, StreamDeviceArray b) {
+void perform_copy(const constStreamDeviceArray a, StreamDeviceArray b,
+                  double *busy = nullptr) {
   const StreamIndex N = a.extent(0);
-#pragma omp parallel for collapse(COLLAPSE)
-  for(StreamIndex i = 0; i < N; ++i){
-    for(StreamIndex j = 0; j < N; ++j){
-      for(StreamIndex k = 0; k < N; ++k){
+#pragma omp parallel
+  {
+    const double start = omp_wall_time();
+#pragma omp for collapse(COLLAPSE) schedule(runtime) nowait
+    for(StreamIndex i = 0; i < N; ++i){
+      for(StreamIndex j = 0; j < N; ++j){
+        for(StreamIndex k = 0; k < N; ++k){
 #pragma omp simd
-        for(StreamIndex l = 0; l < N; ++l){
-          b(i,j,k,l) = a(i,j,k,l);
+          for(StreamIndex l = 0; l < N; ++l){
+            b(i,j,k,l) = a(i,j,k,l);
+          }
         }
       }
     }
+    record_thread_busy(busy, start);
   }
 }
 
 void perform_scale(StreamDeviceArray b, const constStreamDeviceArray c,
-                   const real_t scalar) {
+                   const real_t scalar, double *busy = nullptr) {
   const StreamIndex N = b.extent(0);
-#pragma omp parallel for collapse(COLLAPSE)
-  for(StreamIndex i = 0; i < N; ++i){
-    for(StreamIndex j = 0; j < N; ++j){
-      for(StreamIndex k = 0; k < N; ++k){
+#pragma omp parallel
+  {
+    const double start = omp_wall_time();
+#pragma omp for collapse(COLLAPSE) schedule(runtime) nowait
+    for(StreamIndex i = 0; i < N; ++i){
+      for(StreamIndex j = 0; j < N; ++j){
+        for(StreamIndex k = 0; k < N; ++k){
 #pragma omp simd
-        for(StreamIndex l = 0; l < N; ++l){
-          b(i,j,k,l) = scalar * c(i,j,k,l);
+          for(StreamIndex l = 0; l < N; ++l){
+            b(i,j,k,l) = scalar * c(i,j,k,l);
+          }
         }
       }
     }
+    record_thread_busy(busy, start);
   }
 }
 
 void perform_add(const constStreamDeviceArray a,
-                 const constStreamDeviceArray b, StreamDeviceArray c) {
+                 const constStreamDeviceArray b, StreamDeviceArray c,
+                 double *busy = nullptr) {
   const StreamIndex N = a.extent(0);
-#pragma omp parallel for collapse(COLLAPSE)
-  for(StreamIndex i = 0; i < N; ++i){
-    for(StreamIndex j = 0; j < N; ++j){
-      for(StreamIndex k = 0; k < N; ++k){
+#pragma omp parallel
+  {
+    const double start = omp_wall_time();
+#pragma omp for collapse(COLLAPSE) schedule(runtime) nowait
+    for(StreamIndex i = 0; i < N; ++i){
+      for(StreamIndex j = 0; j < N; ++j){
+        for(StreamIndex k = 0; k < N; ++k){
 #pragma omp simd
-        for(StreamIndex l = 0; l < N; ++l){
-          c(i,j,k,l) = a(i,j,k,l) + b(i,j,k,l);
+          for(StreamIndex l = 0; l < N; ++l){
+            c(i,j,k,l) = a(i,j,k,l) + b(i,j,k,l);
+          }
         }
       }
     }
+    record_thread_busy(busy, start);
   }
 }
 
 void perform_triad(StreamDeviceArray a, const constStreamDeviceArray b,
-                   const constStreamDeviceArray c, const real_t scalar) {
+                   const constStreamDeviceArray c, const real_t scalar,
+                   double *busy = nullptr) {
   const StreamIndex N = a.extent(0);
-#pragma omp parallel for collapse(COLLAPSE)
-  for(StreamIndex i = 0; i < N; ++i){
-    for(StreamIndex j = 0; j < N; ++j){
-      for(StreamIndex k = 0; k < N; ++k){
+#pragma omp parallel
+  {
+    const double start = omp_wall_time();
+#pragma omp for collapse(COLLAPSE) schedule(runtime) nowait
+    for(StreamIndex i = 0; i < N; ++i){
+      for(StreamIndex j = 0; j < N; ++j){
+        for(StreamIndex k = 0; k < N; ++k){
 #pragma omp simd
-        for(StreamIndex l = 0; l < N; ++l){
-          a(i,j,k,l) = b(i,j,k,l) + scalar * c(i,j,k,l);
+          for(StreamIndex l = 0; l < N; ++l){
+            a(i,j,k,l) = b(i,j,k,l) + scalar * c(i,j,k,l);
+          }
         }
       }
     }
+    record_thread_busy(busy, start);
   }
 }
 
@@ -242,10 +311,10 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
   {
     double err = 0.0;
     #pragma omp for collapse(2)
-    for (StreamIndex i = 0; i < arraySize; ++i) {
-      for (StreamIndex j = 0; j < arraySize; ++j) {
-        for (StreamIndex k = 0; k < arraySize; ++k) {
-          for (StreamIndex l = 0; l < arraySize; ++l) {
+    for (StreamSize i = 0; i < arraySize; ++i) {
+      for (StreamSize j = 0; j < arraySize; ++j) {
+        for (StreamSize k = 0; k < arraySize; ++k) {
+          for (StreamSize l = 0; l < arraySize; ++l) {
             err = std::abs(a(i,j,k,l) - ai);
             if( err > epsilon ){
               //std::cout << "aError " << " i: " << i << " j: " << j << " k: " << k << " l: " << l << " err: " << err << "\n";
@@ -303,8 +372,91 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
   return errorCount;
 }
 
-int run_benchmark(const StreamIndex stream_array_size) {
+// Times every kernel with a range of OpenMP schedules. The imbalance is the
+// maximum over the kernels of max / mean per-thread busy time in the
+// fastest run.
+void perform_schedule_sweep(StreamDeviceArray a, StreamDeviceArray b,
+                            StreamDeviceArray c, const real_t scalar) {
+  const double streams[] = {1.0, 2.0, 2.0, 3.0, 3.0};
+  printf("OpenMP schedules (collapse depth %d):\n", COLLAPSE);
+  printf("%-12s %10s %10s %10s %10s %10s %9s\n", "schedule", "Set", "Copy", "Scale",
+         "Add", "Triad", "imbalance");
+  printf("%-12s %10s %10s %10s %10s %10s %9s\n", "", "[Gbyte/s]", "[Gbyte/s]",
+         "[Gbyte/s]", "[Gbyte/s]", "[Gbyte/s]", "[max/avg]");
+  std::vector<double> busy(omp_max_threads());
+  Kokkos::Timer timer;
+  for (const auto &schedule : omp_schedule_sweep()) {
+    set_omp_schedule(schedule);
+    double times[5], imbalance[5];
+    for (int n = 0; n < 5; ++n) times[n] = std::numeric_limits<double>::max();
+    const auto record = [&](const int n) {
+      const double t = timer.seconds();
+      if (t < times[n]) {
+        times[n] = t;
+        imbalance[n] = thread_imbalance(busy);
+      }
+      std::fill(busy.begin(), busy.end(), 0.0);
+    };
+    for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+      timer.reset();
+      perform_set(c, 1.5, busy.data());
+      record(0);
+      timer.reset();
+      perform_copy(a, c, busy.data());
+      record(1);
+      timer.reset();
+      perform_scale(b, c, scalar, busy.data());
+      record(2);
+      timer.reset();
+      perform_add(a, b, c, busy.data());
+      record(3);
+      timer.reset();
+      perform_triad(a, b, c, scalar, busy.data());
+      record(4);
+    }
+    const double bytes = 1.0e-9 * (double)sizeof(real_t) * (double)a.size();
+    printf("%-12s", omp_schedule_name(schedule).c_str());
+    for (int n = 0; n < 5; ++n) printf(" %10.4f", streams[n] * bytes / times[n]);
+    printf(" %9.3f\n", *std::max_element(imbalance, imbalance + 5));
+  }
+}
+
+// Runs the loop nest of the kernels over large_index_extent(4)^4 > 2^32
+// points and checks the 64 bit offsets of every point, see
+// stream-large-index.hpp.
+int perform_large_index_test(const std::string &schedule) {
+  init_omp_schedule(schedule.empty() ? nullptr : schedule.c_str());
+  const StreamIndex N = large_index_extent(4);
+  const auto stride = large_index_strides<StreamDeviceArray>(N);
+  std::uint64_t count = 0;
+  std::uint64_t sum = 0;
+  StreamSize offset_max = -1;
+#pragma omp parallel for collapse(COLLAPSE) schedule(runtime) reduction(+:count,sum) reduction(max:offset_max)
+  for(StreamIndex i = 0; i < N; ++i){
+    for(StreamIndex j = 0; j < N; ++j){
+      for(StreamIndex k = 0; k < N; ++k){
+#pragma omp simd reduction(+:count,sum) reduction(max:offset_max)
+        for(StreamIndex l = 0; l < N; ++l){
+          const StreamSize offset = i * stride[0] + j * stride[1] + k * stride[2] + l * stride[3];
+          count += 1;
+          sum += static_cast<std::uint64_t>(offset);
+          offset_max = offset > offset_max ? offset : offset_max;
+        }
+      }
+    }
+  }
+  LargeIndexResult r;
+  r.count = count;
+  r.offset_sum = sum;
+  r.offset_max = offset_max;
+  print_large_index_header(N, 4);
+  return check_large_index_result("loop nest", total_elements(N, 4), r);
+}
+
+int run_benchmark(const StreamIndex stream_array_size, const std::string &schedule,
+                  const bool schedule_sweep) {
   printf("Reports fastest timing per kernel\n");
+  report_memory_usage("initialize");
   printf("Creating Views...\n");
 
   const double nelem = (double)stream_array_size*
@@ -323,6 +475,8 @@ int run_benchmark(const StreamIndex stream_array_size) {
   printf("Benchmark kernels will be performed for %d iterations.\n",
          STREAM_NTIMES);
 
+  init_omp_schedule(schedule.empty() ? nullptr : schedule.c_str());
+
   printf(HLINE);
 
   // WithoutInitializing to circumvent first touch bug on arm systems
@@ -345,10 +499,11 @@ int run_benchmark(const StreamIndex stream_array_size) {
   double addTime   = std::numeric_limits<double>::max();
   double triadTime = std::numeric_limits<double>::max();
 
+  report_memory_usage("allocation");
   printf("Initializing Views...\n");
 
   const StreamIndex N = a.extent(0);
-#pragma omp parallel for collapse(COLLAPSE)
+#pragma omp parallel for collapse(COLLAPSE) schedule(runtime)
   for(StreamIndex i = 0; i < N; ++i){
     for(StreamIndex j = 0; j < N; ++j){
       for(StreamIndex k = 0; k < N; ++k){
@@ -362,7 +517,7 @@ int run_benchmark(const StreamIndex stream_array_size) {
     }
   }
 
-#pragma omp parallel for collapse(COLLAPSE)
+#pragma omp parallel for collapse(COLLAPSE) schedule(runtime)
   for(StreamIndex i = 0; i < N; ++i){
     for(StreamIndex j = 0; j < N; ++j){
       for(StreamIndex k = 0; k < N; ++k){
@@ -376,6 +531,7 @@ int run_benchmark(const StreamIndex stream_array_size) {
     }
   }
 
+  report_memory_usage("first touch");
   printf("Starting benchmarking...\n");
 
   Kokkos::Timer timer;
@@ -402,12 +558,14 @@ int run_benchmark(const StreamIndex stream_array_size) {
     triadTime = std::min(triadTime, timer.seconds());
   }
 
+  report_memory_usage("kernels");
   Kokkos::deep_copy(a, dev_a);
   Kokkos::deep_copy(b, dev_b);
   Kokkos::deep_copy(c, dev_c);
 
   printf("Performing validation...\n");
   int rc = perform_validation(a, b, c, stream_array_size, scalar);
+  report_memory_usage("validation");
 
   printf(HLINE);
 
@@ -433,6 +591,12 @@ int run_benchmark(const StreamIndex stream_array_size) {
 
   printf(HLINE);
 
+  if (schedule_sweep) {
+    // runs after validation, the views are overwritten
+    perform_schedule_sweep(dev_a, dev_b, dev_c, scalar);
+    printf(HLINE);
+  }
+
   return rc;
 }
 
@@ -443,10 +607,18 @@ int main(int argc, char *argv[]) {
 
   Kokkos::initialize(argc, argv);
   int rc;
+  bool large_index_test;
   StreamIndex stream_array_size;
-  rc = parse_args(argc, argv, stream_array_size);
-  if (rc == 0) {
-    rc = run_benchmark(stream_array_size);
+  std::string schedule;
+  bool schedule_sweep;
+  rc = parse_args(argc, argv, stream_array_size, schedule, schedule_sweep,
+                  large_index_test);
+  if (rc == 0 && large_index_test) {
+    rc = perform_large_index_test(schedule);
+  } else if (rc == 0) {
+    report_thread_affinity();
+    printf(HLINE);
+    rc = run_benchmark(stream_array_size, schedule, schedule_sweep);
   } else if (rc == -2) {
     // Don't return error code when called with "-h"
     rc = 0;
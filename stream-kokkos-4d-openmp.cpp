@@ -55,6 +55,13 @@
 
 #include <sys/time.h>
 
+#include "stream-affinity.hpp"
+#include "stream-large-index.hpp"
+#include "stream-loop-nest.hpp"
+#include "stream-memory.hpp"
+#include "stream-omp-schedule.hpp"
+
+// default collapse depth
 #define COLLAPSE 3
 
 #define STREAM_NTIMES 20
@@ -95,14 +102,44 @@ constexpr real_t ainit = 1.0;
 constexpr real_t binit = 1.1;
 constexpr real_t cinit = 0.0;
 
-int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
+int parse_args(int argc, char **argv, StreamIndex &stream_array_size, int &order,
+               int &collapse, bool &order_sweep, std::string &schedule,
+               bool &schedule_sweep,
+               bool &large_index_test) {
   // Defaults
+  large_index_test = false;
   stream_array_size = 32;
+  order = 0;
+  collapse = COLLAPSE;
+  order_sweep = false;
+  schedule.clear();
+  schedule_sweep = false;
 
   const std::string help_string =
       "  -n <N>, --nelements <N>\n"
       "     Create stream views containing <N>^4 elements.\n"
       "     Default: 32\n"
+      "  -o <O>, --order <O>\n"
+      "     Loop order from the outermost to the innermost loop, any permutation\n"
+      "     of ijkl.\n"
+      "     Default: ijkl\n"
+      "  -c <C>, --collapse <C>\n"
+      "     Number of collapsed loops, 1 to 4.\n"
+      "     Default: 3\n"
+      "  -P, --permutations\n"
+      "     After the benchmark, run all kernels with all 24 loop orders and\n"
+      "     collapse depths 1 to 4.\n"
+      "  -s <S>, --schedule <S>\n"
+      "     OpenMP loop schedule as in OMP_SCHEDULE, <kind>[,<chunk>] with kind\n"
+      "     static, dynamic, guided or auto.\n"
+      "     Default: OMP_SCHEDULE if set, else static\n"
+      "  -S, --schedule-sweep\n"
+      "     After the benchmark, run all kernels with static, dynamic and guided\n"
+      "     schedules and several chunk sizes, and report the per-thread load\n"
+      "     imbalance.\n"
+      "  -L, --large-index-test\n"
+      "     Only check the index arithmetic for more than 2^32 elements (no\n"
+      "     memory is allocated), then exit.\n"
       "  -h, --help\n"
       "     Prints this message.\n"
       "     Hint: use --kokkos-help to see command line options provided by "
@@ -110,15 +147,52 @@ int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
 
   static struct option long_options[] = {
       {"nelements", required_argument, NULL, 'n'},
+      {"order", required_argument, NULL, 'o'},
+      {"collapse", required_argument, NULL, 'c'},
+      {"permutations", no_argument, NULL, 'P'},
+      {"schedule", required_argument, NULL, 's'},
+      {"schedule-sweep", no_argument, NULL, 'S'},
+      {"large-index-test", no_argument, NULL, 'L'},
       {"help", no_argument, NULL, 'h'},
       {NULL, 0, NULL, 0}};
 
   int c;
   int option_index = 0;
-  while ((c = getopt_long(argc, argv, "n:h", long_options, &option_index)) !=
+  while ((c = getopt_long(argc, argv, "n:o:c:Ps:SLh", long_options, &option_index)) !=
          -1)
     switch (c) {
-      case 'n': stream_array_size = atoi(optarg); break;
+      case 'n':
+        if (!parse_extent(optarg, stream_array_size)) {
+          fprintf(stderr, "Error: '%s' is not a valid number of elements.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'L': large_index_test = true; break;
+      case 'o':
+        order = parse_loop_order(optarg);
+        if (order < 0) {
+          fprintf(stderr, "Error: '%s' is not a permutation of ijkl.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'c':
+        if (!parse_int_in_range(optarg, 1, max_loop_collapse, collapse)) {
+          fprintf(stderr, "Error: collapse depth must be between 1 and %d.\n",
+                  max_loop_collapse);
+          return -1;
+        }
+        break;
+      case 'P': order_sweep = true; break;
+      case 's': {
+        OmpSchedule parsed;
+        if (!parse_omp_schedule(optarg, parsed)) {
+          fprintf(stderr, "Error: '%s' is not a valid OpenMP schedule.\n", optarg);
+          return -1;
+        }
+        schedule = optarg;
+        break;
+      }
+      case 'S': schedule_sweep = true; break;
       case 'h':
         printf("%s", help_string.c_str());
         return -2;
@@ -132,77 +206,56 @@ int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
   return 0;
 }
 
-void perform_set(const StreamDeviceArray a, const real_t scalar) {
+void perform_set(const StreamDeviceArray a, const real_t scalar,
+                 const int order, const int collapse,
+                 double *busy = nullptr) {
   const StreamIndex N = a.extent(0);
-#pragma omp parallel for collapse(COLLAPSE)
-  for(StreamIndex i = 0; i < N; ++i){
-    for(StreamIndex j = 0; j < N; ++j){
-      for(StreamIndex k = 0; k < N; ++k){
-        for(StreamIndex l = 0; l < N; ++l){
-          a(i,j,k,l) = scalar;
-        }
-      }
-    }
-  }
+  dispatch_loop_nest(order, collapse, [&](auto nest) {
+    decltype(nest)::run(N, [=](const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+                        { a(i,j,k,l) = scalar; }, busy);
+  });
 }
 
-void perform_copy(const constStreamDeviceArray a, StreamDeviceArray b) {
+void perform_copy(const constStreamDeviceArray a, StreamDeviceArray b,
+                  const int order, const int collapse,
+                  double *busy = nullptr) {
   const StreamIndex N = a.extent(0);
-#pragma omp parallel for collapse(COLLAPSE)
-  for(StreamIndex i = 0; i < N; ++i){
-    for(StreamIndex j = 0; j < N; ++j){
-      for(StreamIndex k = 0; k < N; ++k){
-        for(StreamIndex l = 0; l < N; ++l){
-          b(i,j,k,l) = a(i,j,k,l);
-        }
-      }
-    }
-  }
+  dispatch_loop_nest(order, collapse, [&](auto nest) {
+    decltype(nest)::run(N, [=](const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+                        { b(i,j,k,l) = a(i,j,k,l); }, busy);
+  });
 }
 
 void perform_scale(StreamDeviceArray b, const constStreamDeviceArray c,
-                   const real_t scalar) {
+                   const real_t scalar, const int order, const int collapse,
+                   double *busy = nullptr) {
   const StreamIndex N = b.extent(0);
-#pragma omp parallel for collapse(COLLAPSE)
-  for(StreamIndex i = 0; i < N; ++i){
-    for(StreamIndex j = 0; j < N; ++j){
-      for(StreamIndex k = 0; k < N; ++k){
-        for(StreamIndex l = 0; l < N; ++l){
-          b(i,j,k,l) = scalar * c(i,j,k,l);
-        }
-      }
-    }
-  }
+  dispatch_loop_nest(order, collapse, [&](auto nest) {
+    decltype(nest)::run(N, [=](const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+                        { b(i,j,k,l) = scalar * c(i,j,k,l); }, busy);
+  });
 }
 
 void perform_add(const constStreamDeviceArray a,
-                 const constStreamDeviceArray b, StreamDeviceArray c) {
+                 const constStreamDeviceArray b, StreamDeviceArray c,
+                 const int order, const int collapse,
+                 double *busy = nullptr) {
   const StreamIndex N = a.extent(0);
-#pragma omp parallel for collapse(COLLAPSE)
-  for(StreamIndex i = 0; i < N; ++i){
-    for(StreamIndex j = 0; j < N; ++j){
-      for(StreamIndex k = 0; k < N; ++k){
-        for(StreamIndex l = 0; l < N; ++l){
-          c(i,j,k,l) = a(i,j,k,l) + b(i,j,k,l);
-        }
-      }
-    }
-  }
+  dispatch_loop_nest(order, collapse, [&](auto nest) {
+    decltype(nest)::run(N, [=](const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+                        { c(i,j,k,l) = a(i,j,k,l) + b(i,j,k,l); }, busy);
+  });
 }
 
 void perform_triad(StreamDeviceArray a, const constStreamDeviceArray b,
-                   const constStreamDeviceArray c, const real_t scalar) {
+                   const constStreamDeviceArray c, const real_t scalar,
+                   const int order, const int collapse,
+                  double *busy = nullptr) {
   const StreamIndex N = a.extent(0);
-#pragma omp parallel for collapse(COLLAPSE)
-  for(StreamIndex i = 0; i < N; ++i){
-    for(StreamIndex j = 0; j < N; ++j){
-      for(StreamIndex k = 0; k < N; ++k){
-        for(StreamIndex l = 0; l < N; ++l){
-          a(i,j,k,l) = b(i,j,k,l) + scalar * c(i,j,k,l);
-        }
-      }
-    }
-  }
+  dispatch_loop_nest(order, collapse, [&](auto nest) {
+    decltype(nest)::run(N, [=](const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+                        { a(i,j,k,l) = b(i,j,k,l) + scalar * c(i,j,k,l); }, busy);
+  });
 }
 
 int perform_validation(StreamHostArray &a, StreamHostArray &b,
@@ -237,10 +290,10 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
   {
     double err = 0.0;
     #pragma omp for collapse(2)
-    for (StreamIndex i = 0; i < arraySize; ++i) {
-      for (StreamIndex j = 0; j < arraySize; ++j) {
-        for (StreamIndex k = 0; k < arraySize; ++k) {
-          for (StreamIndex l = 0; l < arraySize; ++l) {
+    for (StreamSize i = 0; i < arraySize; ++i) {
+      for (StreamSize j = 0; j < arraySize; ++j) {
+        for (StreamSize k = 0; k < arraySize; ++k) {
+          for (StreamSize l = 0; l < arraySize; ++l) {
             err = std::abs(a(i,j,k,l) - ai);
             if( err > epsilon ){
               //std::cout << "aError " << " i: " << i << " j: " << j << " k: " << k << " l: " << l << " err: " << err << "\n";
@@ -298,8 +351,123 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
   return errorCount;
 }
 
-int run_benchmark(const StreamIndex stream_array_size) {
+// Times every kernel for all loop orders and collapse depths.
+void perform_loop_order_sweep(StreamDeviceArray a, StreamDeviceArray b,
+                              StreamDeviceArray c, const real_t scalar) {
+  const double streams[] = {1.0, 2.0, 2.0, 3.0, 3.0};
+  printf("Loop orders (outermost first) and collapse depths:\n");
+  printf("%-6s %8s %10s %10s %10s %10s %10s\n", "order", "collapse", "Set", "Copy", "Scale",
+         "Add", "Triad");
+  printf("%-6s %8s %10s %10s %10s %10s %10s\n", "", "", "[Gbyte/s]", "[Gbyte/s]",
+         "[Gbyte/s]", "[Gbyte/s]", "[Gbyte/s]");
+  Kokkos::Timer timer;
+  for (int order = 0; order < num_loop_orders; ++order) {
+    for (int collapse = 1; collapse <= max_loop_collapse; ++collapse) {
+      double times[5];
+      for (int n = 0; n < 5; ++n) times[n] = std::numeric_limits<double>::max();
+      for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+        timer.reset();
+        perform_set(c, 1.5, order, collapse);
+        times[0] = std::min(times[0], timer.seconds());
+        timer.reset();
+        perform_copy(a, c, order, collapse);
+        times[1] = std::min(times[1], timer.seconds());
+        timer.reset();
+        perform_scale(b, c, scalar, order, collapse);
+        times[2] = std::min(times[2], timer.seconds());
+        timer.reset();
+        perform_add(a, b, c, order, collapse);
+        times[3] = std::min(times[3], timer.seconds());
+        timer.reset();
+        perform_triad(a, b, c, scalar, order, collapse);
+        times[4] = std::min(times[4], timer.seconds());
+      }
+      const double bytes = 1.0e-9 * (double)sizeof(real_t) * (double)a.size();
+      printf("%-6s %8d", loop_order_name(order).c_str(), collapse);
+      for (int n = 0; n < 5; ++n) printf(" %10.4f", streams[n] * bytes / times[n]);
+      printf("\n");
+    }
+  }
+}
+
+// Times every kernel with a range of OpenMP schedules. The imbalance is the
+// maximum over the kernels of max / mean per-thread busy time in the
+// fastest run.
+void perform_schedule_sweep(StreamDeviceArray a, StreamDeviceArray b,
+                            StreamDeviceArray c, const real_t scalar,
+                            const int order, const int collapse) {
+  const double streams[] = {1.0, 2.0, 2.0, 3.0, 3.0};
+  printf("OpenMP schedules (loop order %s, collapse depth %d):\n",
+         loop_order_name(order).c_str(), collapse);
+  printf("%-12s %10s %10s %10s %10s %10s %9s\n", "schedule", "Set", "Copy", "Scale",
+         "Add", "Triad", "imbalance");
+  printf("%-12s %10s %10s %10s %10s %10s %9s\n", "", "[Gbyte/s]", "[Gbyte/s]",
+         "[Gbyte/s]", "[Gbyte/s]", "[Gbyte/s]", "[max/avg]");
+  std::vector<double> busy(omp_max_threads());
+  Kokkos::Timer timer;
+  for (const auto &schedule : omp_schedule_sweep()) {
+    set_omp_schedule(schedule);
+    double times[5], imbalance[5];
+    for (int n = 0; n < 5; ++n) times[n] = std::numeric_limits<double>::max();
+    const auto record = [&](const int n) {
+      const double t = timer.seconds();
+      if (t < times[n]) {
+        times[n] = t;
+        imbalance[n] = thread_imbalance(busy);
+      }
+      std::fill(busy.begin(), busy.end(), 0.0);
+    };
+    for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+      timer.reset();
+      perform_set(c, 1.5, order, collapse, busy.data());
+      record(0);
+      timer.reset();
+      perform_copy(a, c, order, collapse, busy.data());
+      record(1);
+      timer.reset();
+      perform_scale(b, c, scalar, order, collapse, busy.data());
+      record(2);
+      timer.reset();
+      perform_add(a, b, c, order, collapse, busy.data());
+      record(3);
+      timer.reset();
+      perform_triad(a, b, c, scalar, order, collapse, busy.data());
+      record(4);
+    }
+    const double bytes = 1.0e-9 * (double)sizeof(real_t) * (double)a.size();
+    printf("%-12s", omp_schedule_name(schedule).c_str());
+    for (int n = 0; n < 5; ++n) printf(" %10.4f", streams[n] * bytes / times[n]);
+    printf(" %9.3f\n", *std::max_element(imbalance, imbalance + 5));
+  }
+}
+
+// Runs the selected loop nest over large_index_extent(4)^4 > 2^32 points
+// and checks the 64 bit offsets of every point, see stream-large-index.hpp.
+int perform_large_index_test(const int order, const int collapse,
+                             const std::string &schedule) {
+  init_omp_schedule(schedule.empty() ? nullptr : schedule.c_str());
+  printf("Loop order: %s, collapse: %d\n", loop_order_name(order).c_str(), collapse);
+  const StreamIndex N = large_index_extent(4);
+  const auto stride = large_index_strides<StreamDeviceArray>(N);
+  std::vector<LargeIndexResult> partial(omp_max_threads());
+  dispatch_loop_nest(order, collapse, [&](auto nest) {
+    decltype(nest)::run(N, [&](const StreamIndex i, const StreamIndex j, const StreamIndex k,
+                               const StreamIndex l) {
+      partial[omp_thread_id()].add(i * stride[0] + j * stride[1] + k * stride[2] +
+                                   l * stride[3]);
+    });
+  });
+  LargeIndexResult r;
+  for (const auto &p : partial) r.join(p);
+  print_large_index_header(N, 4);
+  return check_large_index_result("loop nest", total_elements(N, 4), r);
+}
+
+int run_benchmark(const StreamIndex stream_array_size, const int order,
+                  const int collapse, const bool order_sweep,
+                  const std::string &schedule, const bool schedule_sweep) {
   printf("Reports fastest timing per kernel\n");
+  report_memory_usage("initialize");
   printf("Creating Views...\n");
 
   const double nelem = (double)stream_array_size*
@@ -318,6 +486,10 @@ int run_benchmark(const StreamIndex stream_array_size) {
   printf("Benchmark kernels will be performed for %d iterations.\n",
          STREAM_NTIMES);
 
+  printf("Loop order:      %s\n", loop_order_name(order).c_str());
+  printf("Collapse depth:  %d\n", collapse);
+  init_omp_schedule(schedule.empty() ? nullptr : schedule.c_str());
+
   printf(HLINE);
 
   // WithoutInitializing to circumvent first touch bug on arm systems
@@ -340,67 +512,59 @@ int run_benchmark(const StreamIndex stream_array_size) {
   double addTime   = std::numeric_limits<double>::max();
   double triadTime = std::numeric_limits<double>::max();
 
+  report_memory_usage("allocation");
   printf("Initializing Views...\n");
 
+  // first touch with the same loop order and collapse depth as the kernels
   const StreamIndex N = a.extent(0);
-#pragma omp parallel for collapse(COLLAPSE)
-  for(StreamIndex i = 0; i < N; ++i){
-    for(StreamIndex j = 0; j < N; ++j){
-      for(StreamIndex k = 0; k < N; ++k){
-        for(StreamIndex l = 0; l < N; ++l){
-          a(i,j,k,l) = ainit;
-          b(i,j,k,l) = binit;
-          c(i,j,k,l) = cinit;
-        }
-      }
-    }
-  }
-
-#pragma omp parallel for collapse(COLLAPSE)
-  for(StreamIndex i = 0; i < N; ++i){
-    for(StreamIndex j = 0; j < N; ++j){
-      for(StreamIndex k = 0; k < N; ++k){
-        for(StreamIndex l = 0; l < N; ++l){
-          dev_a(i,j,k,l) = ainit;
-          dev_b(i,j,k,l) = binit;
-          dev_c(i,j,k,l) = cinit;
-        }
-      }
-    }
-  }
-
+  dispatch_loop_nest(order, collapse, [&](auto nest) {
+    decltype(nest)::run(N, [=](const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
+      a(i,j,k,l) = ainit;
+      b(i,j,k,l) = binit;
+      c(i,j,k,l) = cinit;
+    });
+    decltype(nest)::run(N, [=](const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
+      dev_a(i,j,k,l) = ainit;
+      dev_b(i,j,k,l) = binit;
+      dev_c(i,j,k,l) = cinit;
+    });
+  });
+
+  report_memory_usage("first touch");
   printf("Starting benchmarking...\n");
 
   Kokkos::Timer timer;
 
   for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
     timer.reset();
-    perform_set(dev_c, 1.5);
+    perform_set(dev_c, 1.5, order, collapse);
     setTime = std::min(setTime, timer.seconds());
 
     timer.reset();
-    perform_copy(dev_a, dev_c);
+    perform_copy(dev_a, dev_c, order, collapse);
     copyTime = std::min(copyTime, timer.seconds());
 
     timer.reset();
-    perform_scale(dev_b, dev_c, scalar);
+    perform_scale(dev_b, dev_c, scalar, order, collapse);
     scaleTime = std::min(scaleTime, timer.seconds());
 
     timer.reset();
-    perform_add(dev_a, dev_b, dev_c);
+    perform_add(dev_a, dev_b, dev_c, order, collapse);
     addTime = std::min(addTime, timer.seconds());
 
     timer.reset();
-    perform_triad(dev_a, dev_b, dev_c, scalar);
+    perform_triad(dev_a, dev_b, dev_c, scalar, order, collapse);
     triadTime = std::min(triadTime, timer.seconds());
   }
 
+  report_memory_usage("kernels");
   Kokkos::deep_copy(a, dev_a);
   Kokkos::deep_copy(b, dev_b);
   Kokkos::deep_copy(c, dev_c);
 
   printf("Performing validation...\n");
   int rc = perform_validation(a, b, c, stream_array_size, scalar);
+  report_memory_usage("validation");
 
   printf(HLINE);
 
@@ -426,6 +590,18 @@ int run_benchmark(const StreamIndex stream_array_size) {
 
   printf(HLINE);
 
+  if (order_sweep) {
+    // runs after validation, the views are overwritten
+    perform_loop_order_sweep(dev_a, dev_b, dev_c, scalar);
+    printf(HLINE);
+  }
+
+  if (schedule_sweep) {
+    // runs last, the schedule is not restored
+    perform_schedule_sweep(dev_a, dev_b, dev_c, scalar, order, collapse);
+    printf(HLINE);
+  }
+
   return rc;
 }
 
@@ -436,10 +612,23 @@ int main(int argc, char *argv[]) {
 
   Kokkos::initialize(argc, argv);
   int rc;
+  bool large_index_test;
   StreamIndex stream_array_size;
-  rc = parse_args(argc, argv, stream_array_size);
-  if (rc == 0) {
-    rc = run_benchmark(stream_array_size);
+  int order;
+  int collapse;
+  bool order_sweep;
+  std::string schedule;
+  bool schedule_sweep;
+  rc = parse_args(argc, argv, stream_array_size, order, collapse, order_sweep, schedule,
+                  schedule_sweep,
+                  large_index_test);
+  if (rc == 0 && large_index_test) {
+    rc = perform_large_index_test(order, collapse, schedule);
+  } else if (rc == 0) {
+    report_thread_affinity();
+    printf(HLINE);
+    rc = run_benchmark(stream_array_size, order, collapse, order_sweep, schedule,
+                       schedule_sweep);
   } else if (rc == -2) {
     // Don't return error code when called with "-h"
     rc = 0;
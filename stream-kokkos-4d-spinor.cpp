@@ -0,0 +1,439 @@
+/*
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 3.0
+//       Copyright (2020) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// 1. Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the Corporation nor the names of the
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY NTESS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NTESS OR THE
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ************************************************************************
+//
+// Modifications by Simon Schlepphorst (Uni Bonn) and
+//                  Bartosz Kostrzewa (Uni Bonn) 
+//
+//@HEADER
+*/
+
+
+// STREAM kernels on 4D lattice fields with a per-site payload of 24 real
+// numbers, as real_t****[24] (spinor) and real_t****[12][2] (12 complex
+// components), each in AoS (LayoutRight) and SoA (LayoutLeft) arrangement,
+// as an AoSoA spinor real_t*[24][W] with W sites in the SIMD lanes, and as
+// a plain real_t**** field. The sites are iterated by an MDRangePolicy of
+// rank 4, the payload is unrolled at compile time (stream-site-fields.hpp).
+// Shows whether the tiling results of the scalar 4D benchmarks carry over
+// to realistic per-site payloads and what the lane-blocked layout gains.
+
+#include <Kokkos_Core.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <getopt.h>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <iostream>
+#include <limits>
+
+#include <sys/time.h>
+
+#include "stream-affinity.hpp"
+#include "stream-iterate.hpp"
+#include "stream-large-index.hpp"
+#include "stream-memory.hpp"
+#include "stream-site-fields.hpp"
+#include "stream-tiling.hpp"
+#include "stream-validation.hpp"
+
+#define STREAM_NTIMES 20
+using real_t = double;
+
+#define HLINE "-------------------------------------------------------------\n"
+
+template <typename DataType, typename Layout>
+using StreamField = Kokkos::View<DataType, Layout, Kokkos::MemoryTraits<Kokkos::Restrict>>;
+
+using ScalarField   = StreamField<real_t ****, Kokkos::LayoutRight>;
+using SpinorAoS     = StreamField<real_t ****[24], Kokkos::LayoutRight>;
+using SpinorSoA     = StreamField<real_t ****[24], Kokkos::LayoutLeft>;
+using ComplexSpinorAoS = StreamField<real_t ****[12][2], Kokkos::LayoutRight>;
+using ComplexSpinorSoA = StreamField<real_t ****[12][2], Kokkos::LayoutLeft>;
+// [sites/W][24][W]
+using SpinorAoSoA   = StreamField<real_t *[24][simd_lanes], Kokkos::LayoutRight>;
+
+using StreamIndex = int;
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner>
+using Policy = Kokkos::MDRangePolicy<Kokkos::Rank<4, outer, inner>>;
+
+using StreamTiling = Kokkos::Array<std::size_t, 4>;
+
+constexpr real_t ainit = 1.0;
+constexpr real_t binit = 1.1;
+constexpr real_t cinit = 0.0;
+
+int parse_args(int argc, char **argv, StreamIndex &stream_array_size, StreamTiling &tiling,
+               IteratePattern &iterate, bool &iterate_matched) {
+  // Defaults
+  stream_array_size = 16;
+  tiling = StreamTiling{0, 0, 0, 0};
+  iterate = IteratePattern::Default;
+  iterate_matched = true;
+
+  const std::string help_string =
+      "  -n <N>, --nelements <N>\n"
+      "     Create stream fields containing <N>^4 sites, <N> must be a\n"
+      "     multiple of the SIMD width of the AoSoA field.\n"
+      "     Default: 16\n"
+      "  -t <T0>,<T1>,<T2>,<T3>, --tiling <T0>,<T1>,<T2>,<T3>\n"
+      "     Tiling of the site dimensions (0 lets Kokkos choose the tile\n"
+      "     extent).\n"
+      "     Default: the default tiling of the MDRangePolicy\n"
+      "  -I <P>, --iterate <P>\n"
+      "     MDRange iteration pattern <outer>,<inner> of all kernels, one of\n"
+      "     default, right,right, right,left, left,right and left,left.\n"
+      "     Default: right,right for AoS and left,left for SoA fields\n"
+      "  -h, --help\n"
+      "     Prints this message.\n"
+      "     Hint: use --kokkos-help to see command line options provided by "
+      "Kokkos.\n";
+
+  static struct option long_options[] = {
+      {"nelements", required_argument, NULL, 'n'},
+      {"tiling", required_argument, NULL, 't'},
+      {"iterate", required_argument, NULL, 'I'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0}};
+
+  int c;
+  int option_index = 0;
+  while ((c = getopt_long(argc, argv, "n:t:I:h", long_options, &option_index)) !=
+         -1)
+    switch (c) {
+      case 'n':
+        if (!parse_extent(optarg, stream_array_size) || stream_array_size % simd_lanes != 0) {
+          fprintf(stderr, "Error: '%s' is not a valid number of elements (a multiple of %d).\n",
+                  optarg, simd_lanes);
+          return -1;
+        }
+        break;
+      case 't':
+        if (!parse_tiling<4>(optarg, tiling)) {
+          fprintf(stderr, "Error: '%s' is not a valid tiling.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'I':
+        if (!parse_iterate_pattern(optarg, iterate)) {
+          fprintf(stderr, "Error: unknown iteration pattern '%s'.\n", optarg);
+          return -1;
+        }
+        iterate_matched = false;
+        break;
+      case 'h':
+        printf("%s", help_string.c_str());
+        return -2;
+        break;
+      case 0: break;
+      default:
+        printf("%s", help_string.c_str());
+        return -1;
+        break;
+    }
+  return 0;
+}
+
+// "AoS" if the payload of a site is contiguous, "SoA" if each component
+// is a contiguous field, "AoSoA" if the sites are interleaved
+template <typename V>
+const char *arrangement_name() {
+  if (site_components<V>() == 1) return "-";
+  if (is_aosoa_field<V>()) return "AoSoA";
+  return std::is_same_v<typename V::array_layout, Kokkos::LayoutLeft> ? "SoA" : "AoS";
+}
+
+// iteration pattern with the innermost loop over the stride-one site
+// dimension
+template <typename V>
+IteratePattern matched_pattern() {
+  return std::is_same_v<typename V::array_layout, Kokkos::LayoutLeft> ? IteratePattern::LeftLeft
+                                                                      : IteratePattern::RightRight;
+}
+
+// policy over the sites of an n^4 lattice, over the blocks of sites in the
+// last dimension for AoSoA fields
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, typename V>
+Policy<outer, inner> make_policy(const StreamIndex n, const StreamTiling &tiling) {
+  return Policy<outer, inner>({0, 0, 0, 0}, {n, n, n, n / site_lanes<V>()},
+                              {(StreamIndex)tiling[0], (StreamIndex)tiling[1],
+                               (StreamIndex)tiling[2], (StreamIndex)tiling[3]});
+}
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, typename V>
+void perform_set(const V a, const real_t scalar, const StreamIndex n,
+                 const StreamTiling &tiling) {
+  Kokkos::parallel_for(
+      "set",
+      make_policy<outer, inner, V>(n, tiling),
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
+        for_each_site_element<V>(n, i, j, k, l, [&](const auto... e) { a(e...) = scalar; });
+      });
+
+  Kokkos::fence();
+}
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, typename V>
+void perform_copy(const V a, const V b, const StreamIndex n, const StreamTiling &tiling) {
+  Kokkos::parallel_for(
+      "copy",
+      make_policy<outer, inner, V>(n, tiling),
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
+        for_each_site_element<V>(n, i, j, k, l, [&](const auto... e) { b(e...) = a(e...); });
+      });
+
+  Kokkos::fence();
+}
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, typename V>
+void perform_scale(const V b, const V c, const real_t scalar, const StreamIndex n,
+                   const StreamTiling &tiling) {
+  Kokkos::parallel_for(
+      "scale",
+      make_policy<outer, inner, V>(n, tiling),
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
+        for_each_site_element<V>(n, i, j, k, l,
+                                 [&](const auto... e) { b(e...) = scalar * c(e...); });
+      });
+
+  Kokkos::fence();
+}
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, typename V>
+void perform_add(const V a, const V b, const V c, const StreamIndex n,
+                 const StreamTiling &tiling) {
+  Kokkos::parallel_for(
+      "add",
+      make_policy<outer, inner, V>(n, tiling),
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
+        for_each_site_element<V>(n, i, j, k, l,
+                                 [&](const auto... e) { c(e...) = a(e...) + b(e...); });
+      });
+
+  Kokkos::fence();
+}
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, typename V>
+void perform_triad(const V a, const V b, const V c, const real_t scalar, const StreamIndex n,
+                   const StreamTiling &tiling) {
+  Kokkos::parallel_for(
+      "triad",
+      make_policy<outer, inner, V>(n, tiling),
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
+        for_each_site_element<V>(n, i, j, k, l,
+                                 [&](const auto... e) { a(e...) = b(e...) + scalar * c(e...); });
+      });
+
+  Kokkos::fence();
+}
+
+// Compares all components of all sites to the expected values on the
+// device, returns the number of fields which failed the check.
+template <typename V>
+int perform_validation(const V &a, const V &b, const V &c, const real_t scalar) {
+  real_t ai = ainit;
+  real_t bi = binit;
+  real_t ci = cinit;
+
+  for (StreamIndex i = 0; i < STREAM_NTIMES; ++i) {
+    ci = ai;
+    bi = scalar * ci;
+    ci = ai + bi;
+    ai = bi + scalar * ci;
+  };
+
+  const double nelem = (double)a.size();
+  const double epsilon = 2*4*STREAM_NTIMES*std::numeric_limits<real_t>::epsilon();
+
+  const ValidationErrors errors = validate_on_device(a, b, c, ai, bi, ci, epsilon);
+
+  int errorCount = 0;
+  if (std::abs(errors.sum[0] / nelem / ai) > epsilon) errorCount++;
+  if (std::abs(errors.sum[1] / nelem / bi) > epsilon) errorCount++;
+  if (std::abs(errors.sum[2] / nelem / ci) > epsilon) errorCount++;
+  return errorCount;
+}
+
+// Runs all kernels on fields of type V and prints one row of the result
+// table.
+template <typename V, Kokkos::Iterate outer, Kokkos::Iterate inner>
+int run_case(const IteratePattern pattern, const StreamIndex n, const StreamTiling &tiling) {
+  auto dev_a = make_site_field<V>("a", n);
+  auto dev_b = make_site_field<V>("b", n);
+  auto dev_c = make_site_field<V>("c", n);
+
+  const double scalar = 1.1;
+
+  double setTime   = std::numeric_limits<double>::max();
+  double copyTime  = std::numeric_limits<double>::max();
+  double scaleTime = std::numeric_limits<double>::max();
+  double addTime   = std::numeric_limits<double>::max();
+  double triadTime = std::numeric_limits<double>::max();
+
+  // first touch with the same policy as the kernels
+  perform_set<outer, inner>(dev_a, ainit, n, tiling);
+  perform_set<outer, inner>(dev_b, binit, n, tiling);
+  perform_set<outer, inner>(dev_c, cinit, n, tiling);
+
+  Kokkos::Timer timer;
+
+  for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+    timer.reset();
+    perform_set<outer, inner>(dev_c, 1.5, n, tiling);
+    setTime = std::min(setTime, timer.seconds());
+
+    timer.reset();
+    perform_copy<outer, inner>(dev_a, dev_c, n, tiling);
+    copyTime = std::min(copyTime, timer.seconds());
+
+    timer.reset();
+    perform_scale<outer, inner>(dev_b, dev_c, scalar, n, tiling);
+    scaleTime = std::min(scaleTime, timer.seconds());
+
+    timer.reset();
+    perform_add<outer, inner>(dev_a, dev_b, dev_c, n, tiling);
+    addTime = std::min(addTime, timer.seconds());
+
+    timer.reset();
+    perform_triad<outer, inner>(dev_a, dev_b, dev_c, scalar, n, tiling);
+    triadTime = std::min(triadTime, timer.seconds());
+  }
+
+  const int rc = perform_validation(dev_a, dev_b, dev_c, scalar);
+
+  const double bytes = 1.0e-09 * (double)sizeof(real_t) * (double)dev_a.size();
+  printf("%-8s %-5s %-12s %10.4f %10.4f %10.4f %10.4f %10.4f  %s\n",
+         std::rank_v<typename V::data_type> == 0 ? "scalar" : site_payload_name<V>(),
+         arrangement_name<V>(), iterate_pattern_name(pattern), 1.0 * bytes / setTime,
+         2.0 * bytes / copyTime, 2.0 * bytes / scaleTime, 3.0 * bytes / addTime,
+         3.0 * bytes / triadTime, rc == 0 ? "ok" : "FAILED");
+  return rc;
+}
+
+template <typename V>
+int run_field(const StreamIndex n, const StreamTiling &tiling, const IteratePattern iterate,
+              const bool iterate_matched) {
+  const IteratePattern pattern = iterate_matched ? matched_pattern<V>() : iterate;
+  int rc = 0;
+  dispatch_iterate(pattern, [&](auto outer, auto inner) {
+    rc += run_case<V, decltype(outer)::value, decltype(inner)::value>(pattern, n, tiling);
+  });
+  return rc;
+}
+
+int run_benchmark(const StreamIndex stream_array_size, const StreamTiling &tiling,
+                  const IteratePattern iterate, const bool iterate_matched) {
+  printf("Reports fastest timing per kernel\n");
+  report_memory_usage("initialize");
+
+  const double nsites = (double)stream_array_size*
+                        (double)stream_array_size*
+                        (double)stream_array_size*
+                        (double)stream_array_size;
+  constexpr int ncomp = site_components<SpinorAoS>();
+
+  printf("Memory Sizes:\n");
+  printf("- Lattice Size:  %" PRIu64 "^4\n",
+         static_cast<uint64_t>(stream_array_size));
+  printf("- Per Site:      %12d B\n", ncomp * (int)sizeof(real_t));
+  printf("- Per Field:     %12.2f MB\n",
+         1.0e-6 * ncomp * nsites * (double)sizeof(real_t));
+  printf("- Total: %12.2f MB\n",
+         3.0e-6 * ncomp * nsites * (double)sizeof(real_t));
+
+  printf("Benchmark kernels will be performed for %d iterations.\n",
+         STREAM_NTIMES);
+  printf("Tiling: %s\n", tiling_to_string(tiling).c_str());
+  printf("AoSoA SIMD lanes: %d\n", simd_lanes);
+
+  printf(HLINE);
+
+  printf("%-8s %-5s %-12s %10s %10s %10s %10s %10s  %s\n", "payload", "", "outer,inner",
+         "Set", "Copy", "Scale", "Add", "Triad", "valid");
+  printf("%-8s %-5s %-12s %10s %10s %10s %10s %10s\n", "", "", "", "[Gbyte/s]",
+         "[Gbyte/s]", "[Gbyte/s]", "[Gbyte/s]", "[Gbyte/s]");
+
+  int rc = 0;
+  rc += run_field<ScalarField>(stream_array_size, tiling, iterate, iterate_matched);
+  rc += run_field<SpinorAoS>(stream_array_size, tiling, iterate, iterate_matched);
+  rc += run_field<SpinorSoA>(stream_array_size, tiling, iterate, iterate_matched);
+  rc += run_field<SpinorAoSoA>(stream_array_size, tiling, iterate, iterate_matched);
+  rc += run_field<ComplexSpinorAoS>(stream_array_size, tiling, iterate, iterate_matched);
+  rc += run_field<ComplexSpinorSoA>(stream_array_size, tiling, iterate, iterate_matched);
+
+  report_memory_usage("benchmark");
+
+  printf(HLINE);
+
+  if (rc != 0) {
+    fprintf(stderr, "Error: validation check failed for %d fields.\n", rc);
+  } else {
+    printf("All solutions checked and verified.\n");
+  }
+
+  return rc;
+}
+
+int main(int argc, char *argv[]) {
+  printf(HLINE);
+  printf("Kokkos 4D MDRangePolicy spinor field STREAM Benchmark\n");
+  printf(HLINE);
+
+  Kokkos::initialize(argc, argv);
+  int rc;
+  StreamIndex stream_array_size;
+  StreamTiling tiling;
+  IteratePattern iterate;
+  bool iterate_matched;
+  rc = parse_args(argc, argv, stream_array_size, tiling, iterate, iterate_matched);
+  if (rc == 0) {
+    report_thread_affinity();
+    printf(HLINE);
+    rc = run_benchmark(stream_array_size, tiling, iterate, iterate_matched);
+  } else if (rc == -2) {
+    // Don't return error code when called with "-h"
+    rc = 0;
+  }
+  Kokkos::finalize();
+
+  return rc;
+}
@@ -0,0 +1,440 @@
+/*
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 3.0
+//       Copyright (2020) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// 1. Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the Corporation nor the names of the
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY NTESS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NTESS OR THE
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ************************************************************************
+//
+// Modifications by Simon Schlepphorst (Uni Bonn) and
+//                  Bartosz Kostrzewa (Uni Bonn) 
+//
+//@HEADER
+*/
+
+
+// SU(3) matrix times vector on every site of a 4D lattice,
+//
+//   w(x) = U(x) v(x),  U(x) a complex 3x3 matrix, v(x), w(x) complex 3-vectors,
+//
+// with Kokkos::complex<double> and the links and vectors in AoS
+// (LayoutRight, the 9 or 3 complex numbers of a site are contiguous) and SoA
+// (LayoutLeft, one contiguous 4D field per component) arrangement. Each
+// site moves 240 bytes (192 read, 48 written) and performs 66 floating point
+// operations (9 complex multiplications and 6 complex additions), an
+// arithmetic intensity of 0.275 FLOP/byte compared to at most 0.083 for the
+// STREAM kernels. The kernel runs with an MDRangePolicy (same tiling and
+// iteration pattern options as the STREAM binaries) and with an OpenMP loop
+// nest with a simd innermost loop over the stride-one dimension as in
+// stream-kokkos-4d-openmp-simd, and reports GB/s and GFLOP/s.
+
+#include <Kokkos_Core.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <getopt.h>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <iostream>
+#include <limits>
+
+#include <sys/time.h>
+
+#include "stream-affinity.hpp"
+#include "stream-iterate.hpp"
+#include "stream-large-index.hpp"
+#include "stream-memory.hpp"
+#include "stream-tiling.hpp"
+#include "stream-validation.hpp"
+
+#define STREAM_NTIMES 20
+using real_t    = double;
+using complex_t = Kokkos::complex<real_t>;
+
+#define HLINE "-------------------------------------------------------------\n"
+
+template <typename Layout>
+using LinkField = Kokkos::View<complex_t ****[3][3], Layout, Kokkos::MemoryTraits<Kokkos::Restrict>>;
+template <typename Layout>
+using VectorField = Kokkos::View<complex_t ****[3], Layout, Kokkos::MemoryTraits<Kokkos::Restrict>>;
+
+using StreamIndex = int;
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner>
+using Policy = Kokkos::MDRangePolicy<Kokkos::Rank<4, outer, inner>>;
+
+using StreamTiling = Kokkos::Array<std::size_t, 4>;
+
+// per site: U, v and w, 15 complex numbers
+constexpr double bytes_per_site = 15.0 * sizeof(complex_t);
+// per site: 9 complex multiplications (6 FLOP) and 6 complex additions (2 FLOP)
+constexpr double flops_per_site = 9.0 * 6.0 + 6.0 * 2.0;
+
+// initial values, the same on all sites
+KOKKOS_INLINE_FUNCTION complex_t link_init(const int a, const int b) {
+  return complex_t(1.0 + 0.5 * a, 0.25 * b - 0.5);
+}
+KOKKOS_INLINE_FUNCTION complex_t vector_init(const int b) {
+  return complex_t(0.5 + 0.25 * b, 1.0 - 0.5 * b);
+}
+
+int parse_args(int argc, char **argv, StreamIndex &stream_array_size, StreamTiling &tiling,
+               IteratePattern &iterate, bool &iterate_matched) {
+  // Defaults
+  stream_array_size = 16;
+  tiling = StreamTiling{0, 0, 0, 0};
+  iterate = IteratePattern::Default;
+  iterate_matched = true;
+
+  const std::string help_string =
+      "  -n <N>, --nelements <N>\n"
+      "     Create link and vector fields containing <N>^4 sites.\n"
+      "     Default: 16\n"
+      "  -t <T0>,<T1>,<T2>,<T3>, --tiling <T0>,<T1>,<T2>,<T3>\n"
+      "     Tiling of the MDRangePolicy (0 lets Kokkos choose the tile\n"
+      "     extent).\n"
+      "     Default: the default tiling of the MDRangePolicy\n"
+      "  -I <P>, --iterate <P>\n"
+      "     MDRange iteration pattern <outer>,<inner>, one of default,\n"
+      "     right,right, right,left, left,right and left,left.\n"
+      "     Default: right,right for AoS and left,left for SoA fields\n"
+      "  -h, --help\n"
+      "     Prints this message.\n"
+      "     Hint: use --kokkos-help to see command line options provided by "
+      "Kokkos.\n";
+
+  static struct option long_options[] = {
+      {"nelements", required_argument, NULL, 'n'},
+      {"tiling", required_argument, NULL, 't'},
+      {"iterate", required_argument, NULL, 'I'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0}};
+
+  int c;
+  int option_index = 0;
+  while ((c = getopt_long(argc, argv, "n:t:I:h", long_options, &option_index)) !=
+         -1)
+    switch (c) {
+      case 'n':
+        if (!parse_extent(optarg, stream_array_size)) {
+          fprintf(stderr, "Error: '%s' is not a valid number of elements.\n", optarg);
+          return -1;
+        }
+        break;
+      case 't':
+        if (!parse_tiling<4>(optarg, tiling)) {
+          fprintf(stderr, "Error: '%s' is not a valid tiling.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'I':
+        if (!parse_iterate_pattern(optarg, iterate)) {
+          fprintf(stderr, "Error: unknown iteration pattern '%s'.\n", optarg);
+          return -1;
+        }
+        iterate_matched = false;
+        break;
+      case 'h':
+        printf("%s", help_string.c_str());
+        return -2;
+        break;
+      case 0: break;
+      default:
+        printf("%s", help_string.c_str());
+        return -1;
+        break;
+    }
+  return 0;
+}
+
+template <typename Layout>
+const char *arrangement_name() {
+  return std::is_same_v<Layout, Kokkos::LayoutLeft> ? "SoA" : "AoS";
+}
+
+// iteration pattern with the innermost loop over the stride-one site
+// dimension
+template <typename Layout>
+IteratePattern matched_pattern() {
+  return std::is_same_v<Layout, Kokkos::LayoutLeft> ? IteratePattern::LeftLeft
+                                                    : IteratePattern::RightRight;
+}
+
+template <typename Layout>
+KOKKOS_FORCEINLINE_FUNCTION void su3_mat_vec(const LinkField<Layout> &U,
+                                             const VectorField<Layout> &v,
+                                             const VectorField<Layout> &w, const StreamIndex i,
+                                             const StreamIndex j, const StreamIndex k,
+                                             const StreamIndex l) {
+  const complex_t v0 = v(i,j,k,l,0);
+  const complex_t v1 = v(i,j,k,l,1);
+  const complex_t v2 = v(i,j,k,l,2);
+  for (int a = 0; a < 3; ++a) {
+    w(i,j,k,l,a) = U(i,j,k,l,a,0) * v0 + U(i,j,k,l,a,1) * v1 + U(i,j,k,l,a,2) * v2;
+  }
+}
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner>
+Policy<outer, inner> make_policy(const StreamIndex n, const StreamTiling &tiling) {
+  return Policy<outer, inner>({0, 0, 0, 0}, {n, n, n, n},
+                              {(StreamIndex)tiling[0], (StreamIndex)tiling[1],
+                               (StreamIndex)tiling[2], (StreamIndex)tiling[3]});
+}
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, typename Layout>
+void perform_init(const LinkField<Layout> U, const VectorField<Layout> v,
+                  const VectorField<Layout> w, const StreamTiling &tiling) {
+  Kokkos::parallel_for(
+      "init_dev",
+      make_policy<outer, inner>(U.extent(0), tiling),
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l) {
+        for (int a = 0; a < 3; ++a) {
+          for (int b = 0; b < 3; ++b) U(i,j,k,l,a,b) = link_init(a, b);
+          v(i,j,k,l,a) = vector_init(a);
+          w(i,j,k,l,a) = complex_t(0.0, 0.0);
+        }
+      });
+
+  Kokkos::fence();
+}
+
+template <Kokkos::Iterate outer, Kokkos::Iterate inner, typename Layout>
+void perform_su3_mdrange(const LinkField<Layout> U, const VectorField<Layout> v,
+                         const VectorField<Layout> w, const StreamTiling &tiling) {
+  Kokkos::parallel_for(
+      "su3_mat_vec",
+      make_policy<outer, inner>(U.extent(0), tiling),
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l)
+      { su3_mat_vec(U, v, w, i, j, k, l); });
+
+  Kokkos::fence();
+}
+
+// OpenMP loop nest with the simd loop over the stride-one dimension, the
+// views have to be accessible from the host
+template <typename Layout>
+void perform_su3_openmp_simd(const LinkField<Layout> U, const VectorField<Layout> v,
+                             const VectorField<Layout> w) {
+  const StreamIndex N = U.extent(0);
+  if constexpr (std::is_same_v<Layout, Kokkos::LayoutLeft>) {
+#pragma omp parallel for collapse(3)
+    for(StreamIndex l = 0; l < N; ++l){
+      for(StreamIndex k = 0; k < N; ++k){
+        for(StreamIndex j = 0; j < N; ++j){
+#pragma omp simd
+          for(StreamIndex i = 0; i < N; ++i){
+            su3_mat_vec(U, v, w, i, j, k, l);
+          }
+        }
+      }
+    }
+  } else {
+#pragma omp parallel for collapse(3)
+    for(StreamIndex i = 0; i < N; ++i){
+      for(StreamIndex j = 0; j < N; ++j){
+        for(StreamIndex k = 0; k < N; ++k){
+#pragma omp simd
+          for(StreamIndex l = 0; l < N; ++l){
+            su3_mat_vec(U, v, w, i, j, k, l);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Returns the number of sites on which w differs from U v.
+template <typename Layout>
+int perform_validation(const VectorField<Layout> &w) {
+  Kokkos::Array<complex_t, 3> expected;
+  for (int a = 0; a < 3; ++a) {
+    expected[a] = complex_t(0.0, 0.0);
+    for (int b = 0; b < 3; ++b) expected[a] += link_init(a, b) * vector_init(b);
+  }
+  const real_t epsilon = 16 * std::numeric_limits<real_t>::epsilon();
+
+  const StreamIndex n = w.extent(0);
+  int errors          = 0;
+  Kokkos::parallel_reduce(
+      "validation",
+      Policy<Kokkos::Iterate::Default, Kokkos::Iterate::Default>({0, 0, 0, 0}, {n, n, n, n}),
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l,
+                    int &update) {
+        bool ok = true;
+        for (int a = 0; a < 3; ++a) {
+          const complex_t diff = w(i,j,k,l,a) - expected[a];
+          const real_t norm2   = expected[a].real() * expected[a].real() +
+                                 expected[a].imag() * expected[a].imag();
+          ok = ok && diff.real() * diff.real() + diff.imag() * diff.imag() <=
+                         epsilon * epsilon * norm2;
+        }
+        if (!ok) update += 1;
+      },
+      errors);
+  return errors;
+}
+
+void print_row(const char *arrangement, const char *variant, const char *pattern,
+               const double nsites, const double time, const int errors) {
+  printf("%-5s %-12s %-12s %10.4f %10.4f  %s\n", arrangement, variant, pattern,
+         1.0e-09 * bytes_per_site * nsites / time, 1.0e-09 * flops_per_site * nsites / time,
+         errors == 0 ? "ok" : "FAILED");
+}
+
+// Runs the MDRange and the OpenMP simd variant on fields with the given
+// layout, returns the number of failed variants.
+template <typename Layout, Kokkos::Iterate outer, Kokkos::Iterate inner>
+int run_case(const IteratePattern pattern, const StreamIndex n, const StreamTiling &tiling) {
+  const auto alloc = [](const char *label) {
+    return Kokkos::view_alloc(Kokkos::WithoutInitializing, label);
+  };
+  LinkField<Layout> U(alloc("U"), n, n, n, n);
+  VectorField<Layout> v(alloc("v"), n, n, n, n);
+  VectorField<Layout> w(alloc("w"), n, n, n, n);
+  const double nsites = (double)n * n * n * n;
+
+  // first touch with the same policy as the kernels
+  perform_init<outer, inner>(U, v, w, tiling);
+
+  int rc = 0;
+  Kokkos::Timer timer;
+  double time = std::numeric_limits<double>::max();
+  for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+    timer.reset();
+    perform_su3_mdrange<outer, inner>(U, v, w, tiling);
+    time = std::min(time, timer.seconds());
+  }
+  int errors = perform_validation(w);
+  print_row(arrangement_name<Layout>(), "mdrange", iterate_pattern_name(pattern), nsites, time,
+            errors);
+  rc += errors != 0;
+
+  if constexpr (views_in_host_memory<VectorField<Layout>>()) {
+    perform_init<outer, inner>(U, v, w, tiling);
+    time = std::numeric_limits<double>::max();
+    for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+      timer.reset();
+      perform_su3_openmp_simd(U, v, w);
+      time = std::min(time, timer.seconds());
+    }
+    errors = perform_validation(w);
+    print_row(arrangement_name<Layout>(), "openmp-simd", "-", nsites, time, errors);
+    rc += errors != 0;
+  }
+  return rc;
+}
+
+template <typename Layout>
+int run_layout(const StreamIndex n, const StreamTiling &tiling, const IteratePattern iterate,
+               const bool iterate_matched) {
+  const IteratePattern pattern = iterate_matched ? matched_pattern<Layout>() : iterate;
+  int rc = 0;
+  dispatch_iterate(pattern, [&](auto outer, auto inner) {
+    rc += run_case<Layout, decltype(outer)::value, decltype(inner)::value>(pattern, n, tiling);
+  });
+  return rc;
+}
+
+int run_benchmark(const StreamIndex stream_array_size, const StreamTiling &tiling,
+                  const IteratePattern iterate, const bool iterate_matched) {
+  printf("Reports fastest timing per kernel\n");
+  report_memory_usage("initialize");
+
+  const double nsites = (double)stream_array_size*
+                        (double)stream_array_size*
+                        (double)stream_array_size*
+                        (double)stream_array_size;
+
+  printf("Memory Sizes:\n");
+  printf("- Lattice Size:  %" PRIu64 "^4\n",
+         static_cast<uint64_t>(stream_array_size));
+  printf("- Links:         %12.2f MB\n", 1.0e-6 * 9.0 * nsites * (double)sizeof(complex_t));
+  printf("- Per Vector:    %12.2f MB\n", 1.0e-6 * 3.0 * nsites * (double)sizeof(complex_t));
+  printf("- Total: %12.2f MB\n", 1.0e-6 * bytes_per_site * nsites);
+  printf("Per site: %.0f bytes, %.0f FLOP, %.3f FLOP/byte\n", bytes_per_site, flops_per_site,
+         flops_per_site / bytes_per_site);
+
+  printf("Benchmark kernels will be performed for %d iterations.\n",
+         STREAM_NTIMES);
+  printf("Tiling: %s\n", tiling_to_string(tiling).c_str());
+
+  printf(HLINE);
+
+  printf("%-5s %-12s %-12s %10s %10s  %s\n", "links", "variant", "outer,inner", "U*v", "U*v",
+         "valid");
+  printf("%-5s %-12s %-12s %10s %10s\n", "", "", "", "[Gbyte/s]", "[GFLOP/s]");
+
+  int rc = 0;
+  rc += run_layout<Kokkos::LayoutRight>(stream_array_size, tiling, iterate, iterate_matched);
+  rc += run_layout<Kokkos::LayoutLeft>(stream_array_size, tiling, iterate, iterate_matched);
+
+  report_memory_usage("benchmark");
+
+  printf(HLINE);
+
+  if (rc != 0) {
+    fprintf(stderr, "Error: validation check failed for %d kernels.\n", rc);
+  } else {
+    printf("All solutions checked and verified.\n");
+  }
+
+  return rc;
+}
+
+int main(int argc, char *argv[]) {
+  printf(HLINE);
+  printf("Kokkos 4D SU(3) matrix-vector Benchmark\n");
+  printf(HLINE);
+
+  Kokkos::initialize(argc, argv);
+  int rc;
+  StreamIndex stream_array_size;
+  StreamTiling tiling;
+  IteratePattern iterate;
+  bool iterate_matched;
+  rc = parse_args(argc, argv, stream_array_size, tiling, iterate, iterate_matched);
+  if (rc == 0) {
+    report_thread_affinity();
+    printf(HLINE);
+    rc = run_benchmark(stream_array_size, tiling, iterate, iterate_matched);
+  } else if (rc == -2) {
+    // Don't return error code when called with "-h"
+    rc = 0;
+  }
+  Kokkos::finalize();
+
+  return rc;
+}
@@ -0,0 +1,525 @@
+/*
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 3.0
+//       Copyright (2020) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// 1. Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the Corporation nor the names of the
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY NTESS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NTESS OR THE
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ************************************************************************
+//
+// Modifications by Simon Schlepphorst (Uni Bonn) and
+//                  Bartosz Kostrzewa (Uni Bonn) 
+//
+//@HEADER
+*/
+
+#include <Kokkos_Core.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <getopt.h>
+#include <utility>
+#include <iostream>
+#include <limits>
+
+#include <sys/time.h>
+
+#include "stream-affinity.hpp"
+#include "stream-large-index.hpp"
+#include "stream-memory.hpp"
+#include "stream-team.hpp"
+#include "stream-validation.hpp"
+
+#define STREAM_NTIMES 20
+using real_t = double;
+
+#define HLINE "-------------------------------------------------------------\n"
+
+using StreamDeviceArray =
+    Kokkos::View<real_t *****, Kokkos::MemoryTraits<Kokkos::Restrict>>;
+#if defined(KOKKOS_ENABLE_CUDA)
+using constStreamDeviceArray =
+    Kokkos::View<const real_t *****, Kokkos::MemoryTraits<Kokkos::RandomAccess>>;
+#else
+using constStreamDeviceArray =
+    Kokkos::View<const real_t *****, Kokkos::MemoryTraits<Kokkos::Restrict>>;
+#endif
+using StreamIndex = int;
+
+template <int rank>
+using Policy      = Kokkos::MDRangePolicy<Kokkos::Rank<rank>>;
+
+using StreamExtents = Kokkos::Array<int, StreamDeviceArray::rank()>;
+
+template <std::size_t... Idcs>
+constexpr Kokkos::Array<std::size_t, sizeof...(Idcs)>
+make_repeated_sequence_impl(std::size_t value, std::integer_sequence<std::size_t, Idcs...>)
+{
+  return { ((void)Idcs, value)... };
+}
+
+template <std::size_t N>
+constexpr Kokkos::Array<std::size_t,N> make_repeated_sequence(std::size_t value)
+{
+  return make_repeated_sequence_impl(value, std::make_index_sequence<N>{});
+}
+
+template <typename V>
+StreamExtents extents_of(const V &view) {
+  StreamExtents n;
+  for (std::size_t d = 0; d < V::rank(); ++d) n[d] = view.extent(d);
+  return n;
+}
+
+constexpr real_t ainit = 1.0;
+constexpr real_t binit = 1.1;
+constexpr real_t cinit = 0.0;
+
+int parse_args(int argc, char **argv, StreamIndex &stream_array_size,
+               TeamMapping &mapping, TeamConfig &config, bool &compare) {
+  // Defaults
+  stream_array_size = 16;
+  mapping = TeamMapping::Thread;
+  config = TeamConfig();
+  compare = false;
+
+  const std::string help_string =
+      "  -n <N>, --nelements <N>\n"
+      "     Create stream views containing <N>^5 elements.\n"
+      "     Default: 16\n"
+      "  -m <M>, --mapping <M>\n"
+      "     Mapping of the dimensions to league, team threads and vector lanes,\n"
+      "     one of thread (i | j,k,l | m), teamvector (i | j,k,l,m)\n"
+      "     and threadvector (i | j,k | l,m).\n"
+      "     Default: thread\n"
+      "  -t <T>, --team-size <T>\n"
+      "     Team size, 0 for Kokkos::AUTO.\n"
+      "     Default: 0\n"
+      "  -v <V>, --vector-length <V>\n"
+      "     Vector length, 0 for Kokkos::AUTO.\n"
+      "     Default: 0\n"
+      "  -M, --compare\n"
+      "     After the benchmark, run all kernels with all three mappings and\n"
+      "     with the 5D MDRangePolicy and its default tiling.\n"
+      "  -h, --help\n"
+      "     Prints this message.\n"
+      "     Hint: use --kokkos-help to see command line options provided by "
+      "Kokkos.\n";
+
+  static struct option long_options[] = {
+      {"nelements", required_argument, NULL, 'n'},
+      {"mapping", required_argument, NULL, 'm'},
+      {"team-size", required_argument, NULL, 't'},
+      {"vector-length", required_argument, NULL, 'v'},
+      {"compare", no_argument, NULL, 'M'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0}};
+
+  int c;
+  int option_index = 0;
+  while ((c = getopt_long(argc, argv, "n:m:t:v:Mh", long_options, &option_index)) !=
+         -1)
+    switch (c) {
+      case 'n':
+        if (!parse_extent(optarg, stream_array_size)) {
+          fprintf(stderr, "Error: '%s' is not a valid number of elements.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'm':
+        if (!parse_team_mapping(optarg, mapping)) {
+          fprintf(stderr, "Error: '%s' is not a valid mapping.\n", optarg);
+          return -1;
+        }
+        break;
+      case 't':
+        if (!parse_int_in_range(optarg, 0, INT_MAX, config.team_size)) {
+          fprintf(stderr, "Error: '%s' is not a valid team size.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'v':
+        if (!parse_int_in_range(optarg, 0, INT_MAX, config.vector_length)) {
+          fprintf(stderr, "Error: '%s' is not a valid vector length.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'M': compare = true; break;
+      case 'h':
+        printf("%s", help_string.c_str());
+        return -2;
+        break;
+      case 0: break;
+      default:
+        printf("%s", help_string.c_str());
+        return -1;
+        break;
+    }
+  return 0;
+}
+
+void perform_set(const StreamDeviceArray a, const real_t scalar,
+                 const TeamMapping mapping, const TeamConfig &config) {
+  team_parallel_for(
+      "set", extents_of(a), mapping, config,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l, const StreamIndex m)
+      { a(i,j,k,l,m) = scalar; });
+}
+
+void perform_copy(const constStreamDeviceArray a, StreamDeviceArray b,
+                  const TeamMapping mapping, const TeamConfig &config) {
+  team_parallel_for(
+      "copy", extents_of(a), mapping, config,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l, const StreamIndex m)
+      { b(i,j,k,l,m) = a(i,j,k,l,m); });
+}
+
+void perform_scale(StreamDeviceArray b, const constStreamDeviceArray c,
+                   const real_t scalar, const TeamMapping mapping,
+                   const TeamConfig &config) {
+  team_parallel_for(
+      "scale", extents_of(b), mapping, config,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l, const StreamIndex m)
+      { b(i,j,k,l,m) = scalar * c(i,j,k,l,m); });
+}
+
+void perform_add(const constStreamDeviceArray a,
+                 const constStreamDeviceArray b, StreamDeviceArray c,
+                 const TeamMapping mapping, const TeamConfig &config) {
+  team_parallel_for(
+      "add", extents_of(a), mapping, config,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l, const StreamIndex m)
+      { c(i,j,k,l,m) = a(i,j,k,l,m) + b(i,j,k,l,m); });
+}
+
+void perform_triad(StreamDeviceArray a, const constStreamDeviceArray b,
+                   const constStreamDeviceArray c, const real_t scalar,
+                   const TeamMapping mapping, const TeamConfig &config) {
+  team_parallel_for(
+      "triad", extents_of(a), mapping, config,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l, const StreamIndex m)
+      { a(i,j,k,l,m) = b(i,j,k,l,m) + scalar * c(i,j,k,l,m); });
+}
+
+int perform_validation(const StreamDeviceArray &a, const StreamDeviceArray &b,
+                       const StreamDeviceArray &c, const StreamIndex arraySize,
+                       const real_t scalar) {
+  real_t ai = ainit;
+  real_t bi = binit;
+  real_t ci = cinit;
+
+  for (StreamIndex i = 0; i < STREAM_NTIMES; ++i) {
+    ci = ai;
+    bi = scalar * ci;
+    ci = ai + bi;
+    ai = bi + scalar * ci;
+  };
+
+  std::cout << "ai: " << ai << "\n";
+  std::cout << "a(0,0,0,0,0): " << first_element(a) << "\n";
+  std::cout << "bi: " << bi << "\n";
+  std::cout << "b(0,0,0,0,0): " << first_element(b) << "\n";
+  std::cout << "ci: " << ci << "\n";
+  std::cout << "c(0,0,0,0,0): " << first_element(c) << "\n";
+ 
+  const double nelem = (double)arraySize*arraySize*arraySize*arraySize*arraySize; 
+  const double epsilon = 2*4*STREAM_NTIMES*std::numeric_limits<real_t>::epsilon();
+
+  const ValidationErrors errors = validate_on_device(a, b, c, ai, bi, ci, epsilon);
+  const double aError = errors.sum[0];
+  const double bError = errors.sum[1];
+  const double cError = errors.sum[2];
+
+  std::cout << "aError = " << aError << "\n";
+  std::cout << "bError = " << bError << "\n";
+  std::cout << "cError = " << cError << "\n";
+
+  real_t aAvgError = aError / nelem;
+  real_t bAvgError = bError / nelem;
+  real_t cAvgError = cError / nelem;
+
+  std::cout << "aAvgErr = " << aAvgError << "\n";
+  std::cout << "bAvgError = " << bAvgError << "\n";
+  std::cout << "cAvgError = " << cAvgError << "\n";
+  std::cout << "aMaxErr = " << errors.max[0] << "\n";
+  std::cout << "bMaxErr = " << errors.max[1] << "\n";
+  std::cout << "cMaxErr = " << errors.max[2] << "\n";
+
+  int errorCount       = 0;
+
+  if (std::abs(aAvgError / ai) > epsilon) {
+    fprintf(stderr, "Error: validation check on View a failed.\n");
+    errorCount++;
+  }
+
+  if (std::abs(bAvgError / bi) > epsilon) {
+    fprintf(stderr, "Error: validation check on View b failed.\n");
+    errorCount++;
+  }
+
+  if (std::abs(cAvgError / ci) > epsilon) {
+    fprintf(stderr, "Error: validation check on View c failed.\n");
+    errorCount++;
+  }
+
+  if (errorCount == 0) {
+    printf("All solutions checked and verified.\n");
+  }
+
+  return errorCount;
+}
+
+// Times every kernel with all three mappings and the same team
+// configuration, and with the MDRangePolicy and its default tiling.
+void perform_mapping_comparison(StreamDeviceArray a, StreamDeviceArray b,
+                                StreamDeviceArray c, const real_t scalar,
+                                const TeamConfig &config) {
+  const double streams[] = {1.0, 2.0, 2.0, 3.0, 3.0};
+  const auto lower = make_repeated_sequence<a.rank()>(0);
+  const auto upper = make_repeated_sequence<a.rank()>(a.extent(0));
+  printf("Team mappings (%s) and MDRangePolicy:\n", team_config_string(config).c_str());
+  printf("%-13s %10s %10s %10s %10s %10s\n", "mapping", "Set", "Copy", "Scale", "Add",
+         "Triad");
+  printf("%-13s %10s %10s %10s %10s %10s\n", "", "[Gbyte/s]", "[Gbyte/s]", "[Gbyte/s]",
+         "[Gbyte/s]", "[Gbyte/s]");
+  const double bytes = 1.0e-9 * (double)sizeof(real_t) * (double)a.size();
+  const auto print_row = [&](const char *name, const double *times) {
+    printf("%-13s", name);
+    for (int n = 0; n < 5; ++n) printf(" %10.4f", streams[n] * bytes / times[n]);
+    printf("\n");
+  };
+  Kokkos::Timer timer;
+  for (const auto mapping : team_mappings) {
+    double times[5];
+    for (int n = 0; n < 5; ++n) times[n] = std::numeric_limits<double>::max();
+    for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+      timer.reset();
+      perform_set(c, 1.5, mapping, config);
+      times[0] = std::min(times[0], timer.seconds());
+      timer.reset();
+      perform_copy(a, c, mapping, config);
+      times[1] = std::min(times[1], timer.seconds());
+      timer.reset();
+      perform_scale(b, c, scalar, mapping, config);
+      times[2] = std::min(times[2], timer.seconds());
+      timer.reset();
+      perform_add(a, b, c, mapping, config);
+      times[3] = std::min(times[3], timer.seconds());
+      timer.reset();
+      perform_triad(a, b, c, scalar, mapping, config);
+      times[4] = std::min(times[4], timer.seconds());
+    }
+    print_row(team_mapping_name(mapping), times);
+  }
+
+  double times[5];
+  for (int n = 0; n < 5; ++n) times[n] = std::numeric_limits<double>::max();
+  for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+    timer.reset();
+    Kokkos::parallel_for("set", Policy<a.rank()>(lower, upper),
+                         KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l, const StreamIndex m) { c(i,j,k,l,m) = 1.5; });
+    Kokkos::fence();
+    times[0] = std::min(times[0], timer.seconds());
+    timer.reset();
+    Kokkos::parallel_for("copy", Policy<a.rank()>(lower, upper),
+                         KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l, const StreamIndex m) { c(i,j,k,l,m) = a(i,j,k,l,m); });
+    Kokkos::fence();
+    times[1] = std::min(times[1], timer.seconds());
+    timer.reset();
+    Kokkos::parallel_for("scale", Policy<a.rank()>(lower, upper),
+                         KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l, const StreamIndex m) { b(i,j,k,l,m) = scalar * c(i,j,k,l,m); });
+    Kokkos::fence();
+    times[2] = std::min(times[2], timer.seconds());
+    timer.reset();
+    Kokkos::parallel_for("add", Policy<a.rank()>(lower, upper),
+                         KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l, const StreamIndex m) { c(i,j,k,l,m) = a(i,j,k,l,m) + b(i,j,k,l,m); });
+    Kokkos::fence();
+    times[3] = std::min(times[3], timer.seconds());
+    timer.reset();
+    Kokkos::parallel_for("triad", Policy<a.rank()>(lower, upper),
+                         KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l, const StreamIndex m) { a(i,j,k,l,m) = b(i,j,k,l,m) + scalar * c(i,j,k,l,m); });
+    Kokkos::fence();
+    times[4] = std::min(times[4], timer.seconds());
+  }
+  print_row("MDRange", times);
+}
+
+int run_benchmark(const StreamIndex stream_array_size, const TeamMapping mapping,
+                  const TeamConfig &config, const bool compare) {
+  printf("Reports fastest timing per kernel\n");
+  report_memory_usage("initialize");
+  printf("Creating Views...\n");
+
+  const double nelem = (double)stream_array_size*
+                       (double)stream_array_size*
+                       (double)stream_array_size*
+                       (double)stream_array_size*
+                       (double)stream_array_size;
+
+  printf("Memory Sizes:\n");
+  printf("- Array Size:    %" PRIu64 "^5\n",
+         static_cast<uint64_t>(stream_array_size));
+  printf("- Per Array:     %12.2f MB\n",
+         1.0e-6 * nelem * (double)sizeof(real_t));
+  printf("- Total: %12.2f MB\n",
+         3.0e-6 * nelem * (double)sizeof(real_t));
+
+  printf("Benchmark kernels will be performed for %d iterations.\n",
+         STREAM_NTIMES);
+
+  printf("Team mapping:    %s (%s)\n", team_mapping_name(mapping),
+         team_mapping_layout(mapping, 5).c_str());
+  printf("Team config:     %s\n", team_config_string(config).c_str());
+
+  printf(HLINE);
+
+  // WithoutInitializing to circumvent first touch bug on arm systems
+  StreamDeviceArray dev_a(Kokkos::view_alloc(Kokkos::WithoutInitializing, "a"),
+                          stream_array_size,stream_array_size,stream_array_size,stream_array_size,stream_array_size);
+  StreamDeviceArray dev_b(Kokkos::view_alloc(Kokkos::WithoutInitializing, "b"),
+                          stream_array_size,stream_array_size,stream_array_size,stream_array_size,stream_array_size);
+  StreamDeviceArray dev_c(Kokkos::view_alloc(Kokkos::WithoutInitializing, "c"),
+                          stream_array_size,stream_array_size,stream_array_size,stream_array_size,stream_array_size);
+
+  const double scalar = 1.1;
+
+  double setTime   = std::numeric_limits<double>::max();
+  double copyTime  = std::numeric_limits<double>::max();
+  double scaleTime = std::numeric_limits<double>::max();
+  double addTime   = std::numeric_limits<double>::max();
+  double triadTime = std::numeric_limits<double>::max();
+
+  report_memory_usage("allocation");
+  printf("Initializing Views...\n");
+
+  // first touch with the same mapping as the kernels
+  team_parallel_for(
+      "init_dev", extents_of(dev_a), mapping, config,
+      KOKKOS_LAMBDA(const StreamIndex i, const StreamIndex j, const StreamIndex k, const StreamIndex l, const StreamIndex m) {
+        dev_a(i,j,k,l,m) = ainit;
+        dev_b(i,j,k,l,m) = binit;
+        dev_c(i,j,k,l,m) = cinit;
+      });
+
+  report_memory_usage("first touch");
+  printf("Starting benchmarking...\n");
+
+  Kokkos::Timer timer;
+
+  for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+    timer.reset();
+    perform_set(dev_c, 1.5, mapping, config);
+    setTime = std::min(setTime, timer.seconds());
+
+    timer.reset();
+    perform_copy(dev_a, dev_c, mapping, config);
+    copyTime = std::min(copyTime, timer.seconds());
+
+    timer.reset();
+    perform_scale(dev_b, dev_c, scalar, mapping, config);
+    scaleTime = std::min(scaleTime, timer.seconds());
+
+    timer.reset();
+    perform_add(dev_a, dev_b, dev_c, mapping, config);
+    addTime = std::min(addTime, timer.seconds());
+
+    timer.reset();
+    perform_triad(dev_a, dev_b, dev_c, scalar, mapping, config);
+    triadTime = std::min(triadTime, timer.seconds());
+  }
+
+  report_memory_usage("kernels");
+  printf("Performing validation...\n");
+  timer.reset();
+  int rc = perform_validation(dev_a, dev_b, dev_c, stream_array_size, scalar);
+  printf("Validation time: %.4f s\n", timer.seconds());
+  report_memory_usage("validation");
+
+  printf(HLINE);
+
+  printf("Set             %11.4f GB/s\n",
+         (1.0e-09 * 1.0 * (double)sizeof(real_t) * (double)dev_a.size()) /
+             setTime);
+  printf("Copy            %11.4f GB/s\n",
+         real_t(1.0e-09 * 2.0 * (double)sizeof(real_t) *
+                (double)dev_a.size()) /
+                copyTime);
+  printf("Scale           %11.4f GB/s\n",
+         real_t(1.0e-09 * 2.0 * (double)sizeof(real_t) *
+                (double)dev_a.size()) /
+                scaleTime);
+  printf("Add             %11.4f GB/s\n",
+         real_t(1.0e-09 * 3.0 * (double)sizeof(real_t) *
+                (double)dev_a.size()) /
+                addTime);
+  printf("Triad           %11.4f GB/s\n",
+         real_t(1.0e-09 * 3.0 * (double)sizeof(real_t) *
+                (double)dev_a.size()) /
+                triadTime);
+
+  printf(HLINE);
+
+  if (compare) {
+    // runs after validation, the views are overwritten
+    perform_mapping_comparison(dev_a, dev_b, dev_c, scalar, config);
+    printf(HLINE);
+  }
+
+  return rc;
+}
+
+int main(int argc, char *argv[]) {
+  printf(HLINE);
+  printf("Kokkos 5D TeamPolicy STREAM Benchmark\n");
+  printf(HLINE);
+
+  Kokkos::initialize(argc, argv);
+  int rc;
+  StreamIndex stream_array_size;
+  TeamMapping mapping;
+  TeamConfig config;
+  bool compare;
+  rc = parse_args(argc, argv, stream_array_size, mapping, config, compare);
+  if (rc == 0) {
+    report_thread_affinity();
+    printf(HLINE);
+    rc = run_benchmark(stream_array_size, mapping, config, compare);
+  } else if (rc == -2) {
+    // Don't return error code when called with "-h"
+    rc = 0;
+  }
+  Kokkos::finalize();
+
+  return rc;
+}
@@ -52,6 +52,13 @@
 
 #include <sys/time.h>
 
+#include "stream-affinity.hpp"
+#include "stream-extra-kernels.hpp"
+#include "stream-large-index.hpp"
+#include "stream-memory.hpp"
+#include "stream-roofline.hpp"
+#include "stream-validation.hpp"
+
 #define STREAM_NTIMES 20
 using real_t = double;
 
@@ -69,16 +76,87 @@ using constStreamDeviceArray =
 using StreamHostArray = typename StreamDeviceArray::HostMirror;
 
 using StreamIndex = long long int;
-using Policy      = Kokkos::RangePolicy<Kokkos::IndexType<StreamIndex>>;
 
-int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
+template <typename ScheduleType>
+using Policy = Kokkos::RangePolicy<Kokkos::Schedule<ScheduleType>,
+                                   Kokkos::IndexType<StreamIndex>>;
+
+// Schedule and chunk size of the RangePolicy, a chunk size of 0 keeps the
+// backend default.
+struct RangeSchedule {
+  bool dynamic = false;
+  int chunk    = 0;
+};
+
+std::string range_schedule_name(const RangeSchedule &s) {
+  return std::string(s.dynamic ? "Dynamic" : "Static") + ", chunk " +
+         (s.chunk > 0 ? std::to_string(s.chunk) : std::string("default"));
+}
+
+template <typename ScheduleType>
+Policy<ScheduleType> make_policy(const StreamIndex n, const int chunk) {
+  Policy<ScheduleType> policy(0, n);
+  if (chunk > 0) policy.set_chunk_size(chunk);
+  return policy;
+}
+
+template <typename F, typename... R>
+void range_parallel_reduce(const char *label, const StreamIndex n,
+                           const RangeSchedule &schedule, const F &f, R &&...results) {
+  if (schedule.dynamic) {
+    Kokkos::parallel_reduce(label, make_policy<Kokkos::Dynamic>(n, schedule.chunk), f,
+                            std::forward<R>(results)...);
+  } else {
+    Kokkos::parallel_reduce(label, make_policy<Kokkos::Static>(n, schedule.chunk), f,
+                            std::forward<R>(results)...);
+  }
+}
+
+template <typename F>
+void range_parallel_for(const char *label, const StreamIndex n,
+                        const RangeSchedule &schedule, const F &f) {
+  if (schedule.dynamic) {
+    Kokkos::parallel_for(label, make_policy<Kokkos::Dynamic>(n, schedule.chunk), f);
+  } else {
+    Kokkos::parallel_for(label, make_policy<Kokkos::Static>(n, schedule.chunk), f);
+  }
+}
+
+constexpr real_t ainit = 1.0;
+constexpr real_t binit = 2.0;
+constexpr real_t cinit = 0.0;
+
+int parse_args(int argc, char **argv, StreamIndex &stream_array_size,
+               RangeSchedule &schedule, bool &schedule_sweep,
+               bool &extra_kernels, MachineDescription &machine) {
   // Defaults
   stream_array_size = 1048576;
+  schedule = RangeSchedule();
+  schedule_sweep = false;
+  extra_kernels = false;
+  machine = MachineDescription();
 
   const std::string help_string =
       "  -n <N>, --nelements <N>\n"
       "     Create stream arrays containing <N> elements.\n"
       "     Default: 1<<20\n"
+      "  -s <S>, --schedule <S>\n"
+      "     RangePolicy schedule, static or dynamic.\n"
+      "     Default: static\n"
+      "  -k <K>, --chunk-size <K>\n"
+      "     RangePolicy chunk size, 0 for the backend default.\n"
+      "     Default: 0\n"
+      "  -S, --schedule-sweep\n"
+      "     After the benchmark, run all kernels with static and dynamic\n"
+      "     schedules and a range of chunk sizes, and report the fastest\n"
+      "     combination per kernel.\n"
+      "  -E, --extra-kernels\n"
+      "     After the benchmark, also run the Dot, Nstream and Sum+MaxNorm\n"
+      "     kernels (parallel_reduce) with the same schedule and validate them.\n"
+      "  -M <file>, --machine <file>\n"
+      "     Read the peak bandwidth, FLOP rate and cache sizes from the machine\n"
+      "     description <file> (see machines/) and report each kernel as a\n"
+      "     fraction of its roofline ceiling.\n"
       "  -h, --help\n"
       "     Prints this message.\n"
       "     Hint: use --kokkos-help to see command line options provided by "
@@ -86,15 +164,41 @@ int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
 
   static struct option long_options[] = {
       {"nelements", required_argument, NULL, 'n'},
+      {"schedule", required_argument, NULL, 's'},
+      {"chunk-size", required_argument, NULL, 'k'},
+      {"schedule-sweep", no_argument, NULL, 'S'},
+      {"extra-kernels", no_argument, NULL, 'E'},
+      {"machine", required_argument, NULL, 'M'},
       {"help", no_argument, NULL, 'h'},
       {NULL, 0, NULL, 0}};
 
   int c;
   int option_index = 0;
-  while ((c = getopt_long(argc, argv, "n:h", long_options, &option_index)) !=
+  while ((c = getopt_long(argc, argv, "n:s:k:SEM:h", long_options, &option_index)) !=
          -1)
     switch (c) {
       case 'n': stream_array_size = atoll(optarg); break;
+      case 's':
+        if (std::string(optarg) == "static") {
+          schedule.dynamic = false;
+        } else if (std::string(optarg) == "dynamic") {
+          schedule.dynamic = true;
+        } else {
+          fprintf(stderr, "Error: schedule must be static or dynamic.\n");
+          return -1;
+        }
+        break;
+      case 'k':
+        if (!parse_int_in_range(optarg, 0, INT_MAX, schedule.chunk)) {
+          fprintf(stderr, "Error: '%s' is not a valid chunk size.\n", optarg);
+          return -1;
+        }
+        break;
+      case 'S': schedule_sweep = true; break;
+      case 'E': extra_kernels = true; break;
+      case 'M':
+        if (!read_machine_description(optarg, machine)) return -1;
+        break;
       case 'h':
         printf("%s", help_string.c_str());
         return -2;
@@ -108,78 +212,116 @@ int parse_args(int argc, char **argv, StreamIndex &stream_array_size) {
   return 0;
 }
 
-void perform_set(StreamDeviceArray &a, const real_t scalar) {
-  Kokkos::parallel_for(
-      "set", Policy(0, a.extent(0)),
+void perform_set(StreamDeviceArray &a, const real_t scalar,
+                 const RangeSchedule &schedule) {
+  range_parallel_for(
+      "set", a.extent(0), schedule,
       KOKKOS_LAMBDA(const StreamIndex i) { a[i] = scalar; });
 
   Kokkos::fence();
 }
 
-void perform_copy(const constStreamDeviceArray &a, StreamDeviceArray &b) {
-  Kokkos::parallel_for(
-      "copy", Policy(0, a.extent(0)),
+void perform_copy(const constStreamDeviceArray &a, StreamDeviceArray &b,
+                  const RangeSchedule &schedule) {
+  range_parallel_for(
+      "copy", a.extent(0), schedule,
       KOKKOS_LAMBDA(const StreamIndex i) { b[i] = a[i]; });
 
   Kokkos::fence();
 }
 
 void perform_scale(StreamDeviceArray &b, const constStreamDeviceArray &c,
-                   const real_t scalar) {
-  Kokkos::parallel_for(
-      "scale", Policy(0, b.extent(0)),
+                   const real_t scalar, const RangeSchedule &schedule) {
+  range_parallel_for(
+      "scale", b.extent(0), schedule,
       KOKKOS_LAMBDA(const StreamIndex i) { b[i] = scalar * c[i]; });
 
   Kokkos::fence();
 }
 
 void perform_add(const constStreamDeviceArray &a,
-                 const constStreamDeviceArray &b, StreamDeviceArray &c) {
-  Kokkos::parallel_for(
-      "add", Policy(0, a.extent(0)),
+                 const constStreamDeviceArray &b, StreamDeviceArray &c,
+                 const RangeSchedule &schedule) {
+  range_parallel_for(
+      "add", a.extent(0), schedule,
       KOKKOS_LAMBDA(const StreamIndex i) { c[i] = a[i] + b[i]; });
 
   Kokkos::fence();
 }
 
 void perform_triad(StreamDeviceArray &a, const constStreamDeviceArray &b,
-                   const constStreamDeviceArray &c, const real_t scalar) {
-  Kokkos::parallel_for(
-      "triad", Policy(0, a.extent(0)),
+                   const constStreamDeviceArray &c, const real_t scalar,
+                   const RangeSchedule &schedule) {
+  range_parallel_for(
+      "triad", a.extent(0), schedule,
       KOKKOS_LAMBDA(const StreamIndex i) { a[i] = b[i] + scalar * c[i]; });
 
   Kokkos::fence();
 }
 
-int perform_validation(StreamHostArray &a, StreamHostArray &b,
-                       StreamHostArray &c, const StreamIndex arraySize,
+real_t perform_dot(const constStreamDeviceArray &a, const constStreamDeviceArray &b,
+                   const RangeSchedule &schedule) {
+  real_t sum = 0.0;
+  range_parallel_reduce(
+      "dot", a.extent(0), schedule,
+      KOKKOS_LAMBDA(const StreamIndex i, real_t &update) { update += a[i] * b[i]; }, sum);
+
+  Kokkos::fence();
+  return sum;
+}
+
+void perform_nstream(StreamDeviceArray &a, const constStreamDeviceArray &b,
+                     const constStreamDeviceArray &c, const real_t scalar,
+                     const RangeSchedule &schedule) {
+  range_parallel_for(
+      "nstream", a.extent(0), schedule,
+      KOKKOS_LAMBDA(const StreamIndex i) { a[i] += b[i] + scalar * c[i]; });
+
+  Kokkos::fence();
+}
+
+// sum and maximum norm of a in one pass
+void perform_sum_max_norm(const constStreamDeviceArray &a, const RangeSchedule &schedule,
+                          real_t &sum, real_t &max_norm) {
+  range_parallel_reduce(
+      "sum_max_norm", a.extent(0), schedule,
+      KOKKOS_LAMBDA(const StreamIndex i, real_t &update_sum, real_t &update_max) {
+        const real_t norm = a[i] < 0 ? -a[i] : a[i];
+        update_sum += a[i];
+        update_max = norm > update_max ? norm : update_max;
+      },
+      sum, Kokkos::Max<real_t>(max_norm));
+
+  Kokkos::fence();
+}
+
+int perform_validation(const StreamDeviceArray &a, const StreamDeviceArray &b,
+                       const StreamDeviceArray &c, const StreamIndex arraySize,
                        const real_t scalar) {
-  real_t ai = 1.0;
-  real_t bi = 2.0;
-  real_t ci = 0.0;
+  real_t ai = ainit;
+  real_t bi = binit;
+  real_t ci = cinit;
 
-  for (StreamIndex i = 0; i < arraySize; ++i) {
+  for (StreamIndex i = 0; i < STREAM_NTIMES; ++i) {
     ci = ai;
     bi = scalar * ci;
     ci = ai + bi;
     ai = bi + scalar * ci;
   };
 
-  real_t aError = 0.0;
-  real_t bError = 0.0;
-  real_t cError = 0.0;
+  const real_t epsilon = 1.0e-13;
 
-  for (StreamIndex i = 0; i < arraySize; ++i) {
-    aError = std::abs(a[i] - ai);
-    bError = std::abs(b[i] - bi);
-    cError = std::abs(c[i] - ci);
-  }
+  const ValidationErrors errors = validate_on_device(a, b, c, ai, bi, ci, epsilon);
 
-  real_t aAvgError = aError / (real_t)arraySize;
-  real_t bAvgError = bError / (real_t)arraySize;
-  real_t cAvgError = cError / (real_t)arraySize;
+  printf("a[0]: %g (expected %g)\n", first_element(a), ai);
+  printf("aMaxErr = %g\n", errors.max[0]);
+  printf("bMaxErr = %g\n", errors.max[1]);
+  printf("cMaxErr = %g\n", errors.max[2]);
+
+  real_t aAvgError = errors.sum[0] / (real_t)arraySize;
+  real_t bAvgError = errors.sum[1] / (real_t)arraySize;
+  real_t cAvgError = errors.sum[2] / (real_t)arraySize;
 
-  const real_t epsilon = 1.0e-13;
   int errorCount       = 0;
 
   if (std::abs(aAvgError / ai) > epsilon) {
@@ -204,8 +346,107 @@ int perform_validation(StreamHostArray &a, StreamHostArray &b,
   return errorCount;
 }
 
-int run_benchmark(const StreamIndex stream_array_size) {
+// Times every kernel with static and dynamic schedules and a range of
+// chunk sizes, and reports the fastest combination per kernel.
+void perform_schedule_sweep(StreamDeviceArray &a, StreamDeviceArray &b,
+                            StreamDeviceArray &c, const real_t scalar) {
+  const char *names[] = {"Set", "Copy", "Scale", "Add", "Triad"};
+  const double streams[] = {1.0, 2.0, 2.0, 3.0, 3.0};
+  const int chunks[] = {0, 16, 64, 256, 1024, 4096, 16384, 65536};
+
+  printf("RangePolicy schedules on %s:\n", Kokkos::DefaultExecutionSpace::name());
+  printf("%-8s %8s %10s %10s %10s %10s %10s\n", "schedule", "chunk", "Set", "Copy",
+         "Scale", "Add", "Triad");
+  printf("%-8s %8s %10s %10s %10s %10s %10s\n", "", "", "[Gbyte/s]", "[Gbyte/s]",
+         "[Gbyte/s]", "[Gbyte/s]", "[Gbyte/s]");
+
+  const double bytes = 1.0e-9 * (double)sizeof(real_t) * (double)a.extent(0);
+  double peak[5] = {0.0, 0.0, 0.0, 0.0, 0.0};
+  double initial[5];
+  RangeSchedule best[5];
+  Kokkos::Timer timer;
+  for (const bool dynamic : {false, true}) {
+    for (const int chunk : chunks) {
+      const RangeSchedule schedule{dynamic, chunk};
+      double times[5];
+      for (int n = 0; n < 5; ++n) times[n] = std::numeric_limits<double>::max();
+      for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+        timer.reset();
+        perform_set(c, 1.5, schedule);
+        times[0] = std::min(times[0], timer.seconds());
+        timer.reset();
+        perform_copy(a, c, schedule);
+        times[1] = std::min(times[1], timer.seconds());
+        timer.reset();
+        perform_scale(b, c, scalar, schedule);
+        times[2] = std::min(times[2], timer.seconds());
+        timer.reset();
+        perform_add(a, b, c, schedule);
+        times[3] = std::min(times[3], timer.seconds());
+        timer.reset();
+        perform_triad(a, b, c, scalar, schedule);
+        times[4] = std::min(times[4], timer.seconds());
+      }
+      printf("%-8s %8s", dynamic ? "Dynamic" : "Static",
+             chunk > 0 ? std::to_string(chunk).c_str() : "default");
+      for (int n = 0; n < 5; ++n) {
+        const double bw = streams[n] * bytes / times[n];
+        printf(" %10.4f", bw);
+        // the first row is the default configuration
+        if (!dynamic && chunk == 0) initial[n] = bw;
+        if (bw > peak[n]) {
+          peak[n] = bw;
+          best[n] = schedule;
+        }
+      }
+      printf("\n");
+    }
+  }
+
+  printf("Fastest combination per kernel (default configuration in %% of it):\n");
+  for (int n = 0; n < 5; ++n) {
+    printf("- %-6s %-26s %6.1f %%\n", names[n], range_schedule_name(best[n]).c_str(),
+           100.0 * initial[n] / peak[n]);
+  }
+}
+
+// Times Dot, Nstream and Sum+MaxNorm (stream-extra-kernels.hpp) on freshly
+// initialised views and checks the results of the last iteration.
+int perform_extra_kernels(StreamDeviceArray &a, StreamDeviceArray &b, StreamDeviceArray &c,
+                          const real_t scalar, const RangeSchedule &schedule) {
+  perform_set(a, ainit, schedule);
+  perform_set(b, binit, schedule);
+  perform_set(c, extra_cinit, schedule);
+
+  double times[num_extra_kernels];
+  for (int n = 0; n < num_extra_kernels; ++n) times[n] = std::numeric_limits<double>::max();
+  ExtraKernelResults results;
+  Kokkos::Timer timer;
+  for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+    timer.reset();
+    results.dot = perform_dot(a, b, schedule);
+    times[0] = std::min(times[0], timer.seconds());
+
+    timer.reset();
+    perform_nstream(a, b, c, scalar, schedule);
+    times[1] = std::min(times[1], timer.seconds());
+
+    timer.reset();
+    perform_sum_max_norm(a, schedule, results.sum, results.max_norm);
+    times[2] = std::min(times[2], timer.seconds());
+  }
+
+  const int rc = check_extra_kernels(results, (double)a.extent(0), STREAM_NTIMES, ainit, binit,
+                                     extra_cinit, scalar);
+  print_extra_kernel_bandwidth(times, (double)sizeof(real_t) * (double)a.extent(0));
+  return rc;
+}
+
+int run_benchmark(const StreamIndex stream_array_size, const RangeSchedule &schedule,
+                  const bool schedule_sweep, const bool extra_kernels,
+                  const MachineDescription &machine) {
   printf("Reports fastest timing per kernel\n");
+  report_memory_usage("initialize");
   printf("Creating Views...\n");
 
   printf("Memory Sizes:\n");
@@ -215,10 +456,16 @@ int run_benchmark(const StreamIndex stream_array_size) {
          1.0e-6 * (double)stream_array_size * (double)sizeof(real_t));
   printf("- Total:         %12.2f MB\n",
          3.0e-6 * (double)stream_array_size * (double)sizeof(real_t));
+  printf("- Host Memory:   %12.2f MB (no host mirrors)\n",
+         views_in_host_memory<StreamDeviceArray>()
+             ? 3.0e-6 * (double)stream_array_size * (double)sizeof(real_t)
+             : 0.0);
 
   printf("Benchmark kernels will be performed for %d iterations.\n",
          STREAM_NTIMES);
 
+  printf("Schedule:        %s\n", range_schedule_name(schedule).c_str());
+
   printf(HLINE);
 
   // WithoutInitializing to circumvent first touch bug on arm systems
@@ -229,10 +476,6 @@ int run_benchmark(const StreamIndex stream_array_size) {
   StreamDeviceArray dev_c(Kokkos::view_alloc(Kokkos::WithoutInitializing, "c"),
                           stream_array_size);
 
-  StreamHostArray a = Kokkos::create_mirror_view(dev_a);
-  StreamHostArray b = Kokkos::create_mirror_view(dev_b);
-  StreamHostArray c = Kokkos::create_mirror_view(dev_c);
-
   const double scalar = 3.0;
 
   double setTime   = std::numeric_limits<double>::max();
@@ -241,55 +484,52 @@ int run_benchmark(const StreamIndex stream_array_size) {
   double addTime   = std::numeric_limits<double>::max();
   double triadTime = std::numeric_limits<double>::max();
 
+  report_memory_usage("allocation");
   printf("Initializing Views...\n");
 
   Kokkos::parallel_for(
       "init",
-      Kokkos::RangePolicy<Kokkos::DefaultHostExecutionSpace>(0,
-                                                             stream_array_size),
-      KOKKOS_LAMBDA(const int i) {
-        a[i] = 1.0;
-        b[i] = 2.0;
-        c[i] = 0.0;
+      Kokkos::RangePolicy<Kokkos::IndexType<StreamIndex>>(0, stream_array_size),
+      KOKKOS_LAMBDA(const StreamIndex i) {
+        dev_a[i] = ainit;
+        dev_b[i] = binit;
+        dev_c[i] = cinit;
       });
+  Kokkos::fence();
 
-  // Copy contents of a (from the host) to the dev_a (device)
-  Kokkos::deep_copy(dev_a, a);
-  Kokkos::deep_copy(dev_b, b);
-  Kokkos::deep_copy(dev_c, c);
-
+  report_memory_usage("first touch");
   printf("Starting benchmarking...\n");
 
   Kokkos::Timer timer;
 
   for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
     timer.reset();
-    perform_set(dev_c, 1.5);
+    perform_set(dev_c, 1.5, schedule);
     setTime = std::min(setTime, timer.seconds());
 
     timer.reset();
-    perform_copy(dev_a, dev_c);
+    perform_copy(dev_a, dev_c, schedule);
     copyTime = std::min(copyTime, timer.seconds());
 
     timer.reset();
-    perform_scale(dev_b, dev_c, scalar);
+    perform_scale(dev_b, dev_c, scalar, schedule);
     scaleTime = std::min(scaleTime, timer.seconds());
 
     timer.reset();
-    perform_add(dev_a, dev_b, dev_c);
+    perform_add(dev_a, dev_b, dev_c, schedule);
     addTime = std::min(addTime, timer.seconds());
 
     timer.reset();
-    perform_triad(dev_a, dev_b, dev_c, scalar);
+    perform_triad(dev_a, dev_b, dev_c, scalar, schedule);
     triadTime = std::min(triadTime, timer.seconds());
   }
 
-  Kokkos::deep_copy(a, dev_a);
-  Kokkos::deep_copy(b, dev_b);
-  Kokkos::deep_copy(c, dev_c);
-
+  report_memory_usage("kernels");
   printf("Performing validation...\n");
-  int rc = perform_validation(a, b, c, stream_array_size, scalar);
+  timer.reset();
+  int rc = perform_validation(dev_a, dev_b, dev_c, stream_array_size, scalar);
+  printf("Validation time: %.4f s\n", timer.seconds());
+  report_memory_usage("validation");
 
   printf(HLINE);
 
@@ -315,6 +555,24 @@ int run_benchmark(const StreamIndex stream_array_size) {
 
   printf(HLINE);
 
+  if (machine.valid()) {
+    const double times[5] = {setTime, copyTime, scaleTime, addTime, triadTime};
+    perform_stream_roofline(machine, dev_a, dev_b, dev_c, scalar, STREAM_NTIMES, times);
+    printf(HLINE);
+  }
+
+  if (extra_kernels) {
+    // runs after validation, the views are overwritten
+    rc += perform_extra_kernels(dev_a, dev_b, dev_c, scalar, schedule);
+    printf(HLINE);
+  }
+
+  if (schedule_sweep) {
+    // runs after validation, the views are overwritten
+    perform_schedule_sweep(dev_a, dev_b, dev_c, scalar);
+    printf(HLINE);
+  }
+
   return rc;
 }
 
@@ -326,9 +584,17 @@ int main(int argc, char *argv[]) {
   Kokkos::initialize(argc, argv);
   int rc;
   StreamIndex stream_array_size;
-  rc = parse_args(argc, argv, stream_array_size);
+  RangeSchedule schedule;
+  bool schedule_sweep;
+  bool extra_kernels;
+  MachineDescription machine;
+  rc = parse_args(argc, argv, stream_array_size, schedule, schedule_sweep,
+                  extra_kernels, machine);
   if (rc == 0) {
-    rc = run_benchmark(stream_array_size);
+    report_thread_affinity();
+    printf(HLINE);
+    rc = run_benchmark(stream_array_size, schedule, schedule_sweep, extra_kernels,
+                       machine);
   } else if (rc == -2) {
     // Don't return error code when called with "-h"
     rc = 0;
@@ -0,0 +1,412 @@
+/*
+//@HEADER
+// ************************************************************************
+//
+//                        Kokkos v. 3.0
+//       Copyright (2020) National Technology & Engineering
+//               Solutions of Sandia, LLC (NTESS).
+//
+// Under the terms of Contract DE-NA0003525 with NTESS,
+// the U.S. Government retains certain rights in this software.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are
+// met:
+//
+// 1. Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+//
+// 3. Neither the name of the Corporation nor the names of the
+// contributors may be used to endorse or promote products derived from
+// this software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY NTESS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+// PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL NTESS OR THE
+// CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+// EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+// PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+// NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+//
+// ************************************************************************
+//
+// Modifications by Simon Schlepphorst (Uni Bonn) and
+//                  Bartosz Kostrzewa (Uni Bonn) 
+//
+//@HEADER
+*/
+
+// STREAM kernels on 2D-5D LayoutRight views with fully dynamic, partially
+// static (trailing dimensions) and fully static extents for the sizes
+// compiled in (STREAM_STATIC_SIZES_<N>D, see stream-static-extents.hpp).
+// Shows the effect of compile-time strides on the index arithmetic and
+// vectorisation of the inner loops, measured as bandwidth.
+
+#include <Kokkos_Core.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <getopt.h>
+#include <string>
+#include <utility>
+#include <iostream>
+#include <limits>
+
+#include <sys/time.h>
+
+#include "stream-affinity.hpp"
+#include "stream-large-index.hpp"
+#include "stream-memory.hpp"
+#include "stream-static-extents.hpp"
+#include "stream-validation.hpp"
+
+#define STREAM_NTIMES 20
+using real_t = double;
+
+#define HLINE "-------------------------------------------------------------\n"
+
+template <int rank, int nstatic, std::size_t S>
+using StreamDeviceArray =
+    Kokkos::View<typename StaticExtentData<real_t, rank, nstatic, S>::type,
+                 Kokkos::MemoryTraits<Kokkos::Restrict>>;
+
+using StreamIndex = int;
+
+template <int rank>
+using Policy      = Kokkos::MDRangePolicy<Kokkos::Rank<rank>>;
+
+template <std::size_t... Idcs>
+constexpr Kokkos::Array<std::size_t, sizeof...(Idcs)>
+make_repeated_sequence_impl(std::size_t value, std::integer_sequence<std::size_t, Idcs...>)
+{
+  return { ((void)Idcs, value)... };
+}
+
+template <std::size_t N>
+constexpr Kokkos::Array<std::size_t,N> make_repeated_sequence(std::size_t value)
+{
+  return make_repeated_sequence_impl(value, std::make_index_sequence<N>{});
+}
+
+constexpr real_t ainit = 1.0;
+constexpr real_t binit = 1.1;
+constexpr real_t cinit = 0.0;
+
+int parse_args(int argc, char **argv, int &rank) {
+  // Defaults
+  rank = 0;
+
+  const std::string help_string =
+      "  -r <R>, --rank <R>\n"
+      "     Only run the views of rank <R> (2 to 5), 0 for all.\n"
+      "     Default: 0\n"
+      "  -h, --help\n"
+      "     Prints this message.\n"
+      "     Hint: use --kokkos-help to see command line options provided by "
+      "Kokkos.\n";
+
+  static struct option long_options[] = {
+      {"rank", required_argument, NULL, 'r'},
+      {"help", no_argument, NULL, 'h'},
+      {NULL, 0, NULL, 0}};
+
+  int c;
+  int option_index = 0;
+  while ((c = getopt_long(argc, argv, "r:h", long_options, &option_index)) !=
+         -1)
+    switch (c) {
+      case 'r':
+        if (!parse_int_in_range(optarg, 0, 5, rank) || rank == 1) {
+          fprintf(stderr, "Error: rank must be between 2 and 5.\n");
+          return -1;
+        }
+        break;
+      case 'h':
+        printf("%s", help_string.c_str());
+        return -2;
+        break;
+      case 0: break;
+      default:
+        printf("%s", help_string.c_str());
+        return -1;
+        break;
+    }
+  return 0;
+}
+
+// The kernels are functors with a variadic call operator, such that one
+// definition serves all ranks.
+
+template <typename V>
+struct SetFunctor {
+  V a;
+  real_t scalar;
+  template <typename... I>
+  KOKKOS_INLINE_FUNCTION void operator()(const I... i) const { a(i...) = scalar; }
+};
+
+template <typename V>
+struct CopyFunctor {
+  V a, b;
+  template <typename... I>
+  KOKKOS_INLINE_FUNCTION void operator()(const I... i) const { b(i...) = a(i...); }
+};
+
+template <typename V>
+struct ScaleFunctor {
+  V b, c;
+  real_t scalar;
+  template <typename... I>
+  KOKKOS_INLINE_FUNCTION void operator()(const I... i) const { b(i...) = scalar * c(i...); }
+};
+
+template <typename V>
+struct AddFunctor {
+  V a, b, c;
+  template <typename... I>
+  KOKKOS_INLINE_FUNCTION void operator()(const I... i) const { c(i...) = a(i...) + b(i...); }
+};
+
+template <typename V>
+struct TriadFunctor {
+  V a, b, c;
+  real_t scalar;
+  template <typename... I>
+  KOKKOS_INLINE_FUNCTION void operator()(const I... i) const { a(i...) = b(i...) + scalar * c(i...); }
+};
+
+template <typename V>
+struct InitFunctor {
+  V a, b, c;
+  template <typename... I>
+  KOKKOS_INLINE_FUNCTION void operator()(const I... i) const {
+    a(i...) = ainit;
+    b(i...) = binit;
+    c(i...) = cinit;
+  }
+};
+
+template <typename V>
+Policy<V::rank()> make_policy(const V &a) {
+  constexpr std::size_t rank = V::rank();
+  Kokkos::Array<std::size_t, rank> upper;
+  for (std::size_t d = 0; d < rank; ++d) upper[d] = a.extent(d);
+  return Policy<rank>(make_repeated_sequence<rank>(0), upper);
+}
+
+template <typename V>
+void perform_set(const V a, const real_t scalar) {
+  Kokkos::parallel_for("set", make_policy(a), SetFunctor<V>{a, scalar});
+
+  Kokkos::fence();
+}
+
+template <typename V>
+void perform_copy(const V a, const V b) {
+  Kokkos::parallel_for("copy", make_policy(a), CopyFunctor<V>{a, b});
+
+  Kokkos::fence();
+}
+
+template <typename V>
+void perform_scale(const V b, const V c, const real_t scalar) {
+  Kokkos::parallel_for("scale", make_policy(b), ScaleFunctor<V>{b, c, scalar});
+
+  Kokkos::fence();
+}
+
+template <typename V>
+void perform_add(const V a, const V b, const V c) {
+  Kokkos::parallel_for("add", make_policy(a), AddFunctor<V>{a, b, c});
+
+  Kokkos::fence();
+}
+
+template <typename V>
+void perform_triad(const V a, const V b, const V c, const real_t scalar) {
+  Kokkos::parallel_for("triad", make_policy(a), TriadFunctor<V>{a, b, c, scalar});
+
+  Kokkos::fence();
+}
+
+// Compares all elements to the expected values on the device, returns the
+// number of views which failed the check.
+template <typename V>
+int perform_validation(const V dev_a, const V dev_b, const V dev_c, const real_t scalar) {
+  real_t ai = ainit;
+  real_t bi = binit;
+  real_t ci = cinit;
+
+  for (StreamIndex i = 0; i < STREAM_NTIMES; ++i) {
+    ci = ai;
+    bi = scalar * ci;
+    ci = ai + bi;
+    ai = bi + scalar * ci;
+  };
+
+  const double nelem = (double)dev_a.size();
+  const double epsilon = 2*4*STREAM_NTIMES*std::numeric_limits<real_t>::epsilon();
+
+  const ValidationErrors errors = validate_on_device(dev_a, dev_b, dev_c, ai, bi, ci, epsilon);
+
+  int errorCount = 0;
+  if (std::abs(errors.sum[0] / nelem / ai) > epsilon) errorCount++;
+  if (std::abs(errors.sum[1] / nelem / bi) > epsilon) errorCount++;
+  if (std::abs(errors.sum[2] / nelem / ci) > epsilon) errorCount++;
+  return errorCount;
+}
+
+// Runs all kernels for one view type and prints one row of the result
+// table. 'triad_dynamic' is the Triad bandwidth of the dynamic views of the
+// same size, it is set if nstatic == 0.
+template <int rank, int nstatic, std::size_t S>
+int run_case(double &triad_dynamic) {
+  using V = StreamDeviceArray<rank, nstatic, S>;
+  auto dev_a = make_static_extent_view<V>("a", S);
+  auto dev_b = make_static_extent_view<V>("b", S);
+  auto dev_c = make_static_extent_view<V>("c", S);
+
+  const double scalar = 1.1;
+
+  double setTime   = std::numeric_limits<double>::max();
+  double copyTime  = std::numeric_limits<double>::max();
+  double scaleTime = std::numeric_limits<double>::max();
+  double addTime   = std::numeric_limits<double>::max();
+  double triadTime = std::numeric_limits<double>::max();
+
+  Kokkos::parallel_for("init_dev", make_policy(dev_a), InitFunctor<V>{dev_a, dev_b, dev_c});
+  Kokkos::fence();
+
+  Kokkos::Timer timer;
+
+  for (StreamIndex k = 0; k < STREAM_NTIMES; ++k) {
+    timer.reset();
+    perform_set(dev_c, 1.5);
+    setTime = std::min(setTime, timer.seconds());
+
+    timer.reset();
+    perform_copy(dev_a, dev_c);
+    copyTime = std::min(copyTime, timer.seconds());
+
+    timer.reset();
+    perform_scale(dev_b, dev_c, scalar);
+    scaleTime = std::min(scaleTime, timer.seconds());
+
+    timer.reset();
+    perform_add(dev_a, dev_b, dev_c);
+    addTime = std::min(addTime, timer.seconds());
+
+    timer.reset();
+    perform_triad(dev_a, dev_b, dev_c, scalar);
+    triadTime = std::min(triadTime, timer.seconds());
+  }
+
+  const int rc = perform_validation(dev_a, dev_b, dev_c, scalar);
+
+  const double bytes = 1.0e-09 * (double)sizeof(real_t) * (double)dev_a.size();
+  const double triad = 3.0 * bytes / triadTime;
+  if (nstatic == 0) triad_dynamic = triad;
+  printf("%5zu %-24s %d/%d %10.4f %10.4f %10.4f %10.4f %10.4f %8.3f  %s\n",
+         S, static_extent_name<rank, nstatic, S>("double").c_str(), static_strides(rank, nstatic),
+         rank, 1.0 * bytes / setTime, 2.0 * bytes / copyTime, 2.0 * bytes / scaleTime,
+         3.0 * bytes / addTime, triad, triad / triad_dynamic, rc == 0 ? "ok" : "FAILED");
+  return rc;
+}
+
+// dynamic, innermost static, all but the outermost static and all static
+template <int rank, std::size_t S>
+int run_size() {
+  double triad_dynamic = 0.0;
+  int rc = run_case<rank, 0, S>(triad_dynamic);
+  rc += run_case<rank, 1, S>(triad_dynamic);
+  if constexpr (rank > 2) rc += run_case<rank, rank - 1, S>(triad_dynamic);
+  rc += run_case<rank, rank, S>(triad_dynamic);
+  return rc;
+}
+
+template <int rank, std::size_t... S>
+int run_rank(std::index_sequence<S...>) {
+  int rc = 0;
+  ((rc += run_size<rank, S>()), ...);
+  return rc;
+}
+
+template <int rank, std::size_t... S>
+void print_sizes(std::index_sequence<S...>) {
+  printf("- %dD:", rank);
+  ((printf(" %zu^%d (%.2f MB)", S, rank,
+           1.0e-6 * std::pow((double)S, rank) * (double)sizeof(real_t))),
+   ...);
+  printf("\n");
+}
+
+int run_benchmark(const int rank) {
+  printf("Reports fastest timing per kernel\n");
+  report_memory_usage("initialize");
+
+  printf("Compiled sizes (per array):\n");
+  print_sizes<2>(typename StaticSizes<2>::type{});
+  print_sizes<3>(typename StaticSizes<3>::type{});
+  print_sizes<4>(typename StaticSizes<4>::type{});
+  print_sizes<5>(typename StaticSizes<5>::type{});
+
+  printf("Benchmark kernels will be performed for %d iterations.\n",
+         STREAM_NTIMES);
+
+  printf(HLINE);
+
+  printf("%5s %-24s %3s %10s %10s %10s %10s %10s %8s  %s\n", "N", "data type", "cts", "Set", "Copy",
+         "Scale", "Add", "Triad", "Triad", "valid");
+  printf("%5s %-24s %3s %10s %10s %10s %10s %10s %8s\n", "", "", "", "[Gbyte/s]", "[Gbyte/s]",
+         "[Gbyte/s]", "[Gbyte/s]", "[Gbyte/s]", "/dynamic");
+
+  int rc = 0;
+  if (rank == 0 || rank == 2) rc += run_rank<2>(typename StaticSizes<2>::type{});
+  if (rank == 0 || rank == 3) rc += run_rank<3>(typename StaticSizes<3>::type{});
+  if (rank == 0 || rank == 4) rc += run_rank<4>(typename StaticSizes<4>::type{});
+  if (rank == 0 || rank == 5) rc += run_rank<5>(typename StaticSizes<5>::type{});
+
+  printf("cts: strides known at compile time / rank\n");
+
+  report_memory_usage("benchmark");
+
+  printf(HLINE);
+
+  if (rc != 0) {
+    fprintf(stderr, "Error: validation check failed for %d views.\n", rc);
+  } else {
+    printf("All solutions checked and verified.\n");
+  }
+
+  return rc;
+}
+
+int main(int argc, char *argv[]) {
+  printf(HLINE);
+  printf("Kokkos static extent MDRangePolicy STREAM Benchmark\n");
+  printf(HLINE);
+
+  Kokkos::initialize(argc, argv);
+  int rc;
+  int rank;
+  rc = parse_args(argc, argv, rank);
+  if (rc == 0) {
+    report_thread_affinity();
+    printf(HLINE);
+    rc = run_benchmark(rank);
+  } else if (rc == -2) {
+    // Don't return error code when called with "-h"
+    rc = 0;
+  }
+  Kokkos::finalize();
+
+  return rc;
+}
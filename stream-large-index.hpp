@@ -0,0 +1,189 @@
+/*
+// Support for views with more than 2^31 elements.
+//
+// The per-dimension indices of the kernels (StreamIndex) stay 'int', the
+// extent of a single dimension never comes close to 2^31. Element counts,
+// offsets and loop counters over more than one dimension are StreamSize
+// (64 bit). parse_extent() replaces atoi() for the view extents and rejects
+// values which are not positive or do not fit into an int,
+// parse_int_in_range() does the same for other integer options.
+//
+// The large index test (-L) iterates over more than 2^32 points without
+// allocating any memory and checks that every point is visited exactly
+// once and that the 64 bit offsets sum(idx[d] * stride[d]) of the view
+// layout cover 0 ... N-1. large_index_test_mdrange() runs it with the
+// MDRangePolicy and each index type, the OpenMP binaries run it with their
+// own loop nests and check the LargeIndexResult of each thread.
+*/
+
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+#include <cerrno>
+#include <cinttypes>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+#include "stream-index-type.hpp"
+
+using StreamSize = std::int64_t;
+
+// returns false unless 'arg' is an integer in [lo, hi]
+inline bool parse_int_in_range(const char *arg, const int lo, const int hi, int &n) {
+  errno = 0;
+  char *end = nullptr;
+  const long long value = std::strtoll(arg, &end, 10);
+  if (errno != 0 || end == arg || *end != '\0' || value < lo || value > hi) return false;
+  n = static_cast<int>(value);
+  return true;
+}
+
+// returns false unless 'arg' is an integer in [1, INT_MAX]
+inline bool parse_extent(const char *arg, int &n) { return parse_int_in_range(arg, 1, INT_MAX, n); }
+
+// number of elements of a view with all 'rank' extents equal to n
+inline StreamSize total_elements(const int n, const int rank) {
+  StreamSize res = 1;
+  for (int d = 0; d < rank; ++d) res *= n;
+  return res;
+}
+
+// warns if the int32 index type is used for more than 2^31 points, the
+// policy then depends on the backend keeping its tile counts in range
+inline void warn_int32_index(const IndexWidth width, const StreamSize total) {
+  if (width == IndexWidth::Int32 && total > INT32_MAX) {
+    fprintf(stderr,
+            "Warning: %" PRId64 " elements per view exceed the int32 index range, "
+            "check the index type with -L.\n",
+            total);
+  }
+}
+
+// extent per dimension such that extent^rank is just above 2^32
+constexpr int large_index_extent(const int rank) {
+  return rank == 2 ? 65537 : rank == 3 ? 1626 : rank == 4 ? 257 : 85;
+}
+
+struct alignas(64) LargeIndexResult {
+  std::uint64_t count      = 0;   // visited points
+  std::uint64_t offset_sum = 0;   // sum of the offsets modulo 2^64
+  StreamSize offset_max    = -1;
+
+  void add(const StreamSize offset) {
+    count += 1;
+    offset_sum += static_cast<std::uint64_t>(offset);
+    offset_max = offset > offset_max ? offset : offset_max;
+  }
+  void join(const LargeIndexResult &other) {
+    count += other.count;
+    offset_sum += other.offset_sum;
+    offset_max = other.offset_max > offset_max ? other.offset_max : offset_max;
+  }
+};
+
+inline void print_large_index_header(const int n, const int rank) {
+  printf("Large index test: %d^%d = %" PRId64 " points, 2^31 = %" PRId64 "\n", n, rank,
+         total_elements(n, rank), static_cast<StreamSize>(INT32_MAX) + 1);
+  printf("%-10s %14s %14s %s\n", "index", "points", "max offset", "result");
+}
+
+// prints one row, returns 0 if 'r' visited 'total' points with the offsets
+// 0 ... total-1
+inline int check_large_index_result(const char *name, const StreamSize total,
+                                    const LargeIndexResult &r) {
+  const std::uint64_t n = static_cast<std::uint64_t>(total);
+  // n*(n-1)/2 modulo 2^64, halving the even factor first
+  const std::uint64_t expected_sum = n % 2 == 0 ? (n / 2) * (n - 1) : n * ((n - 1) / 2);
+  const bool ok = r.count == n && r.offset_sum == expected_sum && r.offset_max == total - 1;
+  printf("%-10s %14" PRIu64 " %14" PRId64 " %s\n", name, r.count, r.offset_max,
+         ok ? "passed" : "FAILED");
+  return ok ? 0 : 1;
+}
+
+namespace large_index_impl {
+
+template <typename V, std::size_t... I>
+V make_unmanaged(const int n, std::index_sequence<I...>) {
+  return V(static_cast<typename V::pointer_type>(nullptr), ((void)I, n)...);
+}
+
+template <std::size_t rank>
+struct OffsetFunctor {
+  Kokkos::Array<StreamSize, rank> stride;
+
+  KOKKOS_INLINE_FUNCTION void add(const StreamSize offset, std::uint64_t &count,
+                                  std::uint64_t &sum, StreamSize &max) const {
+    count += 1;
+    sum += static_cast<std::uint64_t>(offset);
+    max = offset > max ? offset : max;
+  }
+
+  KOKKOS_INLINE_FUNCTION void operator()(const StreamSize i, const StreamSize j,
+                                         std::uint64_t &count, std::uint64_t &sum,
+                                         StreamSize &max) const {
+    add(i * stride[0] + j * stride[1], count, sum, max);
+  }
+  KOKKOS_INLINE_FUNCTION void operator()(const StreamSize i, const StreamSize j,
+                                         const StreamSize k, std::uint64_t &count,
+                                         std::uint64_t &sum, StreamSize &max) const {
+    add(i * stride[0] + j * stride[1] + k * stride[2], count, sum, max);
+  }
+  KOKKOS_INLINE_FUNCTION void operator()(const StreamSize i, const StreamSize j,
+                                         const StreamSize k, const StreamSize l,
+                                         std::uint64_t &count, std::uint64_t &sum,
+                                         StreamSize &max) const {
+    add(i * stride[0] + j * stride[1] + k * stride[2] + l * stride[3], count, sum, max);
+  }
+  KOKKOS_INLINE_FUNCTION void operator()(const StreamSize i, const StreamSize j,
+                                         const StreamSize k, const StreamSize l,
+                                         const StreamSize m, std::uint64_t &count,
+                                         std::uint64_t &sum, StreamSize &max) const {
+    add(i * stride[0] + j * stride[1] + k * stride[2] + l * stride[3] + m * stride[4], count,
+        sum, max);
+  }
+};
+
+}  // namespace large_index_impl
+
+// strides of a view of type V with all extents n, without allocating it
+template <typename V>
+Kokkos::Array<StreamSize, V::rank()> large_index_strides(const int n) {
+  const V view =
+      large_index_impl::make_unmanaged<V>(n, std::make_index_sequence<V::rank()>{});
+  Kokkos::Array<StreamSize, V::rank()> res;
+  for (std::size_t d = 0; d < V::rank(); ++d) res[d] = view.stride(d);
+  return res;
+}
+
+// Runs the large index test with an MDRangePolicy of the rank of V for all
+// index types, returns the number of failures.
+template <typename V>
+int large_index_test_mdrange() {
+  constexpr std::size_t rank = V::rank();
+  const int n                = large_index_extent(rank);
+  const StreamSize total     = total_elements(n, rank);
+  Kokkos::Array<StreamSize, rank> lower, upper;
+  for (std::size_t d = 0; d < rank; ++d) {
+    lower[d] = 0;
+    upper[d] = n;
+  }
+  const large_index_impl::OffsetFunctor<rank> functor{large_index_strides<V>(n)};
+
+  print_large_index_header(n, rank);
+  int errors = 0;
+  for (const auto width : index_widths) {
+    LargeIndexResult r;
+    dispatch_index_type(width, [&](auto index) {
+      using Index = typename decltype(index)::type;
+      using P     = typename IndexedMDRangePolicy<Index, Kokkos::Rank<rank>>::type;
+      Kokkos::parallel_reduce("large_index_test", P(lower, upper), functor, r.count,
+                              r.offset_sum, Kokkos::Max<StreamSize>(r.offset_max));
+    });
+    errors += check_large_index_result(index_width_name(width), total, r);
+  }
+  return errors;
+}
@@ -0,0 +1,131 @@
+/*
+// Hand-written OpenMP 4D loop nests with runtime-selectable loop order and
+// collapse depth.
+//
+// LoopNest4<order, collapse_depth>::run(n, f) runs
+//
+//   #pragma omp parallel
+//   #pragma omp for collapse(collapse_depth) schedule(runtime) nowait
+//   for (x0 ...) for (x1 ...) for (x2 ...) for (x3 ...) f(i, j, k, l);
+//
+// where x0 is the outermost and x3 the innermost loop and loop_orders[order]
+// gives the dimension (0 = i, ..., 3 = l) each loop runs over. All 24 orders
+// and collapse depths 1-4 are instantiated, dispatch_loop_nest() selects
+// one at runtime. Order 0 ("ijkl") matches the memory order of LayoutRight.
+// The schedule is set with init_omp_schedule() from stream-omp-schedule.hpp,
+// run(n, f, busy) stores the time each thread spent in the loop in busy[].
+*/
+
+#pragma once
+
+#include <array>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "stream-omp-schedule.hpp"
+
+constexpr int num_loop_orders = 24;
+constexpr int max_loop_collapse = 4;
+
+// all permutations of {0,1,2,3} in lexicographic order
+constexpr std::array<std::array<int, 4>, num_loop_orders> make_loop_orders() {
+  std::array<std::array<int, 4>, num_loop_orders> res{};
+  int n = 0;
+  for (int a = 0; a < 4; ++a)
+    for (int b = 0; b < 4; ++b)
+      for (int c = 0; c < 4; ++c)
+        for (int d = 0; d < 4; ++d)
+          if (a != b && a != c && a != d && b != c && b != d && c != d) {
+            res[n][0] = a;
+            res[n][1] = b;
+            res[n][2] = c;
+            res[n][3] = d;
+            ++n;
+          }
+  return res;
+}
+
+constexpr auto loop_orders = make_loop_orders();
+
+// loop order as the index names from the outermost to the innermost loop
+inline std::string loop_order_name(const int order) {
+  std::string res;
+  for (int d = 0; d < 4; ++d) res += "ijkl"[loop_orders[order][d]];
+  return res;
+}
+
+// returns the index into loop_orders, or -1 if 'name' is not a permutation
+// of "ijkl"
+inline int parse_loop_order(const char *name) {
+  for (int o = 0; o < num_loop_orders; ++o) {
+    if (loop_order_name(o) == name) return o;
+  }
+  return -1;
+}
+
+// the collapse clause needs a literal constant in GCC, not a template
+// parameter, hence one copy of the loop nest per collapse depth
+#define STREAM_LOOP_NEST_4                      \
+  for (Index x0 = 0; x0 < n; ++x0) {            \
+    for (Index x1 = 0; x1 < n; ++x1) {          \
+      for (Index x2 = 0; x2 < n; ++x2) {        \
+        for (Index x3 = 0; x3 < n; ++x3) {      \
+          Index idx[4];                         \
+          idx[d0] = x0;                         \
+          idx[d1] = x1;                         \
+          idx[d2] = x2;                         \
+          idx[d3] = x3;                         \
+          f(idx[0], idx[1], idx[2], idx[3]);    \
+        }                                       \
+      }                                         \
+    }                                           \
+  }
+
+template <int order, int collapse_depth>
+struct LoopNest4 {
+  static constexpr int d0 = loop_orders[order][0];
+  static constexpr int d1 = loop_orders[order][1];
+  static constexpr int d2 = loop_orders[order][2];
+  static constexpr int d3 = loop_orders[order][3];
+
+  template <typename Index, typename F>
+  static void run(const Index n, const F &f, double *busy = nullptr) {
+#pragma omp parallel
+    {
+      const double start = omp_wall_time();
+      if constexpr (collapse_depth == 1) {
+#pragma omp for collapse(1) schedule(runtime) nowait
+        STREAM_LOOP_NEST_4
+      } else if constexpr (collapse_depth == 2) {
+#pragma omp for collapse(2) schedule(runtime) nowait
+        STREAM_LOOP_NEST_4
+      } else if constexpr (collapse_depth == 3) {
+#pragma omp for collapse(3) schedule(runtime) nowait
+        STREAM_LOOP_NEST_4
+      } else {
+#pragma omp for collapse(4) schedule(runtime) nowait
+        STREAM_LOOP_NEST_4
+      }
+      record_thread_busy(busy, start);
+    }
+  }
+};
+
+#undef STREAM_LOOP_NEST_4
+
+template <typename F, std::size_t... I>
+void dispatch_loop_nest_impl(const int id, F &&f, std::index_sequence<I...>) {
+  ((id == static_cast<int>(I)
+        ? f(LoopNest4<I / max_loop_collapse, I % max_loop_collapse + 1>{})
+        : void()),
+   ...);
+}
+
+// Calls f(nest) with the LoopNest4 instantiation for 'order' and 'collapse',
+// use decltype(nest)::run(n, body[, busy]) to execute the loop nest.
+template <typename F>
+void dispatch_loop_nest(const int order, const int collapse, F &&f) {
+  dispatch_loop_nest_impl(order * max_loop_collapse + collapse - 1, f,
+                          std::make_index_sequence<num_loop_orders * max_loop_collapse>{});
+}
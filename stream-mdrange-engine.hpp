@@ -0,0 +1,216 @@
+/*
+// A minimal MDRange-like execution engine with compile-time tile shapes.
+//
+// Kokkos::MDRangePolicy takes the tile extents at runtime, so the loops
+// inside a tile have runtime trip counts. Here the tile extents are template
+// parameters: for complete tiles all loop bounds are compile-time constants,
+// which lets the compiler fully unroll the outer tile loops and vectorise the
+// innermost one. Tiles cut by the iteration space boundary fall back to loops
+// with runtime bounds.
+//
+// In addition, the order in which tiles are visited and the way tiles are
+// assigned to threads can be chosen:
+//   TileOrder::Right        rightmost tile index runs fastest (Kokkos default
+//                           for LayoutRight)
+//   TileOrder::Left         leftmost tile index runs fastest
+//   TileAssignment::Blocks      thread t processes a contiguous block of tiles
+//   TileAssignment::RoundRobin  thread t processes tiles t, t+T, t+2T, ...
+//   TileAssignment::Interleaved thread t processes every T-th row of tiles,
+//                               where a row is the set of tiles along the
+//                               fastest-running tile index
+//
+// The innermost index within a tile is always the rightmost one, matching
+// LayoutRight views on the host. The engine runs on the host threads only.
+*/
+
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+enum class TileOrder { Right, Left };
+enum class TileAssignment { Blocks, RoundRobin, Interleaved };
+
+inline const char *tile_order_name(const TileOrder o) {
+  return o == TileOrder::Right ? "right" : "left";
+}
+
+inline const char *tile_assignment_name(const TileAssignment a) {
+  switch (a) {
+    case TileAssignment::Blocks: return "blocks";
+    case TileAssignment::RoundRobin: return "roundrobin";
+    default: return "interleaved";
+  }
+}
+
+// returns false if 'name' is not a valid tile order
+inline bool parse_tile_order(const char *name, TileOrder &o) {
+  if (std::strcmp(name, "right") == 0) o = TileOrder::Right;
+  else if (std::strcmp(name, "left") == 0) o = TileOrder::Left;
+  else return false;
+  return true;
+}
+
+// returns false if 'name' is not a valid tile assignment
+inline bool parse_tile_assignment(const char *name, TileAssignment &a) {
+  if (std::strcmp(name, "blocks") == 0) a = TileAssignment::Blocks;
+  else if (std::strcmp(name, "roundrobin") == 0) a = TileAssignment::RoundRobin;
+  else if (std::strcmp(name, "interleaved") == 0) a = TileAssignment::Interleaved;
+  else return false;
+  return true;
+}
+
+template <std::int64_t... Extents>
+struct TileShape {
+  static constexpr std::size_t rank = sizeof...(Extents);
+  static constexpr std::int64_t extents[rank] = {Extents...};
+  static constexpr std::int64_t volume = (Extents * ...);
+
+  static std::string to_string() {
+    std::string res = "[";
+    for (std::size_t d = 0; d < rank; ++d) {
+      res += std::to_string(extents[d]);
+      if (d < rank - 1) res += ",";
+    }
+    return res + "]";
+  }
+};
+
+namespace mdrange_engine_impl {
+
+// complete tile: all trip counts are compile-time constants
+template <typename Shape, std::size_t d, typename F, typename... Idx>
+KOKKOS_FORCEINLINE_FUNCTION void full_tile(const F &f, const std::int64_t *origin,
+                                           const Idx... idx) {
+  constexpr std::int64_t n = Shape::extents[d];
+  const std::int64_t o = origin[d];
+  if constexpr (d == Shape::rank - 1) {
+#pragma omp simd
+    for (std::int64_t i = 0; i < n; ++i) {
+      f(idx..., o + i);
+    }
+  } else {
+    for (std::int64_t i = 0; i < n; ++i) {
+      full_tile<Shape, d + 1>(f, origin, idx..., o + i);
+    }
+  }
+}
+
+// boundary tile: trip counts clipped at the upper bound
+template <typename Shape, std::size_t d, typename F, typename... Idx>
+KOKKOS_FORCEINLINE_FUNCTION void partial_tile(const F &f, const std::int64_t *origin,
+                                              const std::int64_t *upper, const Idx... idx) {
+  const std::int64_t o = origin[d];
+  const std::int64_t e = o + Shape::extents[d] < upper[d] ? o + Shape::extents[d] : upper[d];
+  if constexpr (d == Shape::rank - 1) {
+#pragma omp simd
+    for (std::int64_t i = o; i < e; ++i) {
+      f(idx..., i);
+    }
+  } else {
+    for (std::int64_t i = o; i < e; ++i) {
+      partial_tile<Shape, d + 1>(f, origin, upper, idx..., i);
+    }
+  }
+}
+
+}  // namespace mdrange_engine_impl
+
+template <typename Shape>
+class StaticTileMDRange {
+ public:
+  static constexpr std::size_t rank = Shape::rank;
+
+  template <typename T>
+  StaticTileMDRange(const Kokkos::Array<T, rank> &upper, const TileOrder order,
+                    const TileAssignment assignment)
+      : m_order(order), m_assignment(assignment) {
+    m_num_tiles = 1;
+    for (std::size_t d = 0; d < rank; ++d) {
+      m_upper[d] = static_cast<std::int64_t>(upper[d]);
+      m_tiles[d] = (m_upper[d] + Shape::extents[d] - 1) / Shape::extents[d];
+      m_num_tiles *= m_tiles[d];
+    }
+  }
+
+  std::int64_t num_tiles() const { return m_num_tiles; }
+
+  template <typename F>
+  void execute(const F &f) const {
+#if defined(_OPENMP)
+#pragma omp parallel
+    execute_thread(f, omp_get_thread_num(), omp_get_num_threads());
+#else
+    execute_thread(f, 0, 1);
+#endif
+  }
+
+ private:
+  // tiles along the fastest-running tile index
+  std::int64_t row_length() const {
+    return m_order == TileOrder::Right ? m_tiles[rank - 1] : m_tiles[0];
+  }
+
+  template <typename F>
+  void execute_thread(const F &f, const int tid, const int nthreads) const {
+    switch (m_assignment) {
+      case TileAssignment::Blocks: {
+        const std::int64_t begin = m_num_tiles * tid / nthreads;
+        const std::int64_t end = m_num_tiles * (tid + 1) / nthreads;
+        for (std::int64_t t = begin; t < end; ++t) execute_tile(f, t);
+        break;
+      }
+      case TileAssignment::RoundRobin: {
+        for (std::int64_t t = tid; t < m_num_tiles; t += nthreads) execute_tile(f, t);
+        break;
+      }
+      case TileAssignment::Interleaved: {
+        const std::int64_t len = row_length();
+        const std::int64_t rows = m_num_tiles / len;
+        for (std::int64_t r = tid; r < rows; r += nthreads) {
+          for (std::int64_t t = r * len; t < (r + 1) * len; ++t) execute_tile(f, t);
+        }
+        break;
+      }
+    }
+  }
+
+  template <typename F>
+  void execute_tile(const F &f, std::int64_t t) const {
+    std::int64_t origin[rank];
+    bool full = true;
+    for (std::size_t i = 0; i < rank; ++i) {
+      const std::size_t d = m_order == TileOrder::Right ? rank - 1 - i : i;
+      origin[d] = (t % m_tiles[d]) * Shape::extents[d];
+      t /= m_tiles[d];
+      full = full && (origin[d] + Shape::extents[d] <= m_upper[d]);
+    }
+    if (full) {
+      mdrange_engine_impl::full_tile<Shape, 0>(f, origin);
+    } else {
+      mdrange_engine_impl::partial_tile<Shape, 0>(f, origin, m_upper);
+    }
+  }
+
+  std::int64_t m_upper[rank];
+  std::int64_t m_tiles[rank];
+  std::int64_t m_num_tiles;
+  TileOrder m_order;
+  TileAssignment m_assignment;
+};
+
+// Kokkos-like entry point, 'f' is called with 'rank' indices on host threads.
+template <typename Shape, typename T, typename F>
+void engine_parallel_for(const std::string & /* label */,
+                         const Kokkos::Array<T, Shape::rank> &upper, const TileOrder order,
+                         const TileAssignment assignment, const F &f) {
+  StaticTileMDRange<Shape>(upper, order, assignment).execute(f);
+}
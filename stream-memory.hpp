@@ -0,0 +1,52 @@
+/*
+// Resident memory of the process per benchmark phase.
+//
+// report_memory_usage(phase) prints the resident set size (VmRSS), its
+// high-water mark (VmHWM) and the size of the page tables (VmPTE) from
+// /proc/self/status. Unlike the "Per Array" and "Total" sizes these include
+// host mirrors, Kokkos internal allocations, the OpenMP runtime and page
+// table overhead, which is what a node shared with other jobs has to
+// provide. Device memory is not included. Without /proc the values are
+// reported as unavailable.
+*/
+
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+struct MemoryUsage {
+  double rss_mb       = -1.0;
+  double peak_rss_mb  = -1.0;
+  double page_table_mb = -1.0;
+};
+
+inline MemoryUsage read_memory_usage() {
+  MemoryUsage res;
+  std::ifstream in("/proc/self/status");
+  std::string line;
+  while (std::getline(in, line)) {
+    // e.g. "VmRSS:     123456 kB"
+    const auto value = [&](const char *key) {
+      return 1.0e-3 * std::stod(line.substr(std::strlen(key)));
+    };
+    if (line.rfind("VmRSS:", 0) == 0) res.rss_mb = value("VmRSS:");
+    if (line.rfind("VmHWM:", 0) == 0) res.peak_rss_mb = value("VmHWM:");
+    if (line.rfind("VmPTE:", 0) == 0) res.page_table_mb = value("VmPTE:");
+  }
+  return res;
+}
+
+// prints e.g. "Memory after allocation:  RSS 12.34 MB, peak 12.34 MB, ..."
+inline void report_memory_usage(const char *phase) {
+  const MemoryUsage usage = read_memory_usage();
+  const std::string label = std::string(phase) + ":";
+  if (usage.rss_mb < 0.0) {
+    printf("Memory after %-12s unavailable\n", label.c_str());
+    return;
+  }
+  printf("Memory after %-12s RSS %12.2f MB, peak %12.2f MB, page tables %8.2f MB\n",
+         label.c_str(), usage.rss_mb, usage.peak_rss_mb, usage.page_table_mb);
+}
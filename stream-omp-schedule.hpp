@@ -0,0 +1,132 @@
+/*
+// OpenMP loop schedule selection and per-thread imbalance for the
+// hand-written OpenMP kernels.
+//
+// The kernels use schedule(runtime), so the schedule can be set with
+// OMP_SCHEDULE or with omp_set_schedule(). If neither is given, the
+// schedule is set to static without chunk size, which is what the loops
+// used before (the default for loops without schedule clause in GCC, Clang
+// and the Intel compilers).
+//
+// Every kernel opens the parallel region itself, runs its work-sharing
+// loop with nowait and records the time each thread spent in the loop,
+// such that the load imbalance (max / mean busy time) of a schedule can be
+// reported next to its bandwidth.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#if defined(_OPENMP)
+#include <omp.h>
+#endif
+
+struct OmpSchedule {
+  enum Kind { Static, Dynamic, Guided, Auto } kind = Static;
+  int chunk = 0;  // 0: implementation default
+};
+
+inline std::string omp_schedule_name(const OmpSchedule &s) {
+  const char *names[] = {"static", "dynamic", "guided", "auto"};
+  std::string res = names[s.kind];
+  if (s.chunk > 0) res += "," + std::to_string(s.chunk);
+  return res;
+}
+
+// parses "<kind>[,<chunk>]" as in OMP_SCHEDULE, returns false on error
+inline bool parse_omp_schedule(const char *str, OmpSchedule &s) {
+  const std::string v(str);
+  const auto comma = v.find(',');
+  const std::string kind = v.substr(0, comma);
+  if (kind == "static") s.kind = OmpSchedule::Static;
+  else if (kind == "dynamic") s.kind = OmpSchedule::Dynamic;
+  else if (kind == "guided") s.kind = OmpSchedule::Guided;
+  else if (kind == "auto") s.kind = OmpSchedule::Auto;
+  else return false;
+  s.chunk = comma == std::string::npos ? 0 : std::atoi(v.c_str() + comma + 1);
+  return s.chunk >= 0;
+}
+
+inline void set_omp_schedule(const OmpSchedule &s) {
+#if defined(_OPENMP)
+  const omp_sched_t kinds[] = {omp_sched_static, omp_sched_dynamic, omp_sched_guided,
+                               omp_sched_auto};
+  omp_set_schedule(kinds[s.kind], s.chunk);
+#else
+  (void)s;
+#endif
+}
+
+// Sets the schedule used by schedule(runtime): 'option' if given, else
+// OMP_SCHEDULE if set, else static. Returns false if 'option' is invalid.
+inline bool init_omp_schedule(const char *option) {
+  OmpSchedule s;
+  if (option != nullptr) {
+    if (!parse_omp_schedule(option, s)) return false;
+    set_omp_schedule(s);
+    printf("OpenMP schedule: %s\n", omp_schedule_name(s).c_str());
+  } else if (std::getenv("OMP_SCHEDULE") != nullptr) {
+    printf("OpenMP schedule: %s (OMP_SCHEDULE)\n", std::getenv("OMP_SCHEDULE"));
+  } else {
+    set_omp_schedule(s);
+    printf("OpenMP schedule: %s\n", omp_schedule_name(s).c_str());
+  }
+  return true;
+}
+
+// static, static,C, dynamic,C and guided,C for a few chunk sizes C
+inline std::vector<OmpSchedule> omp_schedule_sweep() {
+  std::vector<OmpSchedule> res;
+  res.push_back({OmpSchedule::Static, 0});
+  for (const int chunk : {1, 4, 16, 64, 256}) res.push_back({OmpSchedule::Static, chunk});
+  for (const int chunk : {1, 4, 16, 64, 256}) res.push_back({OmpSchedule::Dynamic, chunk});
+  for (const int chunk : {1, 4, 16, 64}) res.push_back({OmpSchedule::Guided, chunk});
+  return res;
+}
+
+inline double omp_wall_time() {
+#if defined(_OPENMP)
+  return omp_get_wtime();
+#else
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+inline int omp_thread_id() {
+#if defined(_OPENMP)
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+inline int omp_max_threads() {
+#if defined(_OPENMP)
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+// called by every thread after its nowait loop, 'busy' may be null
+inline void record_thread_busy(double *busy, const double start) {
+  if (busy != nullptr) busy[omp_thread_id()] = omp_wall_time() - start;
+}
+
+// max / mean of the per-thread busy times
+inline double thread_imbalance(const std::vector<double> &busy) {
+  double max = 0.0, sum = 0.0;
+  for (const double b : busy) {
+    max = std::max(max, b);
+    sum += b;
+  }
+  return sum > 0.0 ? max * busy.size() / sum : 0.0;
+}
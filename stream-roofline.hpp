@@ -0,0 +1,216 @@
+/*
+// Roofline report from a machine description file.
+//
+// The peak bandwidths used to be hard-coded per architecture in
+// run_scripts_and_results/plot_results.R. With -M <file> the binaries read
+// them from a machine description (see machines/), lines of the form
+//
+//   key = value   # comment
+//
+// with the keys
+//
+//   name                        label of the machine
+//   sockets                     sockets (1 for a GPU)
+//   cores_per_socket            cores (SMs, CUs) per socket
+//   peak_bandwidth_per_socket   memory bandwidth per socket [GB/s]
+//   peak_gflops_per_socket      double precision peak per socket [GFLOP/s]
+//   l1_cache_kib_per_core       L1 data cache per core [KiB]
+//   l2_cache_kib_per_core       L2 cache per core [KiB]
+//   l3_cache_mib_per_socket     L3 cache per socket [MiB]
+//
+// of which sockets and the two peaks are required. The ceilings apply to
+// the sockets the host threads run on (all sockets for device execution
+// spaces): a kernel with I FLOP per byte reaches at best
+// min(I * bandwidth, FLOP peak), and print_roofline_report() reports the
+// attained fraction of that ceiling and the efficiency relative to the
+// RangePolicy kernels of the same run. Kernels whose working set fits
+// into the last-level caches are marked, the memory ceiling does not bound
+// them.
+*/
+
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+
+#include "stream-affinity.hpp"
+#include "stream-flat-alias.hpp"
+#include "stream-validation.hpp"
+
+struct MachineDescription {
+  std::string name;
+  int sockets                      = 0;
+  int cores_per_socket             = 0;
+  double peak_bandwidth_per_socket = 0.0;  // GB/s
+  double peak_gflops_per_socket    = 0.0;  // GFLOP/s
+  double l1_cache_kib_per_core     = 0.0;
+  double l2_cache_kib_per_core     = 0.0;
+  double l3_cache_mib_per_socket   = 0.0;
+
+  bool valid() const {
+    return sockets > 0 && peak_bandwidth_per_socket > 0.0 && peak_gflops_per_socket > 0.0;
+  }
+
+  // aggregate size of the last-level caches of 'nsockets' sockets in
+  // bytes, 0 if unknown
+  double last_level_cache_bytes(const int nsockets) const {
+    if (l3_cache_mib_per_socket > 0.0) return nsockets * l3_cache_mib_per_socket * 1048576.0;
+    return nsockets * cores_per_socket * l2_cache_kib_per_core * 1024.0;
+  }
+};
+
+// Reads 'path' into 'machine', prints an error and returns false if the
+// file cannot be read, contains an unknown key or lacks a required one.
+inline bool read_machine_description(const char *path, MachineDescription &machine) {
+  std::ifstream in(path);
+  if (!in) {
+    fprintf(stderr, "Error: cannot read the machine description '%s'.\n", path);
+    return false;
+  }
+  machine = MachineDescription();
+  std::string line;
+  int lineno = 0;
+  while (std::getline(in, line)) {
+    ++lineno;
+    line = line.substr(0, line.find('#'));
+    const auto trim = [](const std::string &str) {
+      const auto first = str.find_first_not_of(" \t\r");
+      if (first == std::string::npos) return std::string();
+      return str.substr(first, str.find_last_not_of(" \t\r") - first + 1);
+    };
+    if (trim(line).empty()) continue;
+    const auto eq = line.find('=');
+    const std::string key   = trim(line.substr(0, eq));
+    const std::string value = eq == std::string::npos ? "" : trim(line.substr(eq + 1));
+    if (eq == std::string::npos || value.empty()) {
+      fprintf(stderr, "Error: %s:%d: expected 'key = value'.\n", path, lineno);
+      return false;
+    }
+    if (key == "name") {
+      machine.name = value;
+      continue;
+    }
+    errno = 0;
+    char *end = nullptr;
+    const double number = std::strtod(value.c_str(), &end);
+    if (errno != 0 || *end != '\0' || number < 0.0) {
+      fprintf(stderr, "Error: %s:%d: '%s' is not a valid value.\n", path, lineno, value.c_str());
+      return false;
+    }
+    if (key == "sockets") {
+      machine.sockets = static_cast<int>(number);
+    } else if (key == "cores_per_socket") {
+      machine.cores_per_socket = static_cast<int>(number);
+    } else if (key == "peak_bandwidth_per_socket") {
+      machine.peak_bandwidth_per_socket = number;
+    } else if (key == "peak_gflops_per_socket") {
+      machine.peak_gflops_per_socket = number;
+    } else if (key == "l1_cache_kib_per_core") {
+      machine.l1_cache_kib_per_core = number;
+    } else if (key == "l2_cache_kib_per_core") {
+      machine.l2_cache_kib_per_core = number;
+    } else if (key == "l3_cache_mib_per_socket") {
+      machine.l3_cache_mib_per_socket = number;
+    } else {
+      fprintf(stderr, "Error: %s:%d: unknown key '%s'.\n", path, lineno, key.c_str());
+      return false;
+    }
+  }
+  if (!machine.valid()) {
+    fprintf(stderr,
+            "Error: the machine description '%s' needs sockets, peak_bandwidth_per_socket "
+            "and peak_gflops_per_socket.\n",
+            path);
+    return false;
+  }
+  return true;
+}
+
+// sockets the ceilings apply to: those the host threads run on for views
+// in host memory, all sockets of the machine for devices
+template <typename V>
+int roofline_sockets(const MachineDescription &machine) {
+  if constexpr (views_in_host_memory<V>()) {
+    const int used = count_thread_sockets();
+    if (used > 0) return std::min(used, machine.sockets);
+  }
+  return machine.sockets;
+}
+
+struct RooflineKernel {
+  const char *name;
+  double bytes;       // memory traffic
+  double flops;       // floating point operations
+  double time;        // best time [s]
+  double range_time;  // best time of the RangePolicy kernel, <= 0 if not measured
+};
+
+inline void print_roofline_report(const MachineDescription &machine, const int nsockets,
+                                  const RooflineKernel *kernels, const int nkernels,
+                                  const double working_set_bytes) {
+  const double bandwidth = nsockets * machine.peak_bandwidth_per_socket;
+  const double gflops    = nsockets * machine.peak_gflops_per_socket;
+  const double llc       = machine.last_level_cache_bytes(nsockets);
+  printf("Roofline of %s on %d of %d sockets: %.1f Gbyte/s, %.1f GFLOP/s, ridge %.2f FLOP/byte\n",
+         machine.name.empty() ? "the machine" : machine.name.c_str(), nsockets, machine.sockets,
+         bandwidth, gflops, gflops / bandwidth);
+  const bool in_cache = llc > 0.0 && working_set_bytes <= llc;
+  if (in_cache) {
+    printf("The working set (%.2f MB) fits into the last-level caches (%.2f MB), the memory\n"
+           "ceiling does not bound these kernels.\n",
+           1.0e-6 * working_set_bytes, 1.0e-6 * llc);
+  }
+  printf("%-12s %10s %10s %10s %-8s %10s %10s\n", "kernel", "bandwidth", "flops",
+         "intensity", "bound", "roofline", "vs range");
+  printf("%-12s %10s %10s %10s %-8s %10s %10s\n", "", "[Gbyte/s]", "[GFLOP/s]", "[FLOP/B]", "",
+         "[%]", "[%]");
+  for (int n = 0; n < nkernels; ++n) {
+    const RooflineKernel &k  = kernels[n];
+    const double memory_time = 1.0e-9 * k.bytes / bandwidth;
+    const double flop_time   = 1.0e-9 * k.flops / gflops;
+    printf("%-12s %10.4f %10.4f %10.3f %-8s %10.1f", k.name, 1.0e-9 * k.bytes / k.time,
+           1.0e-9 * k.flops / k.time, k.flops / k.bytes,
+           flop_time > memory_time ? "compute" : in_cache ? "cache" : "memory",
+           100.0 * std::max(memory_time, flop_time) / k.time);
+    if (k.range_time > 0.0) {
+      printf(" %10.1f\n", 100.0 * k.range_time / k.time);
+    } else {
+      printf(" %10s\n", "n/a");
+    }
+  }
+}
+
+// the STREAM kernels: arrays read or written and FLOP per element
+constexpr const char *stream_kernel_names[5] = {"Set", "Copy", "Scale", "Add", "Triad"};
+constexpr double stream_kernel_streams[5]    = {1.0, 2.0, 2.0, 3.0, 3.0};
+constexpr double stream_kernel_flops[5]      = {0.0, 0.0, 1.0, 1.0, 2.0};
+
+// Roofline report of the STREAM kernels with the best 'times' (Set, Copy,
+// Scale, Add, Triad) of 'ntimes' iterations on the views a, b and c. Views of rank 1 were timed
+// with the RangePolicy already, for higher ranks the RangePolicy kernels
+// are timed on flat aliases of the views, which overwrites them.
+template <typename V>
+void perform_stream_roofline(const MachineDescription &machine, const V &a, const V &b,
+                             const V &c, const typename V::value_type scalar,
+                             const int ntimes, const double times[5]) {
+  double range_times[5] = {0.0, 0.0, 0.0, 0.0, 0.0};
+  if constexpr (V::rank() == 1) {
+    std::copy(times, times + 5, range_times);
+  } else if (flat_alias_is_safe(a) && flat_alias_is_safe(b) && flat_alias_is_safe(c)) {
+    time_flat_kernels(make_flat_alias(a), make_flat_alias(b), make_flat_alias(c), scalar,
+                      ntimes, range_times);
+  }
+  const double bytes = (double)sizeof(typename V::value_type) * (double)a.size();
+  RooflineKernel kernels[5];
+  for (int n = 0; n < 5; ++n) {
+    kernels[n] = {stream_kernel_names[n], stream_kernel_streams[n] * bytes,
+                  stream_kernel_flops[n] * (double)a.size(), times[n], range_times[n]};
+  }
+  print_roofline_report(machine, roofline_sockets<V>(machine), kernels, 5, 3.0 * bytes);
+}
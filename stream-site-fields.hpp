@@ -0,0 +1,149 @@
+/*
+// Fields with a compile-time payload per lattice site.
+//
+// A field is a view with four dynamic site dimensions followed by static
+// extents, e.g. real_t****[24] (spinor) or real_t****[12][2] (12 complex
+// components). With LayoutRight the payload of a site is contiguous (AoS),
+// with LayoutLeft each component is a contiguous 4D field (SoA). A plain
+// real_t**** view is a field with one component.
+//
+// An AoSoA field real_t*[ncomp][W] interleaves W consecutive sites of the
+// fastest site dimension into the lanes of a SIMD vector, the dynamic
+// dimension counts the blocks of W sites, [sites/W][ncomp][W] as in Grid.
+// W = simd_lanes matches the native vector width of the host.
+//
+// The kernels iterate over the sites (over the blocks of W sites for
+// AoSoA fields) with an MDRangePolicy of rank 4 and call
+// for_each_site_element(), which unrolls the components at compile time,
+// runs the lane loop of AoSoA fields as a SIMD loop and calls f with the
+// complete view indices of each element.
+*/
+
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+// native SIMD width in bytes of the host, can be set with
+// -DSTREAM_SIMD_BYTES=<bytes>
+#if !defined(STREAM_SIMD_BYTES)
+#if defined(__AVX512F__)
+#define STREAM_SIMD_BYTES 64
+#elif defined(__AVX__) || defined(__ARM_FEATURE_SVE)
+#define STREAM_SIMD_BYTES 32
+#else
+#define STREAM_SIMD_BYTES 16
+#endif
+#endif
+
+// sites per SIMD vector for 'double' fields
+constexpr int simd_lanes = STREAM_SIMD_BYTES / sizeof(double);
+
+// true for the AoSoA fields real_t*[ncomp][W]
+template <typename V>
+constexpr bool is_aosoa_field() {
+  using D = typename V::data_type;
+  return V::rank() - std::rank_v<D> == 1 && std::rank_v<D> == 2;
+}
+
+// number of sites interleaved per element of the dynamic dimension
+template <typename V>
+constexpr int site_lanes() {
+  if constexpr (is_aosoa_field<V>()) {
+    return std::extent_v<typename V::data_type, 1>;
+  } else {
+    return 1;
+  }
+}
+
+// number of real_t per site
+template <typename V>
+constexpr int site_components() {
+  using D = typename V::data_type;
+  if constexpr (is_aosoa_field<V>() || std::rank_v<D> == 1) {
+    return std::extent_v<D, 0>;
+  } else if constexpr (std::rank_v<D> == 0) {
+    return 1;
+  } else {
+    static_assert(std::rank_v<D> == 2, "at most two static extents per site");
+    return std::extent_v<D, 0> * std::extent_v<D, 1>;
+  }
+}
+
+// allocates a field of type V for n^4 sites, n must be a multiple of
+// site_lanes<V>()
+template <typename V>
+V make_site_field(const std::string &label, const int n) {
+  if constexpr (is_aosoa_field<V>()) {
+    const std::int64_t blocks = (std::int64_t)n * n * n * (n / site_lanes<V>());
+    return V(Kokkos::view_alloc(Kokkos::WithoutInitializing, label), blocks);
+  } else {
+    return V(Kokkos::view_alloc(Kokkos::WithoutInitializing, label), n, n, n, n);
+  }
+}
+
+namespace site_fields_impl {
+
+template <typename F, int... C>
+KOKKOS_FORCEINLINE_FUNCTION void unroll(const F &f, std::integer_sequence<int, C...>) {
+  (f(std::integral_constant<int, C>{}), ...);
+}
+
+}  // namespace site_fields_impl
+
+// f(std::integral_constant<int, c>{}) for c = 0 ... N-1
+template <int N, typename F>
+KOKKOS_FORCEINLINE_FUNCTION void unroll(const F &f) {
+  site_fields_impl::unroll(f, std::make_integer_sequence<int, N>{});
+}
+
+// Calls f(idx...) with the view indices of all elements of the site
+// (i,j,k,l) of a field of type V on an n^4 lattice, for AoSoA fields l
+// counts the blocks of site_lanes<V>() sites.
+template <typename V, typename I, typename F>
+KOKKOS_FORCEINLINE_FUNCTION void for_each_site_element(const I n, const I i, const I j,
+                                                       const I k, const I l, const F &f) {
+  using D = typename V::data_type;
+  if constexpr (is_aosoa_field<V>()) {
+    constexpr int lanes = site_lanes<V>();
+    const std::int64_t block = ((std::int64_t(i) * n + j) * n + k) * (n / lanes) + l;
+    unroll<site_components<V>()>([&](auto comp) {
+      constexpr int c = decltype(comp)::value;
+#pragma omp simd
+      for (int w = 0; w < lanes; ++w) f(block, c, w);
+    });
+  } else if constexpr (std::rank_v<D> == 0) {
+    f(i, j, k, l);
+  } else if constexpr (std::rank_v<D> == 1) {
+    unroll<site_components<V>()>([&](auto comp) {
+      constexpr int c = decltype(comp)::value;
+      f(i, j, k, l, c);
+    });
+  } else {
+    constexpr int inner = std::extent_v<D, 1>;
+    unroll<site_components<V>()>([&](auto comp) {
+      constexpr int c = decltype(comp)::value;
+      f(i, j, k, l, c / inner, c % inner);
+    });
+  }
+}
+
+// "[24]", "[12][2]" or "" for a plain 4D view, the lanes of AoSoA fields
+// are not shown
+template <typename V>
+const char *site_payload_name() {
+  using D = typename V::data_type;
+  static const std::string name = [] {
+    std::string res;
+    if constexpr (std::rank_v<D> >= 1) res += "[" + std::to_string(std::extent_v<D, 0>) + "]";
+    if constexpr (std::rank_v<D> >= 2 && !is_aosoa_field<V>())
+      res += "[" + std::to_string(std::extent_v<D, 1>) + "]";
+    return res;
+  }();
+  return name.c_str();
+}
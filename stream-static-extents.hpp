@@ -0,0 +1,119 @@
+/*
+// Views with compile-time (static) extents for fixed lattice sizes.
+//
+// StaticExtentData<rank, nstatic, S>::type is the Kokkos data type of a view
+// of rank 'rank' whose trailing 'nstatic' extents are the compile-time
+// constant S and whose leading extents are set at runtime, e.g.
+//
+//   StaticExtentData<4, 0, 32>::type  ==  double ****
+//   StaticExtentData<4, 1, 32>::type  ==  double ***[32]
+//   StaticExtentData<4, 4, 32>::type  ==  double [32][32][32][32]
+//
+// With LayoutRight the stride of dimension d is the product of the extents
+// d+1 ... rank-1, so it is a compile-time constant if all of these are
+// static and the compiler can fold it into the index arithmetic. The
+// exception is dimension 0: as soon as any extent is dynamic, Kokkos keeps
+// its stride in a runtime member, so only fully static views have all
+// strides known at compile time.
+//
+// The sizes compiled into stream-kokkos-static-extents are set with the
+// STREAM_STATIC_SIZES_<N>D macros (comma separated, see CMakeLists.txt).
+*/
+
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+#ifndef STREAM_STATIC_SIZES_2D
+#define STREAM_STATIC_SIZES_2D 4096
+#endif
+#ifndef STREAM_STATIC_SIZES_3D
+#define STREAM_STATIC_SIZES_3D 256
+#endif
+#ifndef STREAM_STATIC_SIZES_4D
+#define STREAM_STATIC_SIZES_4D 32, 64
+#endif
+#ifndef STREAM_STATIC_SIZES_5D
+#define STREAM_STATIC_SIZES_5D 16, 24
+#endif
+
+template <int rank>
+struct StaticSizes;
+template <>
+struct StaticSizes<2> {
+  using type = std::index_sequence<STREAM_STATIC_SIZES_2D>;
+};
+template <>
+struct StaticSizes<3> {
+  using type = std::index_sequence<STREAM_STATIC_SIZES_3D>;
+};
+template <>
+struct StaticSizes<4> {
+  using type = std::index_sequence<STREAM_STATIC_SIZES_4D>;
+};
+template <>
+struct StaticSizes<5> {
+  using type = std::index_sequence<STREAM_STATIC_SIZES_5D>;
+};
+
+namespace static_extents_impl {
+
+template <typename T, int n>
+struct add_pointers {
+  using type = typename add_pointers<T, n - 1>::type *;
+};
+template <typename T>
+struct add_pointers<T, 0> {
+  using type = T;
+};
+
+template <typename T, int n, std::size_t S>
+struct add_extents {
+  using type = typename add_extents<T, n - 1, S>::type[S];
+};
+template <typename T, std::size_t S>
+struct add_extents<T, 0, S> {
+  using type = T;
+};
+
+template <typename V, std::size_t... D>
+V make_view(const std::string &label, const std::size_t n, std::index_sequence<D...>) {
+  return V(Kokkos::view_alloc(Kokkos::WithoutInitializing, label), ((void)D, n)...);
+}
+
+}  // namespace static_extents_impl
+
+template <typename T, int rank, int nstatic, std::size_t S>
+struct StaticExtentData {
+  static_assert(nstatic >= 0 && nstatic <= rank, "invalid number of static extents");
+  using type = typename static_extents_impl::add_extents<
+      typename static_extents_impl::add_pointers<T, rank - nstatic>::type, nstatic, S>::type;
+};
+
+// e.g. "double**[32][32]"
+template <int rank, int nstatic, std::size_t S>
+std::string static_extent_name(const char *value_type) {
+  std::string res = value_type;
+  for (int d = 0; d < rank - nstatic; ++d) res += "*";
+  for (int d = 0; d < nstatic; ++d) res += "[" + std::to_string(S) + "]";
+  return res;
+}
+
+// number of LayoutRight strides which are compile-time constants, the
+// stride of dimension 0 is a runtime value unless all extents are static
+constexpr int static_strides(const int rank, const int nstatic) {
+  if (nstatic == rank) return rank;
+  return nstatic + 1 < rank - 1 ? nstatic + 1 : rank - 1;
+}
+
+// Allocates a view with all runtime extents set to n, static extents are
+// taken from the data type.
+template <typename V>
+V make_static_extent_view(const std::string &label, const std::size_t n) {
+  return static_extents_impl::make_view<V>(label, n,
+                                           std::make_index_sequence<V::rank_dynamic()>{});
+}
@@ -0,0 +1,180 @@
+/*
+// Hierarchical (TeamPolicy) execution of the 4D and 5D STREAM kernels.
+//
+// The outermost dimension is mapped to the league, one team per index i.
+// The remaining dimensions are distributed over the threads of a team and
+// the vector lanes of a thread in one of three ways:
+//
+//   thread        TeamThreadMDRange over all but the innermost dimension,
+//                 nested ThreadVectorRange over the innermost dimension
+//   teamvector    TeamVectorMDRange over all remaining dimensions
+//   threadvector  TeamThreadRange / TeamThreadMDRange over the middle
+//                 dimensions, nested ThreadVectorMDRange over the two
+//                 innermost dimensions
+//
+// Team size and vector length are taken from TeamConfig, 0 selects
+// Kokkos::AUTO.
+*/
+
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+#include <cstring>
+#include <string>
+
+enum class TeamMapping { Thread, TeamVector, ThreadVector };
+
+constexpr TeamMapping team_mappings[] = {TeamMapping::Thread, TeamMapping::TeamVector,
+                                         TeamMapping::ThreadVector};
+
+struct TeamConfig {
+  int team_size     = 0;  // 0: Kokkos::AUTO
+  int vector_length = 0;  // 0: Kokkos::AUTO
+};
+
+using StreamTeamPolicy = Kokkos::TeamPolicy<>;
+using StreamTeamMember = StreamTeamPolicy::member_type;
+
+inline const char *team_mapping_name(const TeamMapping m) {
+  switch (m) {
+    case TeamMapping::TeamVector: return "teamvector";
+    case TeamMapping::ThreadVector: return "threadvector";
+    default: return "thread";
+  }
+}
+
+// returns false if 'name' is not a valid mapping
+inline bool parse_team_mapping(const char *name, TeamMapping &m) {
+  for (const auto q : team_mappings) {
+    if (std::strcmp(name, team_mapping_name(q)) == 0) {
+      m = q;
+      return true;
+    }
+  }
+  return false;
+}
+
+// which dimensions go to league / threads / vector lanes, e.g. "i | j,k | l"
+inline std::string team_mapping_layout(const TeamMapping m, const int rank) {
+  const std::string dims = rank == 4 ? "ijkl" : "ijklm";
+  const auto list = [&](const int begin, const int end) {
+    std::string res;
+    for (int d = begin; d < end; ++d) {
+      if (d > begin) res += ",";
+      res += dims[d];
+    }
+    return res;
+  };
+  switch (m) {
+    case TeamMapping::TeamVector: return list(0, 1) + " | " + list(1, rank);
+    case TeamMapping::ThreadVector:
+      return list(0, 1) + " | " + list(1, rank - 2) + " | " + list(rank - 2, rank);
+    default: return list(0, 1) + " | " + list(1, rank - 1) + " | " + list(rank - 1, rank);
+  }
+}
+
+inline std::string team_config_string(const TeamConfig &config) {
+  const auto value = [](const int v) { return v > 0 ? std::to_string(v) : std::string("AUTO"); };
+  return "team size " + value(config.team_size) + ", vector length " +
+         value(config.vector_length);
+}
+
+inline StreamTeamPolicy make_team_policy(const int league_size, const TeamConfig &config) {
+  if (config.team_size > 0 && config.vector_length > 0) {
+    return StreamTeamPolicy(league_size, config.team_size, config.vector_length);
+  }
+  if (config.team_size > 0) {
+    return StreamTeamPolicy(league_size, config.team_size, Kokkos::AUTO);
+  }
+  if (config.vector_length > 0) {
+    return StreamTeamPolicy(league_size, Kokkos::AUTO, config.vector_length);
+  }
+  return StreamTeamPolicy(league_size, Kokkos::AUTO, Kokkos::AUTO);
+}
+
+// Runs f(i,j,k,l) over [0,n0) x ... x [0,n3) with the given mapping.
+template <typename F>
+void team_parallel_for(const std::string &label, const Kokkos::Array<int, 4> &n,
+                       const TeamMapping mapping, const TeamConfig &config, const F &f) {
+  const auto policy = make_team_policy(n[0], config);
+  switch (mapping) {
+    case TeamMapping::Thread:
+      Kokkos::parallel_for(
+          label, policy, KOKKOS_LAMBDA(const StreamTeamMember &team) {
+            const int i = team.league_rank();
+            Kokkos::parallel_for(
+                Kokkos::TeamThreadMDRange<Kokkos::Rank<2>, StreamTeamMember>(team, n[1], n[2]),
+                [&](const int j, const int k) {
+                  Kokkos::parallel_for(Kokkos::ThreadVectorRange(team, n[3]),
+                                       [&](const int l) { f(i, j, k, l); });
+                });
+          });
+      break;
+    case TeamMapping::TeamVector:
+      Kokkos::parallel_for(
+          label, policy, KOKKOS_LAMBDA(const StreamTeamMember &team) {
+            const int i = team.league_rank();
+            Kokkos::parallel_for(
+                Kokkos::TeamVectorMDRange<Kokkos::Rank<3>, StreamTeamMember>(team, n[1], n[2], n[3]),
+                [&](const int j, const int k, const int l) { f(i, j, k, l); });
+          });
+      break;
+    case TeamMapping::ThreadVector:
+      Kokkos::parallel_for(
+          label, policy, KOKKOS_LAMBDA(const StreamTeamMember &team) {
+            const int i = team.league_rank();
+            Kokkos::parallel_for(Kokkos::TeamThreadRange(team, n[1]), [&](const int j) {
+              Kokkos::parallel_for(
+                  Kokkos::ThreadVectorMDRange<Kokkos::Rank<2>, StreamTeamMember>(team, n[2], n[3]),
+                  [&](const int k, const int l) { f(i, j, k, l); });
+            });
+          });
+      break;
+  }
+  Kokkos::fence();
+}
+
+// Runs f(i,j,k,l,m) over [0,n0) x ... x [0,n4) with the given mapping.
+template <typename F>
+void team_parallel_for(const std::string &label, const Kokkos::Array<int, 5> &n,
+                       const TeamMapping mapping, const TeamConfig &config, const F &f) {
+  const auto policy = make_team_policy(n[0], config);
+  switch (mapping) {
+    case TeamMapping::Thread:
+      Kokkos::parallel_for(
+          label, policy, KOKKOS_LAMBDA(const StreamTeamMember &team) {
+            const int i = team.league_rank();
+            Kokkos::parallel_for(
+                Kokkos::TeamThreadMDRange<Kokkos::Rank<3>, StreamTeamMember>(team, n[1], n[2], n[3]),
+                [&](const int j, const int k, const int l) {
+                  Kokkos::parallel_for(Kokkos::ThreadVectorRange(team, n[4]),
+                                       [&](const int m) { f(i, j, k, l, m); });
+                });
+          });
+      break;
+    case TeamMapping::TeamVector:
+      Kokkos::parallel_for(
+          label, policy, KOKKOS_LAMBDA(const StreamTeamMember &team) {
+            const int i = team.league_rank();
+            Kokkos::parallel_for(
+                Kokkos::TeamVectorMDRange<Kokkos::Rank<4>, StreamTeamMember>(team, n[1], n[2], n[3], n[4]),
+                [&](const int j, const int k, const int l, const int m) { f(i, j, k, l, m); });
+          });
+      break;
+    case TeamMapping::ThreadVector:
+      Kokkos::parallel_for(
+          label, policy, KOKKOS_LAMBDA(const StreamTeamMember &team) {
+            const int i = team.league_rank();
+            Kokkos::parallel_for(
+                Kokkos::TeamThreadMDRange<Kokkos::Rank<2>, StreamTeamMember>(team, n[1], n[2]),
+                [&](const int j, const int k) {
+                  Kokkos::parallel_for(
+                      Kokkos::ThreadVectorMDRange<Kokkos::Rank<2>, StreamTeamMember>(team, n[3], n[4]),
+                      [&](const int l, const int m) { f(i, j, k, l, m); });
+                });
+          });
+      break;
+  }
+  Kokkos::fence();
+}
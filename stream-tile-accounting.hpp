@@ -0,0 +1,194 @@
+/*
+// Per-thread work and time accounting for MDRange kernels.
+//
+// MDRangePolicy hands out whole tiles to threads. When the number of tiles
+// does not divide evenly over the number of threads, some threads process
+// an extra tile and all others wait for them at the end of the kernel.
+//
+// instrumented_parallel_for() runs a kernel on the host execution space and
+// records, per thread, the number of tiles and elements processed as well as
+// the time spent inside tiles. report_tile_accounting() summarises this as
+// an imbalance ratio (max / mean busy time) and a straggler cost (fraction
+// of the kernel during which the average thread is idle waiting for the
+// slowest one).
+//
+// print_tile_counts() is the analytic counterpart: it shows how many tiles
+// a given set of extents and tiling produces and how well they can be
+// distributed over a given number of threads.
+*/
+
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <utility>
+
+// padded to a cache line such that threads do not contend on the counters
+struct alignas(64) ThreadTileCounters {
+  std::int64_t tiles = 0;
+  std::int64_t elements = 0;
+  double busy = 0.0;
+  std::chrono::steady_clock::time_point tile_start;
+};
+
+using TileAccounting = Kokkos::View<ThreadTileCounters *, Kokkos::HostSpace>;
+
+// Worker thread of the host execution space, for any host backend (OpenMP,
+// Threads, HPX, Serial). A tile is always processed by a single worker, so
+// the id stays the same from the first to the last element of a tile.
+inline int host_thread_id() {
+  return Kokkos::DefaultHostExecutionSpace::impl_hardware_thread_id();
+}
+
+// one slot per hardware thread id of the host execution space
+inline TileAccounting make_tile_accounting() {
+  return TileAccounting("tile_accounting",
+                        Kokkos::DefaultHostExecutionSpace::impl_max_hardware_threads());
+}
+
+inline void reset_tile_accounting(const TileAccounting &acc) {
+  for (std::size_t t = 0; t < acc.extent(0); ++t) {
+    acc(t) = ThreadTileCounters();
+  }
+}
+
+// Wraps a kernel body and detects the first and last element of every tile.
+// Within a tile, the origin is always visited first and the element with
+// all offsets at their maximum is always visited last, independently of the
+// inner iteration pattern.
+template <std::size_t rank, typename Functor>
+struct InstrumentedFunctor {
+  Functor f;
+  Kokkos::Array<std::int64_t, rank> upper;
+  Kokkos::Array<std::int64_t, rank> tile;
+  TileAccounting acc;
+
+  template <typename... Idx>
+  void operator()(const Idx... idx) const {
+    const std::int64_t index[rank] = {static_cast<std::int64_t>(idx)...};
+    bool first = true;
+    bool last = true;
+    for (std::size_t d = 0; d < rank; ++d) {
+      const auto offset = index[d] % tile[d];
+      first = first && (offset == 0);
+      last = last && (offset == tile[d] - 1 || index[d] == upper[d] - 1);
+    }
+    ThreadTileCounters &counters = acc(host_thread_id());
+    if (first) {
+      counters.tiles++;
+      counters.tile_start = std::chrono::steady_clock::now();
+    }
+    f(idx...);
+    counters.elements++;
+    if (last) {
+      counters.busy += std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - counters.tile_start)
+                           .count();
+    }
+  }
+};
+
+// Runs 'f' over [0,upper) with the given tiling on the host execution space,
+// accumulating into 'acc'. Returns the wall-clock time of the kernel.
+template <std::size_t rank, typename T, typename Functor>
+double instrumented_parallel_for(const std::string &label,
+                                 const Kokkos::Array<T, rank> &upper,
+                                 const Kokkos::Array<T, rank> &tiling,
+                                 const TileAccounting &acc, const Functor &f) {
+  InstrumentedFunctor<rank, Functor> wrapped{f, {}, {}, acc};
+  Kokkos::Array<std::int64_t, rank> lower;
+  for (std::size_t d = 0; d < rank; ++d) {
+    lower[d] = 0;
+    wrapped.upper[d] = static_cast<std::int64_t>(upper[d]);
+    wrapped.tile[d] = tiling[d] > 0 ? static_cast<std::int64_t>(tiling[d]) : 1;
+  }
+  Kokkos::Timer timer;
+  Kokkos::parallel_for(
+      label,
+      Kokkos::MDRangePolicy<Kokkos::Rank<rank>,
+                            Kokkos::DefaultHostExecutionSpace>(
+          lower, wrapped.upper, wrapped.tile),
+      wrapped);
+  Kokkos::fence();
+  return timer.seconds();
+}
+
+// Prints the per-thread table followed by the imbalance summary.
+inline void report_tile_accounting(const std::string &label,
+                                   const TileAccounting &acc,
+                                   const double wall_time,
+                                   const bool per_thread = true) {
+  const std::size_t nthreads = acc.extent(0);
+  std::int64_t min_tiles = acc(0).tiles, max_tiles = acc(0).tiles;
+  double sum_tiles = 0.0;
+  double min_busy = acc(0).busy, max_busy = acc(0).busy, sum_busy = 0.0;
+  std::int64_t total_elements = 0;
+
+  if (per_thread) {
+    printf("%-8s thread       tiles      elements    busy [ms]\n",
+           label.c_str());
+  }
+  for (std::size_t t = 0; t < nthreads; ++t) {
+    const auto &c = acc(t);
+    if (per_thread) {
+      printf("%-8s %6zu %11" PRId64 " %13" PRId64 " %12.4f\n", label.c_str(),
+             t, c.tiles, c.elements, 1.0e3 * c.busy);
+    }
+    min_tiles = std::min(min_tiles, c.tiles);
+    max_tiles = std::max(max_tiles, c.tiles);
+    sum_tiles += c.tiles;
+    min_busy = std::min(min_busy, c.busy);
+    max_busy = std::max(max_busy, c.busy);
+    sum_busy += c.busy;
+    total_elements += c.elements;
+  }
+
+  const double mean_tiles = sum_tiles / nthreads;
+  const double mean_busy = sum_busy / nthreads;
+  const double tile_imbalance = mean_tiles > 0 ? max_tiles / mean_tiles : 0.0;
+  const double imbalance = mean_busy > 0 ? max_busy / mean_busy : 0.0;
+  const double straggler = max_busy > 0 ? 1.0 - mean_busy / max_busy : 0.0;
+
+  printf("%-8s tiles/thread [min,max,mean]: [%" PRId64 ",%" PRId64 ",%.2f]"
+         "  elements: %" PRId64 "\n",
+         label.c_str(), min_tiles, max_tiles, mean_tiles, total_elements);
+  printf("%-8s busy/thread [min,max,mean]: [%.4f,%.4f,%.4f] ms"
+         "  wall: %.4f ms\n",
+         label.c_str(), 1.0e3 * min_busy, 1.0e3 * max_busy, 1.0e3 * mean_busy,
+         1.0e3 * wall_time);
+  printf("%-8s imbalance (busy max/mean): %.3f  (tiles max/mean): %.3f"
+         "  straggler cost: %.1f%%\n",
+         label.c_str(), imbalance, tile_imbalance, 100.0 * straggler);
+}
+
+// Analytic tile distribution: number of tiles per dimension, total number of
+// tiles and the best possible distribution over 'nthreads' threads.
+template <typename T1, typename T2, std::size_t rank>
+void print_tile_counts(const Kokkos::Array<T1, rank> &extents,
+                       const Kokkos::Array<T2, rank> &tiling,
+                       const int nthreads) {
+  std::size_t total = 1;
+  std::string per_dim;
+  std::string tile_str;
+  for (std::size_t d = 0; d < rank; ++d) {
+    const std::size_t t = tiling[d] > 0 ? static_cast<std::size_t>(tiling[d]) : 1;
+    const std::size_t n = (static_cast<std::size_t>(extents[d]) + t - 1) / t;
+    total *= n;
+    per_dim += (d == 0 ? "" : "x") + std::to_string(n);
+    tile_str += (d == 0 ? "" : ",") + std::to_string(t);
+  }
+  const std::size_t per_thread = (total + nthreads - 1) / nthreads;
+  const std::size_t remainder = total % nthreads;
+  const double efficiency =
+      static_cast<double>(total) / (static_cast<double>(per_thread) * nthreads);
+  printf("tiling [%s]: tiles %s = %zu, threads %d, max tiles/thread %zu, "
+         "threads with extra tile %zu, efficiency %.1f%%\n",
+         tile_str.c_str(), per_dim.c_str(), total, nthreads, per_thread,
+         remainder, 100.0 * efficiency);
+}
@@ -0,0 +1,392 @@
+/*
+// Cache-topology-aware analytic tiling heuristic for MDRangePolicy.
+//
+// get_tiling() in the tiling scan binaries hard-codes one tile shape per
+// rank. The functions here instead read the cache hierarchy and the
+// core / socket / NUMA topology from sysfs and rank candidate tile shapes
+// using a simple model of
+//
+//   - the working set of a single tile (all streams) relative to the
+//     per-thread share of the L2 cache,
+//   - how evenly the resulting number of tiles distributes over the threads
+//     and whether each thread gets enough tiles to absorb timing noise,
+//   - the length of contiguous memory runs inside a tile (in the
+//     fastest-running dimension of the view layout, extended into the next
+//     dimension when a dimension is covered completely),
+//   - the fixed per-tile overhead of the MDRange iteration.
+//
+// The heuristic is only meaningful for host execution spaces, for device
+// execution spaces heuristic_tiling() returns zeros which lets Kokkos pick
+// its default tiling.
+*/
+
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+
+struct CacheLevel {
+  int level = 0;
+  std::string type;
+  std::size_t size = 0;  // bytes
+  int shared_cpus = 1;   // number of logical cpus sharing this cache
+};
+
+struct CpuTopology {
+  std::vector<CacheLevel> caches;
+  int cpus = 1;
+  int threads_per_core = 1;
+  int cores = 1;
+  int sockets = 1;
+  int numa_nodes = 1;
+
+  // data or unified cache of the given level, nullptr if not found
+  const CacheLevel *cache(const int level) const {
+    for (const auto &c : caches) {
+      if (c.level == level && c.type != "Instruction") return &c;
+    }
+    return nullptr;
+  }
+
+  // share of the given cache level available to one of 'nthreads' threads,
+  // assuming threads are spread over cores first (OMP_PLACES=cores)
+  std::size_t cache_per_thread(const int level, const int nthreads) const {
+    const CacheLevel *c = cache(level);
+    if (c == nullptr) return 0;
+    const int cores_sharing = std::max(1, c->shared_cpus / threads_per_core);
+    const int threads_per_cache =
+        std::max(1, std::min(c->shared_cpus,
+                             cores_sharing * ((nthreads + cores - 1) / cores)));
+    return c->size / threads_per_cache;
+  }
+};
+
+// number of cpus in a sysfs cpu list such as "0-3,64-67"
+inline int count_cpu_list(const std::string &list) {
+  int count = 0;
+  std::size_t pos = 0;
+  while (pos < list.size()) {
+    std::size_t end = list.find(',', pos);
+    if (end == std::string::npos) end = list.size();
+    const std::string range = list.substr(pos, end - pos);
+    const std::size_t dash = range.find('-');
+    if (dash == std::string::npos) {
+      if (!range.empty()) ++count;
+    } else {
+      count += std::stoi(range.substr(dash + 1)) - std::stoi(range.substr(0, dash)) + 1;
+    }
+    pos = end + 1;
+  }
+  return count;
+}
+
+inline std::string read_sysfs_string(const std::string &path) {
+  std::ifstream in(path);
+  std::string value;
+  std::getline(in, value);
+  return value;
+}
+
+// "48K", "2048K", "32M" -> bytes
+inline std::size_t parse_cache_size(const std::string &str) {
+  if (str.empty()) return 0;
+  std::size_t value = std::stoul(str);
+  switch (str.back()) {
+    case 'K': value *= 1024; break;
+    case 'M': value *= 1024 * 1024; break;
+    case 'G': value *= 1024 * 1024 * 1024; break;
+    default: break;
+  }
+  return value;
+}
+
+inline int count_sysfs_entries(const std::string &dir, const std::string &prefix) {
+  DIR *d = opendir(dir.c_str());
+  if (d == nullptr) return 0;
+  int count = 0;
+  while (const dirent *e = readdir(d)) {
+    const std::string name = e->d_name;
+    if (name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0 &&
+        std::isdigit(static_cast<unsigned char>(name[prefix.size()]))) {
+      ++count;
+    }
+  }
+  closedir(d);
+  return count;
+}
+
+inline CpuTopology read_cpu_topology() {
+  CpuTopology topo;
+  const std::string cpu0 = "/sys/devices/system/cpu/cpu0/";
+
+  topo.cpus = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+
+  const std::string siblings = read_sysfs_string(cpu0 + "topology/thread_siblings_list");
+  if (!siblings.empty()) topo.threads_per_core = std::max(1, count_cpu_list(siblings));
+  topo.cores = std::max(1, topo.cpus / topo.threads_per_core);
+
+  std::set<std::string> packages;
+  for (int c = 0; c < topo.cpus; ++c) {
+    const std::string id = read_sysfs_string("/sys/devices/system/cpu/cpu" + std::to_string(c) +
+                                             "/topology/physical_package_id");
+    if (!id.empty()) packages.insert(id);
+  }
+  topo.sockets = std::max<int>(1, packages.size());
+  topo.numa_nodes = std::max(1, count_sysfs_entries("/sys/devices/system/node", "node"));
+
+  for (int i = 0;; ++i) {
+    const std::string index = cpu0 + "cache/index" + std::to_string(i) + "/";
+    const std::string level = read_sysfs_string(index + "level");
+    if (level.empty()) break;
+    CacheLevel c;
+    c.level = std::stoi(level);
+    c.type = read_sysfs_string(index + "type");
+    c.size = parse_cache_size(read_sysfs_string(index + "size"));
+    const std::string shared = read_sysfs_string(index + "shared_cpu_list");
+    c.shared_cpus = shared.empty() ? 1 : std::max(1, count_cpu_list(shared));
+    topo.caches.push_back(c);
+  }
+
+  // typical values in case sysfs does not expose the cache hierarchy
+  if (topo.caches.empty()) {
+    topo.caches.push_back({1, "Data", 32 * 1024, topo.threads_per_core});
+    topo.caches.push_back({2, "Unified", 1024 * 1024, topo.threads_per_core});
+    topo.caches.push_back({3, "Unified", 32 * 1024 * 1024, topo.cpus / topo.sockets});
+  }
+  return topo;
+}
+
+inline void print_cpu_topology(const CpuTopology &topo) {
+  printf("CPU topology: %d cpus, %d cores, %d threads/core, %d sockets, %d NUMA nodes\n",
+         topo.cpus, topo.cores, topo.threads_per_core, topo.sockets, topo.numa_nodes);
+  for (const auto &c : topo.caches) {
+    if (c.type == "Instruction") continue;
+    printf("- L%d %-8s %10zu KiB shared by %d cpus\n", c.level, c.type.c_str(),
+           c.size / 1024, c.shared_cpus);
+  }
+}
+
+template <std::size_t rank>
+struct TilingCandidate {
+  Kokkos::Array<std::size_t, rank> tile;
+  std::size_t tiles = 0;        // total number of tiles
+  std::size_t working_set = 0;  // bytes touched per tile (all streams)
+  std::size_t run_length = 0;   // contiguous elements per run
+  double cache_fit = 0.0;
+  double balance = 0.0;
+  double granularity = 0.0;
+  double contiguity = 0.0;
+  double overhead = 0.0;
+  double score = 0.0;
+};
+
+struct TilingModelParameters {
+  int nstreams = 3;                   // arrays touched per kernel
+  std::size_t element_size = sizeof(double);
+  std::size_t run_penalty = 2 * 64;   // bytes lost per contiguous run
+  std::size_t tile_overhead = 64;     // per-tile cost in element updates
+  double min_tiles_per_thread = 4.0;  // below this, timing noise is not absorbed
+};
+
+// candidate tile extents for a dimension: powers of two and divisors of the
+// extent, always including 1 and the full extent
+inline std::vector<std::size_t> tile_extent_candidates(const std::size_t extent,
+                                                       const bool reduced) {
+  std::set<std::size_t> c;
+  c.insert(1);
+  c.insert(extent);
+  for (std::size_t p = 2; p < extent; p *= 2) c.insert(p);
+  if (!reduced) {
+    for (std::size_t d = 2; d * d <= extent; ++d) {
+      if (extent % d == 0) {
+        c.insert(d);
+        c.insert(extent / d);
+      }
+    }
+  }
+  return std::vector<std::size_t>(c.begin(), c.end());
+}
+
+template <std::size_t rank>
+TilingCandidate<rank> evaluate_tiling(const Kokkos::Array<std::size_t, rank> &extents,
+                                      const Kokkos::Array<std::size_t, rank> &tile,
+                                      const int nthreads, const std::size_t cache_budget,
+                                      const bool layout_right,
+                                      const TilingModelParameters &params) {
+  TilingCandidate<rank> c;
+  c.tile = tile;
+
+  std::size_t volume = 1;
+  c.tiles = 1;
+  for (std::size_t d = 0; d < rank; ++d) {
+    volume *= tile[d];
+    c.tiles *= (extents[d] + tile[d] - 1) / tile[d];
+  }
+
+  // contiguous run: fastest-running dimension, continued into the next one
+  // as long as the tile covers the full extent
+  c.run_length = 1;
+  for (std::size_t i = 0; i < rank; ++i) {
+    const std::size_t d = layout_right ? rank - 1 - i : i;
+    c.run_length *= tile[d];
+    if (tile[d] != extents[d]) break;
+  }
+
+  c.working_set = volume * params.nstreams * params.element_size;
+  c.cache_fit = c.working_set <= cache_budget
+                    ? 1.0
+                    : std::sqrt(static_cast<double>(cache_budget) / c.working_set);
+
+  const std::size_t per_thread = (c.tiles + nthreads - 1) / nthreads;
+  c.balance = static_cast<double>(c.tiles) / (static_cast<double>(per_thread) * nthreads);
+  c.granularity = std::sqrt(std::min(
+      1.0, static_cast<double>(c.tiles) / (params.min_tiles_per_thread * nthreads)));
+
+  const double run_bytes = static_cast<double>(c.run_length * params.element_size);
+  c.contiguity = run_bytes / (run_bytes + params.run_penalty);
+
+  c.overhead = static_cast<double>(volume) / (volume + params.tile_overhead);
+
+  c.score = c.cache_fit * c.balance * c.granularity * c.contiguity * c.overhead;
+  return c;
+}
+
+// All candidate tilings for the given extents, best first.
+template <std::size_t rank>
+std::vector<TilingCandidate<rank>> rank_tilings(const Kokkos::Array<std::size_t, rank> &extents,
+                                                const int nthreads, const CpuTopology &topo,
+                                                const bool layout_right,
+                                                const TilingModelParameters &params = {}) {
+  // the per-tile working set should stay resident in the private cache
+  std::size_t cache_budget = topo.cache_per_thread(2, nthreads);
+  if (cache_budget == 0) cache_budget = topo.cache_per_thread(1, nthreads);
+
+  std::vector<std::vector<std::size_t>> per_dim(rank);
+  std::size_t combinations = 1;
+  for (std::size_t d = 0; d < rank; ++d) {
+    per_dim[d] = tile_extent_candidates(extents[d], false);
+    combinations *= per_dim[d].size();
+  }
+  // keep the enumeration cheap for high ranks with many divisors
+  if (combinations > (1u << 17)) {
+    for (std::size_t d = 0; d < rank; ++d) {
+      per_dim[d] = tile_extent_candidates(extents[d], true);
+    }
+  }
+
+  std::vector<TilingCandidate<rank>> res;
+  Kokkos::Array<std::size_t, rank> pos;
+  for (std::size_t d = 0; d < rank; ++d) pos[d] = 0;
+  while (true) {
+    Kokkos::Array<std::size_t, rank> tile;
+    for (std::size_t d = 0; d < rank; ++d) tile[d] = per_dim[d][pos[d]];
+    res.push_back(evaluate_tiling(extents, tile, nthreads, cache_budget, layout_right, params));
+
+    std::size_t d = 0;
+    while (d < rank && ++pos[d] == per_dim[d].size()) {
+      pos[d] = 0;
+      ++d;
+    }
+    if (d == rank) break;
+  }
+
+  // ties are resolved in favour of more tiles, which helps dynamic effects
+  std::stable_sort(res.begin(), res.end(),
+                   [](const TilingCandidate<rank> &a, const TilingCandidate<rank> &b) {
+                     return a.score > b.score || (a.score == b.score && a.tiles > b.tiles);
+                   });
+  return res;
+}
+
+template <std::size_t rank>
+std::string tiling_to_string(const Kokkos::Array<std::size_t, rank> &tile) {
+  std::string res = "[";
+  for (std::size_t d = 0; d < rank; ++d) {
+    res += std::to_string(tile[d]);
+    if (d < rank - 1) res += ",";
+  }
+  return res + "]";
+}
+
+// returns false unless 'arg' is a comma separated list of integers in
+// [lo, hi]
+inline bool parse_int_list(const char *arg, const int lo, const int hi, std::vector<int> &res) {
+  res.clear();
+  const char *p = arg;
+  while (true) {
+    errno = 0;
+    char *end = nullptr;
+    const long value = std::strtol(p, &end, 10);
+    if (errno != 0 || end == p || value < lo || value > hi) return false;
+    res.push_back(static_cast<int>(value));
+    if (*end == '\0') return true;
+    if (*end != ',') return false;
+    p = end + 1;
+  }
+}
+
+// returns false unless 'arg' is a tiling <t0>,...,<t(rank-1)>, 0 lets
+// Kokkos choose the tile extent
+template <std::size_t rank>
+bool parse_tiling(const char *arg, Kokkos::Array<std::size_t, rank> &tiling) {
+  std::vector<int> values;
+  if (!parse_int_list(arg, 0, std::numeric_limits<int>::max(), values) || values.size() != rank)
+    return false;
+  for (std::size_t d = 0; d < rank; ++d) tiling[d] = values[d];
+  return true;
+}
+
+template <std::size_t rank>
+void print_tiling_candidates(const std::vector<TilingCandidate<rank>> &candidates,
+                             const std::size_t count) {
+  printf("Heuristic tiling candidates:\n");
+  for (std::size_t i = 0; i < std::min(count, candidates.size()); ++i) {
+    const auto &c = candidates[i];
+    printf("- %-24s score %.3f  cache %.2f  balance %.2f  granularity %.2f  "
+           "contiguity %.2f  overhead %.2f  tiles %zu  ws %zu KiB\n",
+           tiling_to_string(c.tile).c_str(), c.score, c.cache_fit, c.balance,
+           c.granularity, c.contiguity, c.overhead, c.tiles, c.working_set / 1024);
+  }
+}
+
+// Heuristic tiling for 'view', zeros (Kokkos default) for device views.
+template <typename V>
+Kokkos::Array<std::size_t, V::rank()> heuristic_tiling(const V &view, const int nstreams = 3,
+                                                       const bool verbose = false) {
+  constexpr std::size_t rank = V::rank();
+  Kokkos::Array<std::size_t, rank> res;
+  for (std::size_t d = 0; d < rank; ++d) res[d] = 0;
+
+  if constexpr (std::is_same_v<typename V::execution_space, Kokkos::DefaultHostExecutionSpace>) {
+    Kokkos::Array<std::size_t, rank> extents;
+    for (std::size_t d = 0; d < rank; ++d) extents[d] = view.extent(d);
+    const CpuTopology topo = read_cpu_topology();
+    const int nthreads = Kokkos::DefaultHostExecutionSpace().concurrency();
+    TilingModelParameters params;
+    params.nstreams = nstreams;
+    params.element_size = sizeof(typename V::value_type);
+    const bool layout_right = !std::is_same_v<typename V::array_layout, Kokkos::LayoutLeft>;
+    const auto candidates = rank_tilings(extents, nthreads, topo, layout_right, params);
+    if (verbose) {
+      print_cpu_topology(topo);
+      print_tiling_candidates(candidates, 5);
+    }
+    res = candidates.front().tile;
+  }
+  return res;
+}
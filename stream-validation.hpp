@@ -0,0 +1,138 @@
+/*
+// Validation of the STREAM results on the device.
+//
+// validate_on_device() runs a single parallel_reduce over the views a, b
+// and c in their own execution space. Per view it sums the deviations from
+// the expected value which exceed epsilon (as the host loops did before)
+// and takes the maximal deviation, so no host mirrors are allocated and
+// nothing is copied back. first_element() copies a single value to the
+// host for printing.
+*/
+
+#pragma once
+
+#include <Kokkos_Core.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+struct ValidationErrors {
+  double sum[3] = {0.0, 0.0, 0.0};  // deviations above epsilon of a, b, c
+  double max[3] = {0.0, 0.0, 0.0};  // maximal deviation of a, b, c
+};
+
+// true if the views of type V live in memory the host can access, i.e. the
+// benchmark needs host memory for them
+template <typename V>
+constexpr bool views_in_host_memory() {
+  return Kokkos::SpaceAccessibility<Kokkos::HostSpace, typename V::memory_space>::accessible;
+}
+
+namespace validation_impl {
+
+template <typename V>
+struct ErrorFunctor {
+  V a, b, c;
+  double ai, bi, ci;
+  double epsilon;
+
+  KOKKOS_INLINE_FUNCTION void check(const double value, const double expected, double &sum,
+                                    double &max) const {
+    const double err = value > expected ? value - expected : expected - value;
+    if (err > epsilon) sum += err;
+    max = err > max ? err : max;
+  }
+
+  KOKKOS_INLINE_FUNCTION void check(const double va, const double vb, const double vc,
+                                    double &as, double &bs, double &cs, double &am,
+                                    double &bm, double &cm) const {
+    check(va, ai, as, am);
+    check(vb, bi, bs, bm);
+    check(vc, ci, cs, cm);
+  }
+
+  KOKKOS_INLINE_FUNCTION void operator()(const std::int64_t i, double &as, double &bs,
+                                         double &cs, double &am, double &bm,
+                                         double &cm) const {
+    check(a(i), b(i), c(i), as, bs, cs, am, bm, cm);
+  }
+  KOKKOS_INLINE_FUNCTION void operator()(const std::int64_t i, const std::int64_t j,
+                                         double &as, double &bs, double &cs, double &am,
+                                         double &bm, double &cm) const {
+    check(a(i, j), b(i, j), c(i, j), as, bs, cs, am, bm, cm);
+  }
+  KOKKOS_INLINE_FUNCTION void operator()(const std::int64_t i, const std::int64_t j,
+                                         const std::int64_t k, double &as, double &bs,
+                                         double &cs, double &am, double &bm,
+                                         double &cm) const {
+    check(a(i, j, k), b(i, j, k), c(i, j, k), as, bs, cs, am, bm, cm);
+  }
+  KOKKOS_INLINE_FUNCTION void operator()(const std::int64_t i, const std::int64_t j,
+                                         const std::int64_t k, const std::int64_t l,
+                                         double &as, double &bs, double &cs, double &am,
+                                         double &bm, double &cm) const {
+    check(a(i, j, k, l), b(i, j, k, l), c(i, j, k, l), as, bs, cs, am, bm, cm);
+  }
+  KOKKOS_INLINE_FUNCTION void operator()(const std::int64_t i, const std::int64_t j,
+                                         const std::int64_t k, const std::int64_t l,
+                                         const std::int64_t m, double &as, double &bs,
+                                         double &cs, double &am, double &bm,
+                                         double &cm) const {
+    check(a(i, j, k, l, m), b(i, j, k, l, m), c(i, j, k, l, m), as, bs, cs, am, bm, cm);
+  }
+  KOKKOS_INLINE_FUNCTION void operator()(const std::int64_t i, const std::int64_t j,
+                                         const std::int64_t k, const std::int64_t l,
+                                         const std::int64_t m, const std::int64_t o,
+                                         double &as, double &bs, double &cs, double &am,
+                                         double &bm, double &cm) const {
+    check(a(i, j, k, l, m, o), b(i, j, k, l, m, o), c(i, j, k, l, m, o), as, bs, cs, am, bm,
+          cm);
+  }
+};
+
+template <typename V, std::size_t... I>
+typename V::non_const_value_type first_element(const V &view, std::index_sequence<I...>) {
+  typename V::non_const_value_type value;
+  Kokkos::deep_copy(value, Kokkos::subview(view, ((void)I, 0)...));
+  return value;
+}
+
+}  // namespace validation_impl
+
+// view(0,...,0), copied to the host
+template <typename V>
+typename V::non_const_value_type first_element(const V &view) {
+  return validation_impl::first_element(view, std::make_index_sequence<V::rank()>{});
+}
+
+// Compares a, b and c with the expected values ai, bi and ci on the device.
+template <typename V>
+ValidationErrors validate_on_device(const V &a, const V &b, const V &c, const double ai,
+                                    const double bi, const double ci, const double epsilon) {
+  using ExecSpace         = typename V::execution_space;
+  constexpr std::size_t rank = V::rank();
+  const validation_impl::ErrorFunctor<V> functor{a, b, c, ai, bi, ci, epsilon};
+
+  ValidationErrors res;
+  if constexpr (rank == 1) {
+    Kokkos::parallel_reduce(
+        "validation",
+        Kokkos::RangePolicy<ExecSpace, Kokkos::IndexType<std::int64_t>>(0, a.extent(0)),
+        functor, res.sum[0], res.sum[1], res.sum[2], Kokkos::Max<double>(res.max[0]),
+        Kokkos::Max<double>(res.max[1]), Kokkos::Max<double>(res.max[2]));
+  } else {
+    Kokkos::Array<std::int64_t, rank> lower, upper;
+    for (std::size_t d = 0; d < rank; ++d) {
+      lower[d] = 0;
+      upper[d] = a.extent(d);
+    }
+    Kokkos::parallel_reduce(
+        "validation",
+        Kokkos::MDRangePolicy<ExecSpace, Kokkos::Rank<rank>, Kokkos::IndexType<std::int64_t>>(
+            lower, upper),
+        functor, res.sum[0], res.sum[1], res.sum[2], Kokkos::Max<double>(res.max[0]),
+        Kokkos::Max<double>(res.max[1]), Kokkos::Max<double>(res.max[2]));
+  }
+  return res;
+}